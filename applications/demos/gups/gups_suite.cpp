@@ -0,0 +1,359 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+/// Random-access (GUPS) benchmark suite: HPCC RandomAccess over a Grappa
+/// global array, with the ways Grappa can issue remote updates side by
+/// side, so a runtime change can be checked against all of them at once.
+///
+/// The table has 2^log_size words, initially T[i] = i; each core takes an
+/// equal share of HPCC's pseudo-random stream (4 updates per word) and
+/// does T[ran & (size-1)] ^= ran, at most `batch` updates ahead of the
+/// last ones it knows are done (HPCC's look-ahead limit is 1024). Modes:
+///
+///   blocking   delegate::call per update, from `batch` tasks per core
+///   async      a heap message per update, waiting per batch
+///   combining  a batch grouped by owner, duplicate words XOR-combined and
+///              packed into one message per owner
+///   alltoall   a batch per core exchanged with Grappa::alltoallv
+///   locale     atomic XOR straight into cores' memory in this locale
+///              (async messages to other locales)
+///
+/// Verification replays the stream (XOR undoes it) with alltoall and
+/// counts words that are not back to T[i] = i; HPCC passes with at most
+/// 1% of the table wrong.
+///
+/// Every combination of --gups_modes, --gups_log_sizes and --gups_batches
+/// is run, and each prints (and appends to --gups_json) one JSON object;
+/// to sweep cores, run again with a different number of cores and the
+/// same --gups_json.
+////////////////////////////////////////////////////////////////////////
+
+#include <Grappa.hpp>
+#include <Collective.hpp>
+
+#include <fstream>
+#include <sstream>
+
+using namespace Grappa;
+
+DEFINE_string( gups_modes, "blocking,async,combining,alltoall,locale", "Update strategies to run" );
+DEFINE_string( gups_log_sizes, "20", "Log2 table sizes (in 8-byte words) to run" );
+DEFINE_string( gups_batches, "1024", "Updates each core may have outstanding (HPCC allows 1024)" );
+DEFINE_int64( gups_updates_per_word, 4, "Updates per table word (HPCC: 4)" );
+DEFINE_bool( gups_verify, true, "Check the table after each run" );
+DEFINE_string( gups_json, "", "Append the results to this file, one JSON object per line" );
+
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_runtime, 0.0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gups_throughput, 0.0 );
+
+enum class Mode { Blocking, Async, Combining, Alltoall, Locale };
+
+const char * mode_name(Mode m) {
+  switch (m) {
+    case Mode::Blocking:  return "blocking";
+    case Mode::Async:     return "async";
+    case Mode::Combining: return "combining";
+    case Mode::Alltoall:  return "alltoall";
+    case Mode::Locale:    return "locale";
+  }
+  return "?";
+}
+
+Mode mode(const std::string& name) {
+  for (auto m : {Mode::Blocking, Mode::Async, Mode::Combining, Mode::Alltoall, Mode::Locale}) {
+    if (name == mode_name(m)) return m;
+  }
+  LOG(FATAL) << "unknown GUPS mode '" << name << "'";
+  return Mode::Async;
+}
+
+std::vector<std::string> split(const std::string& s) {
+  std::vector<std::string> parts;
+  std::stringstream ss(s);
+  std::string p;
+  while (std::getline(ss, p, ',')) if (!p.empty()) parts.push_back(p);
+  return parts;
+}
+
+////////////////////////////////////////////////////////////////////////
+// HPCC RandomAccess stream
+
+const uint64_t POLY = 0x0000000000000007UL;
+const int64_t PERIOD = 1317624576693539401L;
+
+inline uint64_t next_random(uint64_t r) {
+  return (r << 1) ^ (static_cast<int64_t>(r) < 0 ? POLY : 0);
+}
+
+/// the n-th value of the stream (HPCC_starts)
+uint64_t hpcc_starts(int64_t n) {
+  while (n < 0) n += PERIOD;
+  while (n > PERIOD) n -= PERIOD;
+  if (n == 0) return 0x1;
+  
+  uint64_t m2[64];
+  uint64_t temp = 0x1;
+  for (int i = 0; i < 64; i++) {
+    m2[i] = temp;
+    temp = next_random(next_random(temp));
+  }
+  int i;
+  for (i = 62; i >= 0; i--) if ((n >> i) & 1) break;
+  
+  uint64_t ran = 0x2;
+  while (i > 0) {
+    temp = 0;
+    for (int j = 0; j < 64; j++) if ((ran >> j) & 1) temp ^= m2[j];
+    ran = temp;
+    i -= 1;
+    if ((n >> i) & 1) ran = next_random(ran);
+  }
+  return ran;
+}
+
+////////////////////////////////////////////////////////////////////////
+// per-core state
+
+struct Update {
+  int64_t index;
+  uint64_t value;
+  bool operator<(const Update& u) const { return index < u.index; }
+};
+
+/// a packed batch of updates for one core travels by value in its message
+const size_t pack_size = MAX_MESSAGE_SIZE / sizeof(Update) - 2;
+struct Pack {
+  size_t n;
+  Update u[pack_size];
+};
+
+GlobalAddress<uint64_t> table;
+uint64_t mask;
+std::vector<intptr_t> chunk_base;   // global heap chunk of each core in this locale
+int64_t errors;
+
+inline void apply(int64_t i, uint64_t v) { *(table+i).pointer() ^= v; }
+
+/// the updates [first,last) of the stream, `batch` at a time
+void run_updates(Mode m, int64_t batch) {
+  int64_t n = FLAGS_gups_updates_per_word * (mask+1);
+  int64_t per_core = (n + cores() - 1) / cores();
+  int64_t rounds = (per_core + batch - 1) / batch;   // the same on every core (for alltoall)
+  
+  on_all_cores([m,batch,n,per_core,rounds]{
+    int64_t pos = std::min(n, mycore() * per_core);
+    int64_t last = std::min(n, pos + per_core);
+    uint64_t ran = hpcc_starts(pos);
+    std::vector<Update> us;
+    
+    for (int64_t r = 0; r < rounds; r++) {
+      us.clear();
+      for (; pos < last && (int64_t)us.size() < batch; pos++) {
+        ran = next_random(ran);
+        us.push_back(Update{ static_cast<int64_t>(ran & mask), ran });
+      }
+      
+      switch (m) {
+        case Mode::Blocking: {
+          forall_here(0, us.size(), [&us](int64_t k){
+            auto u = us[k];
+            delegate::call((table+u.index).core(), [u]{ apply(u.index, u.value); });
+          });
+          break;
+        }
+        case Mode::Async: {
+          CompletionEvent ce(us.size());
+          auto ce_a = make_global(&ce);
+          for (auto u : us) {
+            auto c = (table+u.index).core();
+            if (c == mycore()) {
+              apply(u.index, u.value);
+              ce.complete();
+            } else {
+              send_heap_message(c, [u,ce_a]{
+                apply(u.index, u.value);
+                complete(ce_a);
+              });
+            }
+          }
+          ce.wait();
+          break;
+        }
+        case Mode::Combining: {
+          // group by owner, then by word (so repeated words XOR together)
+          std::sort(us.begin(), us.end(), [](const Update& a, const Update& b){
+            auto ca = (table+a.index).core(), cb = (table+b.index).core();
+            return ca < cb || (ca == cb && a.index < b.index);
+          });
+          size_t w = 0;
+          for (size_t k = 0; k < us.size(); k++) {
+            if (w > 0 && us[w-1].index == us[k].index) us[w-1].value ^= us[k].value;
+            else us[w++] = us[k];
+          }
+          us.resize(w);
+          
+          CompletionEvent ce;
+          auto ce_a = make_global(&ce);
+          for (size_t k = 0; k < us.size(); ) {
+            auto c = (table+us[k].index).core();
+            Pack p;
+            p.n = 0;
+            for (; k < us.size() && (table+us[k].index).core() == c && p.n < pack_size; k++) {
+              p.u[p.n++] = us[k];
+            }
+            if (c == mycore()) {
+              for (size_t j = 0; j < p.n; j++) apply(p.u[j].index, p.u[j].value);
+            } else {
+              ce.enroll();
+              send_heap_message(c, [p,ce_a]{
+                for (size_t j = 0; j < p.n; j++) apply(p.u[j].index, p.u[j].value);
+                complete(ce_a);
+              });
+            }
+          }
+          ce.wait();
+          break;
+        }
+        case Mode::Alltoall: {
+          Update * recv;
+          auto nrecv = alltoallv<Update>([&us](size_t * counts){
+            for (auto& u : us) counts[(table+u.index).core()]++;
+          }, [&us](Update ** next){
+            for (auto& u : us) *next[(table+u.index).core()]++ = u;
+          }, &recv);
+          for (size_t k = 0; k < nrecv; k++) apply(recv[k].index, recv[k].value);
+          locale_free(recv);
+          break;
+        }
+        case Mode::Locale: {
+          // (every core's global heap chunk is in locale-shared memory, so
+          //  another core's word is at the same offset from its chunk)
+          CompletionEvent ce;
+          auto ce_a = make_global(&ce);
+          auto mine = reinterpret_cast<intptr_t>(impl::global_memory_chunk_base);
+          for (auto u : us) {
+            auto a = table+u.index;
+            auto c = a.core();
+            if (locale_of(c) == mylocale()) {
+              auto p = reinterpret_cast<uint64_t*>(chunk_base[c] + (reinterpret_cast<intptr_t>(a.pointer()) - mine));
+              __sync_fetch_and_xor(p, u.value);
+            } else {
+              ce.enroll();
+              send_heap_message(c, [u,ce_a]{
+                __sync_fetch_and_xor((table+u.index).pointer(), u.value);
+                complete(ce_a);
+              });
+            }
+          }
+          ce.wait();
+          break;
+        }
+      }
+    }
+  });
+}
+
+void benchmark(Mode m, int log_size, int64_t batch) {
+  auto size = int64_t(1) << log_size;
+  auto _table = global_alloc<uint64_t>(size);
+  call_on_all_cores([_table,size]{
+    table = _table;
+    mask = size - 1;
+  });
+  forall(table, size, [](int64_t i, uint64_t& x){ x = i; });
+  
+  double start = walltime();
+  run_updates(m, batch);
+  gups_runtime = walltime() - start;
+  int64_t nupdates = FLAGS_gups_updates_per_word * size;
+  gups_throughput = nupdates / gups_runtime;
+  
+  int64_t nerrors = -1;
+  if (FLAGS_gups_verify) {
+    run_updates(Mode::Alltoall, 1024);
+    call_on_all_cores([]{ errors = 0; });
+    forall(table, size, [](int64_t i, uint64_t& x){ if (x != static_cast<uint64_t>(i)) errors++; });
+    nerrors = reduce<int64_t,collective_add>(&errors);
+  }
+  global_free(table);
+  
+  bool passed = nerrors >= 0 && nerrors <= 0.01 * size;
+  std::ostringstream o;
+  o << "{ \"mode\": \"" << mode_name(m) << "\""
+    << ", \"log_size\": " << log_size
+    << ", \"batch\": " << batch
+    << ", \"cores\": " << cores()
+    << ", \"locales\": " << locales()
+    << ", \"updates\": " << nupdates
+    << ", \"time\": " << gups_runtime.value()
+    << ", \"gups\": " << gups_throughput.value() / 1.0e9
+    << ", \"errors\": " << nerrors
+    << ", \"hpcc_lookahead\": " << (batch <= 1024 ? "true" : "false")
+    << ", \"passed\": " << (passed ? "true" : "false")
+    << " }";
+  LOG(INFO) << o.str();
+  if (!FLAGS_gups_json.empty()) {
+    std::ofstream f(FLAGS_gups_json, std::ios::app);
+    CHECK( f.is_open() ) << "unable to open " << FLAGS_gups_json;
+    f << o.str() << std::endl;
+  }
+  if (FLAGS_gups_verify && !passed) {
+    LOG(ERROR) << mode_name(m) << ": " << nerrors << " of " << size << " words wrong";
+  }
+}
+
+int main(int argc, char * argv[]) {
+  init( &argc, &argv );
+  run([]{
+    
+    on_all_cores([]{
+      chunk_base.assign(cores(), 0);
+      for (Core c = 0; c < cores(); c++) {
+        if (locale_of(c) != mylocale()) continue;
+        chunk_base[c] = delegate::call(c, []{ return reinterpret_cast<intptr_t>(impl::global_memory_chunk_base); });
+      }
+    });
+    
+    for (auto& s : split(FLAGS_gups_log_sizes)) {
+      for (auto& b : split(FLAGS_gups_batches)) {
+        for (auto& m : split(FLAGS_gups_modes)) {
+          benchmark(mode(m), std::stoi(s), std::stoll(b));
+        }
+      }
+    }
+    
+  });
+  finalize();
+}
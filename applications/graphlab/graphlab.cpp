@@ -10,5 +10,7 @@
 
 GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, iteration_time, 0);
 GRAPPA_DEFINE_METRIC(SummarizingMetric<int>, core_set_size, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, vertex_updates, 0);
 
 DEFINE_int32(max_iterations, 1024, "Stop after this many iterations, no matter what.");
+DEFINE_bool(async, false, "Use the asynchronous, prioritized engine (run_async) instead of run_sync.");
@@ -51,6 +51,7 @@
 #include <unordered_map>
 #include <vector>
 #include <numeric>
+#include <queue>
 using std::unordered_set;
 using std::unordered_map;
 using std::vector;
@@ -62,8 +63,10 @@ using delegate::call;
 static const Core INVALID = -1;
 
 GRAPPA_DECLARE_METRIC(SummarizingMetric<double>, iteration_time);
+GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, vertex_updates);
 
 DECLARE_int32(max_iterations);
+DECLARE_bool(async);
 
 
 /////////////////////////////////////////////////////////
@@ -107,6 +110,52 @@ struct GraphlabVertexProgram {
   void reset() { cache = GatherType(); }
 };
 
+namespace Grappa {
+namespace impl {
+
+  /// Per-core queue of active vertices for the asynchronous engines (run_async),
+  /// highest priority first, ties in the order they were scheduled.
+  ///
+  /// A vertex is pushed again each time it receives a delta (with its new
+  /// priority) rather than having its entry updated, so it may be queued more
+  /// than once; the engines skip entries whose vertex is no longer active.
+  template< typename T >
+  class PriorityScheduler {
+    struct Entry {
+      double priority;
+      uint64_t seq;
+      T* v;
+      bool operator<(const Entry& o) const {
+        return priority < o.priority || (priority == o.priority && seq > o.seq);
+      }
+    };
+    std::priority_queue<Entry> q;
+    uint64_t seq;
+  public:
+    PriorityScheduler(): seq(0) {}
+    bool empty() const { return q.empty(); }
+    size_t size() const { return q.size(); }
+    void push(T* v, double priority) { q.push(Entry{ priority, seq++, v }); }
+    T* pop() { auto v = q.top().v; q.pop(); return v; }
+  };
+
+  /// Scheduling priority of a vertex: the vertex program's
+  /// `double priority(const Vertex&) const` if it defines one (e.g. its
+  /// residual), otherwise 1 (first come, first served). A vertex whose
+  /// priority is zero or less has nothing worth applying yet; run_async
+  /// deactivates it instead of queueing it, and its deltas keep accumulating
+  /// until one raises its priority.
+  template< typename P, typename V >
+  auto priority(const P& p, const V& v, int) -> decltype(p.priority(v)) { return p.priority(v); }
+  template< typename P, typename V >
+  double priority(const P& p, const V& v, long) { return 1; }
+
+  template< typename P, typename V >
+  double priority(const P& p, const V& v) { return priority(p, v, 0); }
+
+} // namespace impl
+} // namespace Grappa
+
 #include "graphlab_naive.hpp"
 #include "graphlab_splitv.hpp"
 
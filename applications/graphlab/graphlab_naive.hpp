@@ -53,8 +53,9 @@ struct GraphlabVertexData {
 
   void* prog;
   bool active, active_minor_step;
+  float queued; ///< priority run_async last queued this vertex with (0 if not queued)
 
-  GraphlabVertexData(): active(false) {}
+  GraphlabVertexData(): active(false), queued(0) {}
   void activate() { if (!active) { total_active++; active = true; } }
   void deactivate() { if (active) { total_active--; active = false; } }
 };
@@ -94,6 +95,14 @@ void activate(GlobalAddress<V> v) {
 /// - only one Engine can be executed at a time in the system
 /// - Gather type must be POD
 /// 
+/// Two schedules are available: run_sync() applies every active vertex in
+/// bulk-synchronous supersteps; run_async() applies active vertices one at a
+/// time from a per-core priority queue (see impl::PriorityScheduler), highest
+/// priority first, as soon as scattered deltas activate them. Each vertex has
+/// a single copy, owned by one core, and its apply and the deltas posted to it
+/// all run on that core without yielding, so run_async keeps GraphLab's vertex
+/// consistency without any locking.
+/// 
 /// @tparam G           Graph type
 /// @tparam VertexProg  Vertex program, subclass of GraphlabVertexProgram.
 /// 
@@ -106,6 +115,11 @@ struct NaiveGraphlabEngine {
   static GlobalAddress<G> g;
   static Reducer<int64_t,ReducerType::Add> ct;
   
+  // run_async state (per core)
+  static impl::PriorityScheduler<Vertex> queue;
+  static bool worker_running;
+  static GlobalCompletionEvent gce;
+  
   static VertexProg& prog(Vertex& v) {
     return *static_cast<VertexProg*>(v->prog);
   }
@@ -130,12 +144,114 @@ struct NaiveGraphlabEngine {
     });
   }
   
-  /// Run synchronous engine, assumes:
-  /// - Delta caching enabled
-  /// - gather_edges:IN_EDGES, scatter_edges:(OUT_EDGES || NONE)
-  template< typename V, typename E >
-  static void run_sync(GlobalAddress<Graph<V,E>> _g) {
-    
+  /// Run `deliver` on the target of `e` and schedule the target if that
+  /// leaves it active (run_async). Like delegate::call<async,&gce>, this runs
+  /// in place if the target is local; otherwise the message's enrollment in
+  /// `gce` goes to start_worker() if the target starts its core's worker.
+  template< typename F >
+  static void _deliver(GlobalAddress<Vertex> ga, F deliver) {
+    if (ga.core() == mycore()) {
+      auto& ve = *ga.pointer();
+      deliver(ve);
+      if (ve->active && enqueue(ve)) {
+        gce.enroll();
+        start_worker(mycore());
+      }
+    } else {
+      auto origin = mycore();
+      gce.enroll();
+      send_heap_message(ga.core(), [=]{
+        auto& ve = *ga.pointer();
+        deliver(ve);
+        if (ve->active && enqueue(ve)) start_worker(origin);
+        else gce.send_completion(origin);
+      });
+    }
+  }
+  
+  static void _do_scatter_async(const VertexProg& prog_copy, Edge& e,
+                  Gather (VertexProg::*f)(Vertex&) const) {
+    _deliver(e.ga, [=](Vertex& ve){
+      auto gather_delta = prog_copy.scatter(ve);
+      prog(ve).post_delta(gather_delta);
+    });
+  }
+  
+  static void _do_scatter_async(const VertexProg& prog_copy, Edge& e,
+                  Gather (VertexProg::*f)(const Edge&, Vertex&) const) {
+    auto e_id = e.id;
+    auto e_data = e.data;
+    _deliver(e.ga, [=](Vertex& ve){
+      auto local_e_data = e_data;
+      Edge e = { e_id, g->vs+e_id, local_e_data };
+      auto gather_delta = prog_copy.scatter(e, ve);
+      prog(ve).post_delta(gather_delta);
+    });
+  }
+  
+  /// Queue an active vertex on this core (run_async), or deactivate it if
+  /// it has nothing worth applying (see impl::priority). A vertex that is
+  /// already queued is only queued again once its priority has doubled.
+  /// @return true if this core's worker needs to be started
+  static bool enqueue(Vertex& v) {
+    auto priority = impl::priority(prog(v), v);
+    if (priority <= 0) {
+      v->deactivate();
+      v->queued = 0;
+      return false;
+    }
+    if (v->queued == 0 || priority > 2 * v->queued) {
+      v->queued = priority;
+      queue.push(&v, priority);
+    }
+    return !worker_running;
+  }
+  
+  /// Start this core's worker, handing it an enrollment in `gce` the caller
+  /// holds from `origin`, which it keeps until it has enrolled here itself
+  /// (so the phase can't end while the queue is non-empty). Safe to call
+  /// from a message handler.
+  static void start_worker(Core origin) {
+    worker_running = true;
+    spawn([origin]{
+      // a local enrollment for as long as it runs keeps enroll() in the
+      // worker from blocking
+      gce.enroll();
+      gce.send_completion(origin);
+      worker();
+      gce.complete();
+    });
+  }
+  
+  /// Apply and scatter queued vertices until this core's queue is empty.
+  static void worker() {
+    int64_t n = 0;
+    while (!queue.empty()) {
+      auto& v = *queue.pop();
+      v->queued = 0;
+      if (!v->active) continue; // already applied since it was queued
+      v->deactivate();
+      // deltas since it was queued may have cancelled out
+      if (impl::priority(prog(v), v) <= 0) continue;
+      
+      auto& p = prog(v);
+      p.apply(v, p.cache);
+      vertex_updates++;
+      
+      if (p.scatter_edges(v)) {
+        auto prog_copy = p;
+        serial_for(adj(g,v), [&](Edge& e){
+          _do_scatter_async(prog_copy, e, &VertexProg::scatter);
+        });
+      }
+      // let deltas from other cores in (and re-prioritize) now and then
+      if (++n % 64 == 0) Grappa::yield();
+    }
+    worker_running = false;
+  }
+  
+  /// Set up vertex programs on all vertices and do the initial gather
+  static void init(GlobalAddress<G> _g) {
     call_on_all_cores([=]{ g = _g; });
     
     ct = 0;
@@ -157,6 +273,16 @@ struct NaiveGraphlabEngine {
         });
       });
     }
+  }
+  
+  /// Run synchronous engine, assumes:
+  /// - Delta caching enabled
+  /// - gather_edges:IN_EDGES, scatter_edges:(OUT_EDGES || NONE)
+  template< typename V, typename E >
+  static void run_sync(GlobalAddress<Graph<V,E>> _g) {
+    
+    init(_g);
+    
     int iteration = 0;
     size_t active = V::total_active;
     while ( active > 0 && iteration < FLAGS_max_iterations )
@@ -174,6 +300,7 @@ struct NaiveGraphlabEngine {
 
         // apply
         p.apply(v, p.cache);
+        vertex_updates++;
 
         v->active_minor_step = p.scatter_edges(v);
       });
@@ -196,6 +323,39 @@ struct NaiveGraphlabEngine {
 
     forall(g, [](Vertex& v){ delete static_cast<VertexProg*>(v->prog); });
   }
+  
+  /// Run asynchronous engine: same assumptions as run_sync, and the vertex
+  /// program may define `double priority(const Vertex&) const` to have
+  /// vertices with larger values (e.g. residuals) applied first, and those
+  /// with none left (<= 0) not at all (see impl::priority).
+  /// `FLAGS_max_iterations` does not apply; it runs until no vertex is active.
+  template< typename V, typename E >
+  static void run_async(GlobalAddress<Graph<V,E>> _g) {
+    
+    init(_g);
+    
+    GRAPPA_TIME_REGION(iteration_time) {
+      VLOG(1) << "async";
+      VLOG(1) << "  active: " << V::total_active;
+      double t = walltime();
+      
+      on_all_cores([]{ gce.enroll(); });
+      on_all_cores([]{
+        for (auto& v : iterate_local(g->vs, g->nv)) {
+          if (v.valid && v->active && enqueue(v)) {
+            gce.enroll();
+            start_worker(mycore());
+          }
+        }
+        gce.complete();
+        gce.wait();
+      });
+      
+      VLOG(1) << "  time:   " << walltime()-t;
+    }
+
+    forall(g, [](Vertex& v){ delete static_cast<VertexProg*>(v->prog); });
+  }
 };
 
 template< typename G, typename VertexProg >
@@ -203,3 +363,12 @@ GlobalAddress<G> NaiveGraphlabEngine<G,VertexProg>::g;
 
 template< typename G, typename VertexProg >
 Reducer<int64_t,ReducerType::Add> NaiveGraphlabEngine<G,VertexProg>::ct;
+
+template< typename G, typename VertexProg >
+impl::PriorityScheduler<typename G::Vertex> NaiveGraphlabEngine<G,VertexProg>::queue;
+
+template< typename G, typename VertexProg >
+bool NaiveGraphlabEngine<G,VertexProg>::worker_running;
+
+template< typename G, typename VertexProg >
+GlobalCompletionEvent NaiveGraphlabEngine<G,VertexProg>::gce;
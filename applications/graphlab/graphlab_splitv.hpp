@@ -13,6 +13,7 @@
 /// (included from graphlab.hpp)
 
 #include "graphlab_borrowed.hpp"
+#include <graph/Partition.hpp>
 
 GRAPPA_DECLARE_METRIC(SummarizingMetric<int>, core_set_size);
 
@@ -62,10 +63,11 @@ namespace Grappa {
 
       void* prog;
       bool active, active_minor_step;
+      float queued; ///< priority run_async last queued this master with (0 if not queued)
       
       MasterInfo* master_info;
 
-      Vertex(VertexID id = -1): id(id), data(), n_in(), n_out(), l_out(nullptr), l_nout(0), prog(nullptr), active(false), active_minor_step(false) {}
+      Vertex(VertexID id = -1): id(id), data(), n_in(), n_out(), l_out(nullptr), l_nout(0), prog(nullptr), active(false), active_minor_step(false), queued(0) {}
 
       V* operator->(){ return &data; }
       const V* operator->() const { return &data; }
@@ -99,6 +101,8 @@ namespace Grappa {
     struct MasterInfo {
       std::vector<Core> mirrors;
       std::vector<GlobalAddress<Vertex>> mirror_verts;
+      size_t pending; ///< mirrors still scattering the last apply (run_async's vertex lock)
+      MasterInfo(): pending(0) {}
     };
 
     GlobalAddress<GraphlabGraph> self;
@@ -126,67 +130,9 @@ namespace Grappa {
     GraphlabGraph() = default;
     ~GraphlabGraph() = default;
     
-    /// Greedy assign (source, target) to a machine.
-    /// 
-    /// @param source      source vertex id
-    /// @param target      destination vertex id
-    /// @param src_degree  the degree presence of source over machines
-    /// @param dst_degree  the degree presence of target over machines
-    /// @param edge_cts    the edge counts over machines
-    /// @param usehash     consistently hash edges to nodes
-    /// @param userecent   ???
-    /// 
-    /// This function was copied nearly verbatim from GraphLab's source code.
-    /// 
-    static Core edge_to_core_greedy (const VertexID source, 
-       const VertexID target,
-       CoreBitset& src_degree,
-       CoreBitset& dst_degree,
-       size_t* edge_cts,
-       bool usehash = true,
-       bool userecent = false)
-    {
-       
-      // Compute the score of each proc.
-      Core best_proc = -1; 
-      double maxscore = 0.0;
-      double epsilon = 1.0; 
-      std::vector<double> proc_score(cores()); 
-      size_t minedges = *std::min_element(edge_cts, edge_cts+cores());
-      size_t maxedges = *std::max_element(edge_cts, edge_cts+cores());
-      
-      for (size_t i = 0; i < cores(); ++i) {
-        size_t sd = src_degree.get(i) + (usehash && (source % cores() == i));
-        size_t td = dst_degree.get(i) + (usehash && (target % cores() == i));
-        double bal = (maxedges - edge_cts[i])/(epsilon + maxedges - minedges);
-        proc_score[i] = bal + ((sd > 0) + (td > 0));
-      }
-      maxscore = *std::max_element(proc_score.begin(), proc_score.end());
-   
-      std::vector<Core> top_procs; 
-      for (size_t i = 0; i < cores(); ++i)
-        if (std::fabs(proc_score[i] - maxscore) < 1e-5)
-          top_procs.push_back(i);
-
-      // Hash the edge to one of the best procs.
-      typedef std::pair<VertexID, VertexID> edge_pair_type;
-      const edge_pair_type edge_pair(std::min(source, target), 
-                                     std::max(source, target));
-      best_proc = top_procs[hash_edge(edge_pair) % top_procs.size()];
-      
-      CHECK_LT(best_proc, cores());
-      if (userecent) {
-        src_degree.clear();
-        dst_degree.clear();
-      }
-      src_degree.set_bit(best_proc);
-      dst_degree.set_bit(best_proc);
-      edge_cts[best_proc]++;
-      return best_proc;
-    }
-        
     static GlobalAddress<GraphlabGraph> create(TupleGraph tg) {
-      VLOG(1) << "GraphlabGraph::create( directed, greedy_oblivious )";
+      auto cut = vertex_cut(FLAGS_vertex_cut);
+      VLOG(1) << "GraphlabGraph::create( directed, " << vertex_cut_name(cut) << " )";
       auto g = symmetric_global_alloc<GraphlabGraph>();
       
       on_all_cores([=]{
@@ -210,32 +156,24 @@ namespace Grappa {
         Grappa::memset(edge_cts, 0, cores());
         
         {
-          unordered_map<VertexID,CoreBitset> vplace;
-        
-          /// cores this vertex has been placed on
-          auto vcores = [&](VertexID i) -> CoreBitset& {
-            if (vplace.count(i) == 0) {
-              vplace[i];
-            }
-            return vplace[i];
-          };
-        
-          auto cmp_load = [&](Core c0, Core c1) { return edge_cts[c0] < edge_cts[c1]; };
-
+          // (ties broken with GraphLab's own edge hash, as its greedy placement does)
+          VertexCutPartitioner part(cut, edge_cts, [](int64_t u, int64_t v) -> uint64_t {
+            return hash_edge({ std::min(u,v), std::max(u,v) });
+          });
+          
           for (auto& e : local_edges) {
             auto i = idx(e);
             if (e.v0 == e.v1) {
               assignments[i] = INVALID;
             } else {
-              auto &vs0 = vcores(e.v0), &vs1 = vcores(e.v1);
-              assignments[i] = edge_to_core_greedy(e.v0, e.v1, vs0, vs1, edge_cts);
+              assignments[i] = part.assign(e.v0, e.v1);
             }
           }
         
           barrier();
           PHASE_END();
           
-          g->tmp = vplace.size();
+          g->tmp = part.nvertices();
           LOG_ALL_CORES("bitset_fraction_verts", size_t, g->tmp);
         }
         
@@ -290,6 +228,7 @@ namespace Grappa {
         
         MPI_Datatype mpi_edge_type;
         MPI_Type_contiguous(2, MPI_INT64_T, &mpi_edge_type);
+        MPI_Type_commit(&mpi_edge_type);
         
         PHASE_END();
         
@@ -311,6 +250,7 @@ namespace Grappa {
         
         for (size_t i = 0; i < nrecv; i++) { edges.emplace_back(buf[i]); }
         delete[] buf;
+        MPI_Type_free(&mpi_edge_type);
         
         PHASE_END();
       });
@@ -542,11 +482,12 @@ namespace Grappa {
         
         g->nv = allreduce<int64_t,collective_add>(g->l_master_verts.size());
         g->ne = allreduce<int64_t,collective_add>(g->l_edges.size());
+        
+        report_partition(vertex_cut_name(cut), g->l_edges.size(), g->l_verts.size(), g->nv);
       });
       PHASE_END();
 
       VLOG(0) << "num_vertices: " << g->nv;
-      VLOG(0) << "replication_factor: " << (double)g->nmirrors / g->nv;
       return g;
     }
 
@@ -714,15 +655,13 @@ struct GraphlabEngine {
   static GlobalAddress<G> g;
   static VertexProg* prog_storage;
   
-  ///
-  /// Assuming: `gather_edges = EdgeDirection::In`
-  ///
-  static void run_sync(GlobalAddress<G> g_in, bool delta_caching = true) {
-    
-    VLOG(1) << "GraphlabEngine::run_sync(active:" << Vertex::total_active << ")";
-
-    ///////////////
-    // initialize
+  // run_async state (per core)
+  static impl::PriorityScheduler<Vertex> queue;
+  static bool worker_running;
+  static GlobalCompletionEvent gce;
+  
+  /// Set up vertex programs on masters and mirrors
+  static void init(GlobalAddress<G> g_in) {
     on_all_cores([=]{
       g = g_in;
       
@@ -739,6 +678,42 @@ struct GraphlabEngine {
       for (auto& v : g->l_master_verts) init_prog(v);
       for (auto& v : g->l_verts)        init_prog(v);
     });
+  }
+  
+  /// Gather along in-edges of active vertices into their masters' caches
+  static void gather_in_edges() {
+    // gather in_edges
+    forall(g, [=](Edge& e){
+      auto& v = e.dest();
+      if (v.active) {
+        auto& p = prog(v);
+        p.post_delta( p.gather(v, e) );
+      }
+    });
+    
+    // send accumulated gather to master to compute total
+    forall(mirrors(g), [=](Vertex& v){
+      if (v.active) {
+        v.deactivate();
+        
+        auto& p = prog(v);
+        auto accum = p.cache;
+        call<async>(v.master, [=](Vertex& m){
+          prog(m).post_delta( accum );
+        });
+        p.reset();
+      }
+    });
+  }
+  
+  ///
+  /// Assuming: `gather_edges = EdgeDirection::In`
+  ///
+  static void run_sync(GlobalAddress<G> g_in, bool delta_caching = true) {
+    
+    VLOG(1) << "GraphlabEngine::run_sync(active:" << Vertex::total_active << ")";
+
+    init(g_in);
     
     int iteration = 0;
     while ( Vertex::total_active > 0 && iteration < FLAGS_max_iterations )
@@ -751,28 +726,7 @@ struct GraphlabEngine {
       // gather (TODO: do this in fewer 'forall's)
       
       if (!delta_caching || iteration == 0) {
-        // gather in_edges
-        forall(g, [=](Edge& e){
-          auto& v = e.dest();
-          if (v.active) {
-            auto& p = prog(v);
-            p.post_delta( p.gather(v, e) );
-          }
-        });
-        
-        // send accumulated gather to master to compute total
-        forall(mirrors(g), [=](Vertex& v){
-          if (v.active) {
-            v.deactivate();
-            
-            auto& p = prog(v);
-            auto accum = p.cache;
-            call<async>(v.master, [=](Vertex& m){
-              prog(m).post_delta( accum );
-            });
-            p.reset();
-          }
-        });
+        gather_in_edges();
       }
             
       ////////////////////////////////////////////////////////////
@@ -783,6 +737,7 @@ struct GraphlabEngine {
         
         auto& p = prog(m);
         p.apply(m, p.cache);
+        vertex_updates++;
         
         auto do_scatter = p.scatter_edges(m);
         
@@ -849,6 +804,183 @@ struct GraphlabEngine {
       VLOG(1) << "  time:   " << walltime()-t;
     } // while
   }
+  
+  /// Run `deliver` on a master or mirror (run_async). Like
+  /// delegate::call<async,&gce>, this runs in place if the vertex is local;
+  /// otherwise the message holds an enrollment in `gce` from `origin`, passed
+  /// on to `deliver` (which must complete it).
+  template< typename F >
+  static void _deliver(GlobalAddress<Vertex> ga, F deliver) {
+    auto origin = mycore();
+    gce.enroll();
+    if (ga.core() == origin) {
+      deliver(*ga.pointer(), origin);
+    } else {
+      send_heap_message(ga.core(), [=]{ deliver(*ga.pointer(), origin); });
+    }
+  }
+  
+  /// Queue an active master on this core (run_async), or deactivate it if
+  /// it has nothing worth applying (see impl::priority). A master that is
+  /// already queued is only queued again once its priority has doubled.
+  /// @return true if this core's worker needs to be started
+  static bool enqueue(Vertex& m) {
+    auto priority = impl::priority(prog(m), m);
+    if (priority <= 0) {
+      m.deactivate();
+      m.queued = 0;
+      return false;
+    }
+    if (m.queued == 0 || priority > 2 * m.queued) {
+      m.queued = priority;
+      queue.push(&m, priority);
+    }
+    return !worker_running;
+  }
+  
+  /// Queue `m` if it is active, completing the caller's enrollment in `gce`
+  /// from `origin` (or handing it to the worker this starts). Safe to call
+  /// from a message handler.
+  static void schedule(Vertex& m, Core origin) {
+    if (m.active && enqueue(m)) {
+      worker_running = true;
+      spawn([origin]{
+        // a local enrollment for as long as it runs keeps enroll() in the
+        // worker from blocking
+        gce.enroll();
+        gce.send_completion(origin);
+        worker();
+        gce.complete();
+      });
+    } else {
+      gce.send_completion(origin);
+    }
+  }
+  
+  /// Apply queued masters until this core's queue is empty. Applying a master
+  /// locks it until all of its mirrors have taken the new data and finished
+  /// scattering it (vertex consistency): deltas that arrive meanwhile just
+  /// accumulate, and it is queued again when the last mirror is done.
+  static void worker() {
+    int64_t n = 0;
+    while (!queue.empty()) {
+      auto& m = *queue.pop();
+      if (m.master_info->pending > 0) continue; // locked; unlock() queues it again
+      m.queued = 0;
+      if (!m.active) continue;                  // already applied since it was queued
+      m.deactivate();
+      // deltas since it was queued may have cancelled out
+      if (impl::priority(prog(m), m) <= 0) continue;
+      
+      auto& p = prog(m);
+      p.apply(m, p.cache);
+      vertex_updates++;
+      
+      auto do_scatter = p.scatter_edges(m);
+      auto p_copy = p;
+      auto data = m.data;
+      m.master_info->pending = m.master_info->mirror_verts.size();
+      for (auto gv : m.master_info->mirror_verts) {
+        _deliver(gv, [=](Vertex& v, Core origin){
+          v.data = data;
+          v.active_minor_step = do_scatter;
+          prog(v) = p_copy;
+          prog(v).reset();
+          if (origin == mycore()) {
+            // local: already in a task (this worker)
+            scatter_mirror(v, origin);
+          } else {
+            // in a message handler: scatter from a task, so it can enroll
+            // its forwarded deltas
+            auto vp = &v;
+            spawn([vp,origin]{ scatter_mirror(*vp, origin); });
+          }
+        });
+      }
+      // let deltas from other cores in (and re-prioritize) now and then
+      if (++n % 64 == 0) Grappa::yield();
+    }
+    worker_running = false;
+  }
+  
+  /// Scatter along a mirror's local out-edges after its master's apply,
+  /// forward the deltas this leaves on other vertices' mirrors to their
+  /// masters, and tell the master this mirror is done. Holds an enrollment
+  /// in `gce` from `origin` (completed via unlock()).
+  static void scatter_mirror(Vertex& v, Core origin) {
+    std::vector<std::pair<GlobalAddress<Vertex>,Gather>> forward;
+    if (v.active_minor_step) {
+      v.active_minor_step = false;
+      auto& p = prog(v);
+      for (Edge& e : util::iterate(v.l_out, v.l_nout)) {
+        prog(e.dest()).post_delta( p.scatter(e, e.dest()) );
+      }
+      for (Edge& e : util::iterate(v.l_out, v.l_nout)) {
+        auto& d = e.dest();
+        if (d.active) {
+          d.deactivate();
+          forward.emplace_back(d.master, prog(d).cache);
+          prog(d).reset();
+        }
+      }
+    }
+    for (auto& f : forward) {
+      auto delta = f.second;
+      _deliver(f.first, [delta](Vertex& m, Core origin){
+        m.activate();
+        prog(m).post_delta(delta);
+        schedule(m, origin);
+      });
+    }
+    auto ma = v.master;
+    if (ma.core() == mycore()) {
+      unlock(*ma.pointer(), origin);
+    } else {
+      send_heap_message(ma.core(), [ma,origin]{ unlock(*ma.pointer(), origin); });
+    }
+  }
+  
+  /// One of `m`'s mirrors is done; once all are, queue `m` again if it has
+  /// been activated in the meantime.
+  static void unlock(Vertex& m, Core origin) {
+    if (--m.master_info->pending == 0) {
+      m.queued = 0;
+      schedule(m, origin);
+    } else {
+      gce.send_completion(origin);
+    }
+  }
+  
+  ///
+  /// Asynchronous engine: applies active masters one at a time, highest
+  /// priority first (see impl::priority), as soon as deltas activate them,
+  /// rather than in supersteps. Same assumptions as run_sync, with delta
+  /// caching. `FLAGS_max_iterations` does not apply.
+  ///
+  static void run_async(GlobalAddress<G> g_in) {
+    
+    VLOG(1) << "GraphlabEngine::run_async(active:" << Vertex::total_active << ")";
+    
+    init(g_in);
+    
+    GRAPPA_TIME_REGION(iteration_time) {
+      double t = walltime();
+      
+      gather_in_edges();
+      
+      on_all_cores([]{ gce.enroll(); });
+      on_all_cores([]{
+        for (auto& m : g->l_master_verts) {
+          gce.enroll();
+          schedule(m, mycore());
+        }
+        gce.complete();
+        gce.wait();
+      });
+      
+      VLOG(1) << "  time:   " << walltime()-t;
+    }
+  }
 };
 
 template< typename G, typename VertexProg, class C >
@@ -856,3 +988,12 @@ GlobalAddress<G> GraphlabEngine<G,VertexProg,C>::g;
 
 template< typename G, typename VertexProg, class C >
 VertexProg* GraphlabEngine<G,VertexProg,C>::prog_storage;
+
+template< typename G, typename VertexProg, class C >
+impl::PriorityScheduler<typename G::Vertex> GraphlabEngine<G,VertexProg,C>::queue;
+
+template< typename G, typename VertexProg, class C >
+bool GraphlabEngine<G,VertexProg,C>::worker_running;
+
+template< typename G, typename VertexProg, class C >
+GlobalCompletionEvent GraphlabEngine<G,VertexProg,C>::gce;
@@ -86,6 +86,11 @@ struct PagerankVertexProgram : public GraphlabVertexProgram<G,double> {
     target->activate();
     return delta;
   }
+  /// residual (how much applying now would change the rank) beyond what
+  /// would be scattered; for run_async
+  double priority(const Vertex& v) const {
+    return std::fabs((1.0 - RESET_PROB) * cache + RESET_PROB - v->rank) - TOLERANCE;
+  }
 };
 
 Reducer<double,ReducerType::Add> total_rank;
@@ -143,7 +148,8 @@ int main(int argc, char* argv[]) {
       
       GRAPPA_TIME_REGION(total_time) {
         activate_all(g);
-        NaiveGraphlabEngine<G,PagerankVertexProgram>::run_sync(g);
+        if (FLAGS_async) NaiveGraphlabEngine<G,PagerankVertexProgram>::run_async(g);
+        else             NaiveGraphlabEngine<G,PagerankVertexProgram>::run_sync(g);
       }
       
       if (i == 0) {
@@ -163,6 +169,7 @@ int main(int argc, char* argv[]) {
     if (FLAGS_metrics) Metrics::merge_and_print();
     else {
       std::cerr << total_time << "\n" << iteration_time << "\n";
+      std::cerr << "vertex_updates: " << sum_all_cores([]{ return vertex_updates.value(); }) << "\n";
     }
     Metrics::merge_and_dump_to_file();
 
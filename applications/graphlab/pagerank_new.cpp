@@ -95,6 +95,11 @@ struct PagerankVertexProgram : public GraphlabVertexProgram<G,double> {
     target.activate();
     return delta;
   }
+  /// residual (how much applying now would change the rank) beyond what
+  /// would be scattered; for run_async
+  double priority(const Vertex& v) const {
+    return std::fabs((1.0 - RESET_PROB) * cache + RESET_PROB - v->rank) - TOLERANCE;
+  }
 };
 
 Reducer<double,ReducerType::Add> total_rank;
@@ -141,10 +146,12 @@ int main(int argc, char* argv[]) {
       
       GRAPPA_TIME_REGION(total_time) {
         activate_all(g);
-        GraphlabEngine<G,PagerankVertexProgram>::run_sync(g);
+        if (FLAGS_async) GraphlabEngine<G,PagerankVertexProgram>::run_async(g);
+        else             GraphlabEngine<G,PagerankVertexProgram>::run_sync(g);
       }
       
       if (i == 0) {
+        Metrics::reset_all_cores();
         total_time.reset(); // don't count the first one
         total_rank = 0;
         forall(g, [](G::Vertex& v){ total_rank += v->rank; });
@@ -155,6 +162,7 @@ int main(int argc, char* argv[]) {
     Metrics::stop_tracing();
     
     LOG(INFO) << total_time;
+    LOG(INFO) << "vertex_updates: " << sum_all_cores([]{ return vertex_updates.value(); });
     
     total_rank = 0;
     forall(masters(g), [](G::Vertex& v){ total_rank += v->rank; });
@@ -101,11 +101,17 @@ struct SSSP : public GraphlabVertexProgram<G,bool> {
   bool scatter(const Edge& e, Vertex& target) const {
     auto new_dist = min_dist + e->dist;
     if (new_dist < target->dist) {
-      target->new_dist = new_dist;
+      // keep the shortest of the distances offered before the next apply
+      if (!target->active || new_dist < target->new_dist) {
+        target->new_dist = new_dist;
+      }
       target->activate();
     }
     return false;
   }
+  
+  /// closest tentative distances first (for run_async)
+  double priority(const Vertex& v) const { return 1.0 / (1.0 + v->new_dist); }
 };
 
 using MaxDegree = CmpElement<VertexID,int64_t>;
@@ -166,7 +172,8 @@ int main(int argc, char* argv[]) {
       
       GRAPPA_TIME_REGION(total_time) {
         activate(g->vs+root);
-        NaiveGraphlabEngine<G,SSSP>::run_sync(g);
+        if (FLAGS_async) NaiveGraphlabEngine<G,SSSP>::run_async(g);
+        else             NaiveGraphlabEngine<G,SSSP>::run_sync(g);
       }
       
       if (i == 0) Metrics::reset_all_cores(); // don't count the first one
@@ -178,6 +185,7 @@ int main(int argc, char* argv[]) {
     else {
       std::cerr << total_time << "\n"
                 << iteration_time << "\n";
+      std::cerr << "vertex_updates: " << sum_all_cores([]{ return vertex_updates.value(); }) << "\n";
     }
     Metrics::merge_and_dump_to_file();
 
@@ -2,25 +2,32 @@
 
 #include <Grappa.hpp>
 #include <GlobalCompletionEvent.hpp>
-#include <unordered_map>
 #include <vector>
 
 #include "utils.h"
 #include "stats.h"
+#include "RadixJoin.hpp"
+#include "Spill.hpp"
 
 extern Grappa::GlobalCompletionEvent default_join_left_gce;
 extern Grappa::GlobalCompletionEvent default_join_right_gce;
 extern Grappa::GlobalCompletionEvent default_join_reduce_gce;
 
+/// output tuple for a matching pair; defined by the query code
+template <typename OutType, typename VL, typename VR>
+OutType combine(const VL& left, const VR& right);
+
 template <typename K, typename VL, typename VR, typename OutType>
 struct JoinReducer {
-  std::unordered_map<K, std::vector<VL>> * groupsL;
-  std::unordered_map<K, std::vector<VR>> * groupsR;
+  // tuples hashed to this reducer, joined locally by radix_hash_join,
+  // or by spill::merge_join if the core went over --spill_budget
+  spill::Buffer<K, VL> * tuplesL;
+  spill::Buffer<K, VR> * tuplesR;
 
   std::vector<OutType> * result;
 
-  JoinReducer() : groupsL(new std::unordered_map<K, std::vector<VL>>())
-            , groupsR(new std::unordered_map<K, std::vector<VR>>())
+  JoinReducer() : tuplesL(new spill::Buffer<K, VL>())
+            , tuplesR(new spill::Buffer<K, VR>())
             , result(new std::vector<OutType>()) {}
 
   static std::vector<OutType>& resultAccessor(GlobalAddress<JoinReducer<K, VL, VR, OutType>> o) {
@@ -42,6 +49,8 @@ GlobalAddress<JoinReducer<K,VL,VR,OutType>> allocateJoinReducers( size_t num_red
 template < typename K, typename VL, typename VR, typename OutType >
 void freeJoinReducers(GlobalAddress<JoinReducer<K,VL,VR,OutType>> reducers, size_t num_reducers) {
   Grappa::forall(reducers, num_reducers, [](JoinReducer<K,VL,VR,OutType>& r) {
+      delete r.tuplesL;
+      delete r.tuplesR;
       delete r.result;
   });
   Grappa::global_free(reducers);
@@ -51,8 +60,7 @@ template <typename K, typename VL, typename VR, typename OutType, Grappa::Global
 static void reducer_append_left( GlobalAddress<JoinReducer<K,VL,VR,OutType>> r, K key, VL val ) {
   Grappa::delegate::call<Grappa::async, GCE>(r.core(), [=] {
     VLOG(5) << "add (" << key << ", " << val << ") at " << r.pointer();
-    std::vector<VL>& slot = (*(r->groupsL))[key];
-    slot.push_back(val);
+    r->tuplesL->emplace_back(key, val);
   });
 }
 
@@ -60,8 +68,7 @@ template <typename K, typename VL, typename VR, typename OutType, Grappa::Global
 static void reducer_append_right( GlobalAddress<JoinReducer<K,VL,VR,OutType>> r, K key, VR val ) {
   Grappa::delegate::call<Grappa::async, GCE>(r.core(), [=] {
     VLOG(5) << "add (" << key << ", " << val << ") at " << r.pointer();
-    std::vector<VR>& slot = (*(r->groupsR))[key];
-    slot.push_back(val);
+    r->tuplesR->emplace_back(key, val);
   });
 }
 
@@ -92,23 +99,19 @@ struct HashJoinContext {
     void reduceExecute() {
       // equijoin
       Grappa::forall<GCE>(reducers, num_reducers, [=]( int64_t i, JoinReducer<K,VL,VR,OutType>& reducer) {
-          // for all keys on left
-          for ( auto local_it = reducer.groupsL->begin(); local_it!= reducer.groupsL->end(); ++local_it ) {
-            std::vector<VL>& leftGroup = local_it->second;
-            // get match key on right 
-            std::vector<VR>& rightGroup = (*(reducer.groupsR))[local_it->first]; // NOTE: allocates
-            // cross product
-            for (auto right_it = rightGroup.begin(); right_it!=rightGroup.end(); ++right_it) {
-              for (auto left_it = leftGroup.begin(); left_it!=leftGroup.end(); ++left_it) {
-                join_coarse_result_count++;
-                reducer.result->push_back( combine<OutType,VL,VR>(*left_it,*right_it) );
-              }
-            }
+          auto& result = *(reducer.result);
+          auto emit = [&result](const VL& l, const VR& r) {
+            result.push_back( combine<OutType,VL,VR>(l, r) );
+          };
+          if (reducer.tuplesL->spilled() || reducer.tuplesR->spilled()) {
+            join_coarse_result_count += spill::merge_join(*(reducer.tuplesL), *(reducer.tuplesR), emit);
+          } else {
+            join_coarse_result_count += radix_hash_join(reducer.tuplesL->entries(), reducer.tuplesR->entries(), emit);
           }
 
-          // deallocate the group
-          reducer.groupsR->clear();
-          reducer.groupsL->clear();
+          // deallocate the inputs
+          reducer.tuplesL->clear();
+          reducer.tuplesR->clear();
       });
     }
 };
@@ -80,6 +80,14 @@ std::ostream& operator<< (std::ostream& o, const Tuple3& t) {
     return t.dump(o);
   }
 
+template <>
+Tuple3 combine<Tuple3,Tuple1,Tuple2>(const Tuple1& l, const Tuple2& r) {
+  Tuple3 t;
+  t.set(0, l.k); t.set(1, l.v);
+  t.set(2, r.k); t.set(3, r.v);
+  return t;
+}
+
 
 
 void test_hash_join_array() {
@@ -94,13 +102,13 @@ void test_hash_join_array() {
     auto reducers = allocateJoinReducers<int64_t,Tuple1,Tuple2,Tuple3>(numred); 
     auto ctx = HashJoinContext<int64_t,Tuple1,Tuple2,Tuple3>(reducers, numred);
 
-    forall(leftTuples, leftnum, [=](int64_t i, Tuple1& t) {
+    forall<&default_join_left_gce>(leftTuples, leftnum, [=](int64_t i, Tuple1& t) {
         t.k = i;
         t.v = i*1000;
         ctx.emitIntermediateLeft( t.k, t );
     });
     
-    forall(rightTuples, rightnum, [=](int64_t i, Tuple2& t) {
+    forall<&default_join_right_gce>(rightTuples, rightnum, [=](int64_t i, Tuple2& t) {
         t.k = 2*i;
         t.v = i*10;
         ctx.emitIntermediateRight( t.k, t );
@@ -108,11 +116,15 @@ void test_hash_join_array() {
 
     ctx.reduceExecute();
 
+    // keys 0,2,4,6,8 match once each
+    CHECK_EQ( sum_all_cores([]{ return join_coarse_result_count.value(); }), 5 );
 
     Grappa::forall(reducers, numred, [=](int64_t i, JoinReducer<int64_t,Tuple1,Tuple2,Tuple3>& r) {
       VLOG(1) << "Reducer " << i << " has " << r.result->end() - r.result->begin() << " keys";
       for ( auto local_it = r.result->begin(); local_it!= r.result->end(); ++local_it ) {
         VLOG(1) << *local_it;        
+        CHECK_EQ( local_it->get(0), local_it->get(2) );
+        CHECK_EQ( local_it->get(1), local_it->get(0)*1000 );
       }
       r.result->clear();
     });
@@ -121,11 +133,64 @@ void test_hash_join_array() {
 
 }
 
+void test_hash_join_spill() {
+  LOG(INFO) << "test_hash_join_spill";
+
+    auto leftnum = 2000;
+    auto rightnum = 1000;
+    auto leftTuples = Grappa::global_alloc<Tuple1>(leftnum);
+    auto rightTuples = Grappa::global_alloc<Tuple2>(rightnum);
+    auto numred = 2*cores();
+
+    // a budget of a few hundred tuples per core
+    on_all_cores([]{
+      FLAGS_spill_budget = 1 << 15;
+      join_coarse_result_count.reset();
+      spilled_bytes.reset();
+    });
+
+    auto reducers = allocateJoinReducers<int64_t,Tuple1,Tuple2,Tuple3>(numred); 
+    auto ctx = HashJoinContext<int64_t,Tuple1,Tuple2,Tuple3>(reducers, numred);
+
+    forall<&default_join_left_gce>(leftTuples, leftnum, [=](int64_t i, Tuple1& t) {
+        t.k = i % 500;
+        t.v = t.k*1000;
+        ctx.emitIntermediateLeft( t.k, t );
+    });
+    
+    forall<&default_join_right_gce>(rightTuples, rightnum, [=](int64_t i, Tuple2& t) {
+        t.k = i % 700;
+        t.v = i;
+        ctx.emitIntermediateRight( t.k, t );
+    });
+
+    ctx.reduceExecute();
+
+    // keys 0-299 appear 4 times on the left and twice on the right, keys 300-499 4 times and once
+    CHECK_EQ( sum_all_cores([]{ return join_coarse_result_count.value(); }), 4*(300*2 + 200) );
+    auto spilled = sum_all_cores([]{ return spilled_bytes.value(); });
+    LOG(INFO) << "spilled " << spilled << " bytes";
+    CHECK( spilled > 0 );
+
+    Grappa::forall(reducers, numred, [=](int64_t i, JoinReducer<int64_t,Tuple1,Tuple2,Tuple3>& r) {
+      for ( auto local_it = r.result->begin(); local_it!= r.result->end(); ++local_it ) {
+        CHECK_EQ( local_it->get(0), local_it->get(2) );
+        CHECK_EQ( local_it->get(1), local_it->get(0)*1000 );
+        CHECK_EQ( local_it->get(3) % 700, local_it->get(2) );
+      }
+      r.result->clear();
+    });
+
+    freeJoinReducers(reducers, numred);
+    on_all_cores([]{ FLAGS_spill_budget = 0; });
+}
+
 
 int main(int argc, char** argv) {
   Grappa::init(&argc, &argv);
   Grappa::run([=] {
     test_hash_join_array();
+    test_hash_join_spill();
   });
   Grappa::finalize();
 }
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <immintrin.h>
+
+/// Distance kernels for k-means assignment.
+///
+/// Centers are stored dimension-major (all centers' first coordinate, then all
+/// their second, ...) and padded to a multiple of 8 with very distant
+/// centers, so one point's squared distances to 4 (AVX2) or 8 (AVX-512)
+/// centers at a time are a broadcast, subtract and fused multiply-add per
+/// dimension. The widest kernel the CPU supports is picked at runtime; the
+/// scalar one is the fallback (and what the compiler vectorizes for SSE2).
+///
+/// nearest_two() walks the centers in blocks that fit in L1 and reuses each
+/// block for a tile of points before moving to the next.
+namespace kmeans_kernels {
+
+  /// coordinate of padding centers: far from any point, but its square is
+  /// still finite (this code is built with -ffast-math, so no infinities)
+  const double FAR = 1e150;
+
+  typedef void (*SqDistKernel)(const double * p, int dims, const double * c, size_t stride, size_t n, double * out);
+
+  /// out[j] = |p - c_j|^2 for j < n (a multiple of 8), where coordinate d of center j is c[d*stride + j]
+  inline void sq_dists_scalar(const double * p, int dims, const double * c, size_t stride, size_t n, double * out) {
+    for (size_t j=0; j<n; j++) out[j] = 0;
+    for (int d=0; d<dims; d++) {
+      const double pd = p[d];
+      const double * cd = c + d*stride;
+      for (size_t j=0; j<n; j++) {
+        double diff = pd - cd[j];
+        out[j] += diff * diff;
+      }
+    }
+  }
+
+  __attribute__((target("avx2,fma")))
+  inline void sq_dists_avx2(const double * p, int dims, const double * c, size_t stride, size_t n, double * out) {
+    for (size_t j=0; j<n; j+=8) {
+      __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+      for (int d=0; d<dims; d++) {
+        __m256d pd = _mm256_broadcast_sd(p+d);
+        __m256d d0 = _mm256_sub_pd(pd, _mm256_loadu_pd(c + d*stride + j));
+        __m256d d1 = _mm256_sub_pd(pd, _mm256_loadu_pd(c + d*stride + j + 4));
+        a0 = _mm256_fmadd_pd(d0, d0, a0);
+        a1 = _mm256_fmadd_pd(d1, d1, a1);
+      }
+      _mm256_storeu_pd(out+j, a0);
+      _mm256_storeu_pd(out+j+4, a1);
+    }
+  }
+
+  __attribute__((target("avx512f")))
+  inline void sq_dists_avx512(const double * p, int dims, const double * c, size_t stride, size_t n, double * out) {
+    for (size_t j=0; j<n; j+=8) {
+      __m512d a = _mm512_setzero_pd();
+      for (int d=0; d<dims; d++) {
+        __m512d diff = _mm512_sub_pd(_mm512_set1_pd(p[d]), _mm512_loadu_pd(c + d*stride + j));
+        a = _mm512_fmadd_pd(diff, diff, a);
+      }
+      _mm512_storeu_pd(out+j, a);
+    }
+  }
+
+  inline SqDistKernel best_kernel() {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return &sq_dists_avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return &sq_dists_avx2;
+    return &sq_dists_scalar;
+  }
+
+  inline const char * kernel_name(SqDistKernel k) {
+    if (k == &sq_dists_avx512) return "avx512";
+    if (k == &sq_dists_avx2) return "avx2";
+    return "scalar";
+  }
+
+  /// k centers of `dims` coordinates, dimension-major and padded
+  class Centers {
+    int dims_;
+    size_t k_, kpad_;
+    std::vector<double> c;
+
+  public:
+    Centers(int dims) : dims_(dims), k_(0), kpad_(0) {}
+
+    /// set the centers from k arrays of coordinates: get(j) is a `const double *` to center j
+    template <typename F>
+    void assign(size_t k, F get) {
+      k_ = k;
+      kpad_ = (k + 7) / 8 * 8;
+      c.assign(dims_ * kpad_, FAR);
+      for (size_t j=0; j<k; j++) {
+        const double * cj = get(j);
+        for (int d=0; d<dims_; d++) c[d*kpad_ + j] = cj[d];
+      }
+    }
+
+    int dims() const { return dims_; }
+    size_t k() const { return k_; }
+    size_t stride() const { return kpad_; }
+    const double * data() const { return c.data(); }
+  };
+
+  /// centers per block: all coordinates of a block take at most `l1_bytes`
+  inline size_t block_centers(int dims, size_t l1_bytes = 16*1024) {
+    return std::max<size_t>(8, l1_bytes / (dims * sizeof(double)) / 8 * 8);
+  }
+
+  /// For each of the n points, the index of its nearest center and the
+  /// squared distances to its nearest and second-nearest centers (the
+  /// second is numeric_limits<double>::max() if there is only one center).
+  inline void nearest_two(const Centers& cs, const double * const * points, size_t n,
+                          int32_t * best, double * d1, double * d2,
+                          SqDistKernel kernel) {
+    for (size_t i=0; i<n; i++) {
+      best[i] = -1;
+      d1[i] = d2[i] = std::numeric_limits<double>::max();
+    }
+    size_t block = block_centers(cs.dims());
+    std::vector<double> buf(block);
+
+    for (size_t j0=0; j0<cs.stride(); j0+=block) {
+      size_t m = std::min(block, cs.stride() - j0);
+      size_t valid = std::min(m, cs.k() - j0);
+      for (size_t i=0; i<n; i++) {
+        kernel(points[i], cs.dims(), cs.data() + j0, cs.stride(), m, buf.data());
+        double b1 = d1[i], b2 = d2[i];
+        int32_t bi = best[i];
+        for (size_t j=0; j<valid; j++) {
+          double x = buf[j];
+          if (x < b1) {
+            b2 = b1;
+            b1 = x;
+            bi = j0 + j;
+          } else if (x < b2) {
+            b2 = x;
+          }
+        }
+        best[i] = bi;
+        d1[i] = b1;
+        d2[i] = b2;
+      }
+    }
+  }
+
+} // namespace kmeans_kernels
@@ -0,0 +1,77 @@
+#include <boost/test/unit_test.hpp>
+#include <random>
+#include <cmath>
+#include "KMeansKernels.hpp"
+
+using namespace kmeans_kernels;
+
+BOOST_AUTO_TEST_SUITE( KMeansKernels_tests );
+
+typedef std::vector<std::vector<double>> Points;
+
+Points random_points(size_t n, int dims, int seed) {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<double> u(-100, 100);
+  Points ps(n, std::vector<double>(dims));
+  for (auto& p : ps) for (auto& x : p) x = u(gen);
+  return ps;
+}
+
+double sq_dist(const std::vector<double>& a, const std::vector<double>& b) {
+  double s = 0;
+  for (size_t d=0; d<a.size(); d++) s += (a[d]-b[d])*(a[d]-b[d]);
+  return s;
+}
+
+BOOST_AUTO_TEST_CASE( testKernels ) {
+  BOOST_MESSAGE("Testing " << kernel_name(best_kernel()) << " kernel against the scalar one");
+
+  for (int dims : { 1, 4, 7 }) {
+    auto centers = random_points(21, dims, dims);
+    Centers cs(dims);
+    cs.assign(centers.size(), [&](size_t j) { return centers[j].data(); });
+    BOOST_CHECK_EQUAL( cs.stride(), 24 );
+
+    auto p = random_points(1, dims, 100)[0];
+    std::vector<double> expected(cs.stride()), got(cs.stride());
+    sq_dists_scalar(p.data(), dims, cs.data(), cs.stride(), cs.stride(), expected.data());
+    best_kernel()(p.data(), dims, cs.data(), cs.stride(), cs.stride(), got.data());
+    for (size_t j=0; j<centers.size(); j++) {
+      BOOST_CHECK_CLOSE( expected[j], sq_dist(p, centers[j]), 1e-9 );
+      BOOST_CHECK_CLOSE( got[j], expected[j], 1e-9 );
+    }
+    // padding is farther than any center
+    for (size_t j=centers.size(); j<cs.stride(); j++) BOOST_CHECK( got[j] > 1e299 );
+  }
+}
+
+BOOST_AUTO_TEST_CASE( testNearestTwo ) {
+  BOOST_MESSAGE("Testing nearest_two against brute force");
+
+  // k small, and large enough to take several L1 blocks of centers
+  for (size_t k : { 2, 9, 3000 }) {
+    int dims = 4;
+    auto centers = random_points(k, dims, k);
+    auto points = random_points(500, dims, k+1);
+    Centers cs(dims);
+    cs.assign(k, [&](size_t j) { return centers[j].data(); });
+
+    std::vector<const double*> ps;
+    for (auto& p : points) ps.push_back(p.data());
+    std::vector<int32_t> best(ps.size());
+    std::vector<double> d1(ps.size()), d2(ps.size());
+    nearest_two(cs, ps.data(), ps.size(), best.data(), d1.data(), d2.data(), best_kernel());
+
+    for (size_t i=0; i<points.size(); i++) {
+      std::vector<double> ds;
+      for (auto& c : centers) ds.push_back(sq_dist(points[i], c));
+      auto sorted = ds;
+      std::sort(sorted.begin(), sorted.end());
+      BOOST_CHECK_CLOSE( d1[i], sorted[0], 1e-9 );
+      BOOST_CHECK_CLOSE( d2[i], sorted[1], 1e-9 );
+      BOOST_CHECK_CLOSE( ds[best[i]], sorted[0], 1e-9 );
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -1,6 +1,8 @@
 #include "MapReduce.hpp"
 #include "relation_io.hpp"
+#include "KMeansKernels.hpp"
 #include <Reducer.hpp>
+#include <Collective.hpp>
 #include <cmath>
 #include <limits>
 #include <random>
@@ -23,6 +25,8 @@ DEFINE_uint64(numred, CORES_NUM_REDUCERS, "Number of reducers; default = 0 (indi
 DEFINE_uint64(maxiters, NO_MAX_ITERS, "Number of max iterations; default = 0 (indicates no maximum)");
 DEFINE_bool(combiner, true, "Use local combiner after mapper. This makes communication O(K*SIZE) instead of O(Input*SIZE)");
 DEFINE_uint64(centers_compared, COMPARE_ALL, "How many centers to check");
+DEFINE_bool(direct, false, "Skip MapReduce: assign points with SIMD distance kernels and triangle-inequality pruning, and allreduce per-core sums");
+DEFINE_uint64(tile, 256, "Points assigned together against each L1-sized block of centers (with --direct)");
 
 
 GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, iterations_runtime, 0);
@@ -32,6 +36,8 @@ GRAPPA_DEFINE_METRIC(SimpleMetric<double>, ingress_runtime, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<double>, normalize_runtime, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<double>, number_of_points, 0);
 GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, kmeans_broadcast_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, kmeans_distances, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, kmeans_pruned, 0);
 
 // RNG
 typedef std::mt19937 RNG;
@@ -195,7 +201,7 @@ void KMeansMapC( const MapReduce::CombiningMapperContext<clusterid_t,Vector<Size
 }
 
 template <int Size=SIZE>
-void KMeansCombine( const MapReduce::CombiningMapperContext<clusterid_t,Vector<Size>,Cluster<Size>>& ctx, clusterid_t id, std::vector<Vector<Size>> points ) {
+void KMeansCombine( const MapReduce::CombiningMapperContext<clusterid_t,Vector<Size>,Cluster<Size>>& ctx, clusterid_t id, std::vector<Vector<Size>>& points ) {
   DCHECK( points.size() > 0 );
 
   Vector<Size> center(0); 
@@ -214,7 +220,7 @@ void KMeansCombine( const MapReduce::CombiningMapperContext<clusterid_t,Vector<S
 
 
 template <int Size=SIZE>
-void KMeansReduce( MapReduce::Reducer<clusterid_t,Vector<Size>,Cluster<Size>>& ctx, clusterid_t id, std::vector<Vector<Size>> points ) {
+void KMeansReduce( MapReduce::Reducer<clusterid_t,Vector<Size>,Cluster<Size>>& ctx, clusterid_t id, std::vector<Vector<Size>>& points ) {
   DCHECK( points.size() > 0 );
   
   Vector<Size> center(0); 
@@ -235,6 +241,165 @@ void KMeansReduce( MapReduce::Reducer<clusterid_t,Vector<Size>,Cluster<Size>>& c
 
 SimpleSymmetric<Vector<SIZE>> normal_reducer;
 
+/// k-means without MapReduce (--direct)
+///
+/// Each core keeps, for each of its points, the assigned center and Hamerly's
+/// bounds: an upper bound on the distance to the assigned center and a lower
+/// bound on the distance to every other center. After the centers move by
+/// delta, the upper bound grows by its center's delta and the lower bound
+/// shrinks by the largest delta; a point whose upper bound is still below
+/// max(lower bound, half the distance from its center to the nearest other
+/// center) can't have changed clusters and is skipped. The rest are assigned
+/// in tiles by kmeans_kernels::nearest_two, which also resets their bounds.
+///
+/// Each core also keeps the per-center sums and counts of its points, updated
+/// only for points that change clusters, so an iteration ends with one
+/// allreduce of k*(SIZE+1) doubles and every core computing the new centers.
+namespace direct {
+
+  struct State {
+    Vector<SIZE> * points;
+    size_t n;
+    std::vector<int32_t> assigned;
+    std::vector<double> upper, lower;
+    std::vector<double> sums;           // per center: SIZE coordinates, then count
+  };
+  State state;
+
+  /// one step per iteration, on all cores; returns how far (squared) the centers moved
+  double iterate(const std::vector<double>& moved, bool first, kmeans_kernels::SqDistKernel kernel) {
+    auto K = means->means.size();
+    const int W = SIZE+1;
+    auto& st = state;
+
+    kmeans_kernels::Centers cs(SIZE);
+    cs.assign(K, [](size_t j) { return means->means[j].data; });
+
+    // half the distance from each center to its nearest other center
+    std::vector<double> half(K);
+    {
+      std::vector<const double*> cps(K);
+      for (size_t j=0; j<K; j++) cps[j] = means->means[j].data;
+      std::vector<int32_t> b(K);
+      std::vector<double> e1(K), e2(K);
+      kmeans_kernels::nearest_two(cs, cps.data(), K, b.data(), e1.data(), e2.data(), kernel);
+      for (size_t j=0; j<K; j++) half[j] = 0.5 * sqrt(e2[j]);
+    }
+
+    // largest and second largest move, for the lower bounds
+    size_t argmax = 0;
+    double max1 = 0, max2 = 0;
+    for (size_t j=0; j<moved.size(); j++) {
+      if (moved[j] > max1) { max2 = max1; max1 = moved[j]; argmax = j; }
+      else if (moved[j] > max2) { max2 = moved[j]; }
+    }
+
+    size_t T = FLAGS_tile;
+    std::vector<size_t> tile;
+    std::vector<const double*> tps(T);
+    std::vector<int32_t> best(T);
+    std::vector<double> d1(T), d2(T);
+    uint64_t computed = 0, pruned = 0;
+
+    auto assign_tile = [&] {
+      for (size_t t=0; t<tile.size(); t++) tps[t] = st.points[tile[t]].data;
+      kmeans_kernels::nearest_two(cs, tps.data(), tile.size(), best.data(), d1.data(), d2.data(), kernel);
+      computed += tile.size() * K;
+      for (size_t t=0; t<tile.size(); t++) {
+        auto i = tile[t];
+        auto a = st.assigned[i];
+        if (a != best[t]) {
+          auto& p = st.points[i];
+          if (a >= 0) {
+            for (int d=0; d<SIZE; d++) st.sums[a*W+d] -= p.data[d];
+            st.sums[a*W+SIZE] -= 1;
+          }
+          for (int d=0; d<SIZE; d++) st.sums[best[t]*W+d] += p.data[d];
+          st.sums[best[t]*W+SIZE] += 1;
+          st.assigned[i] = best[t];
+        }
+        st.upper[i] = sqrt(d1[t]);
+        st.lower[i] = sqrt(d2[t]);
+      }
+      tile.clear();
+      Grappa::yield();
+    };
+
+    for (size_t i=0; i<st.n; i++) {
+      if (!first) {
+        auto a = st.assigned[i];
+        st.upper[i] += moved[a];
+        st.lower[i] -= (a == argmax) ? max2 : max1;
+        double bound = std::max(half[a], st.lower[i]);
+        if (st.upper[i] <= bound) { pruned++; continue; }
+        // tighten the upper bound before searching
+        st.upper[i] = sqrt(st.points[i].sq_dist(means->means[a]));
+        computed++;
+        if (st.upper[i] <= bound) { pruned++; continue; }
+      }
+      tile.push_back(i);
+      if (tile.size() == T) assign_tile();
+    }
+    if (!tile.empty()) assign_tile();
+    kmeans_distances += computed;
+    kmeans_pruned += pruned;
+
+    // new centers from the global sums; centers that lost all their points stay put
+    // (the allreduce sends its array as message payload, so it must be locale-shared)
+    auto totals = locale_alloc<double>(st.sums.size());
+    std::copy(st.sums.begin(), st.sums.end(), totals);
+    allreduce_inplace<double,collective_add>(totals, st.sums.size());
+    double dist = 0;
+    for (size_t j=0; j<K; j++) {
+      auto count = totals[j*W+SIZE];
+      if (count < 0.5) continue;
+      Vector<SIZE> c;
+      for (int d=0; d<SIZE; d++) c.data[d] = totals[j*W+d] / count;
+      dist += c.sq_dist(means->means[j]);
+      means->means[j] = c;
+    }
+    locale_free(totals);
+    return dist;
+  }
+
+  void run(GlobalAddress<Vector<SIZE>> points, size_t numpoints) {
+    on_all_cores([=] {
+      auto& st = state;
+      st.points = points.localize();
+      st.n = (points + numpoints).localize() - st.points;
+      st.assigned.assign(st.n, -1);
+      st.upper.assign(st.n, 0);
+      st.lower.assign(st.n, 0);
+      st.sums.assign(means->means.size() * (SIZE+1), 0);
+
+      auto kernel = kmeans_kernels::best_kernel();
+      if (mycore() == 0) LOG(INFO) << "distance kernel: " << kmeans_kernels::kernel_name(kernel);
+
+      double tempDist = std::numeric_limits<double>::max();
+      uint64_t iter = 0;
+      std::vector<double> moved;
+      while ( (tempDist > FLAGS_converge_dist)
+          and ((FLAGS_maxiters == NO_MAX_ITERS) or (iter < FLAGS_maxiters)) ) {
+        double iter_start = walltime();
+        std::vector<Vector<SIZE>> oldMeans(means->means);
+
+        tempDist = iterate(moved, iter == 0, kernel);
+
+        moved.resize(oldMeans.size());
+        for (size_t j=0; j<oldMeans.size(); j++) moved[j] = sqrt(means->means[j].sq_dist(oldMeans[j]));
+
+        ++iter;
+        if (mycore() == 0) {
+          double this_iter_runtime = walltime() - iter_start;
+          iterations_runtime += this_iter_runtime;
+          LOG(INFO) << "iteration " << iter << ": dist=" << tempDist << " time=" << this_iter_runtime;
+        }
+      }
+    });
+  }
+
+} // namespace direct
+
 void kmeans() {
   const uint64_t K = FLAGS_k;
   uint64_t numred = cores();
@@ -328,6 +493,12 @@ void kmeans() {
 
   double start = walltime();
 
+  if (FLAGS_direct) {
+    direct::run(points, numpoints);
+    kmeans_runtime = walltime() - start;
+    return;
+  }
+
   GlobalAddress<MapReduce::Reducer<clusterid_t,Vector<SIZE>,Cluster<SIZE>>> reducers;
   GlobalAddress<MapReduce::Combiner<clusterid_t,Vector<SIZE>>> combiners;
   reducers = MapReduce::allocateReducers<clusterid_t,Vector<SIZE>,Cluster<SIZE>>( numred );
@@ -0,0 +1,191 @@
+#include "LeapfrogJoin.hpp"
+#include <limits>
+#include <glog/logging.h>
+
+/*
+ * TrieRelation
+ */
+
+TrieRelation::TrieRelation(const Edge * begin, const Edge * end, bool transpose) {
+  std::vector<std::pair<int64_t,int64_t>> tuples;
+  tuples.reserve(end - begin);
+  for (auto e = begin; e != end; e++) {
+    if (transpose) tuples.emplace_back(e->dst, e->src);
+    else           tuples.emplace_back(e->src, e->dst);
+  }
+  std::sort(tuples.begin(), tuples.end());
+  tuples.erase(std::unique(tuples.begin(), tuples.end()), tuples.end());
+
+  vals_.reserve(tuples.size());
+  for (auto& t : tuples) {
+    if (keys_.empty() || keys_.back() != t.first) {
+      keys_.push_back(t.first);
+      offsets_.push_back(vals_.size());
+    }
+    vals_.push_back(t.second);
+  }
+  offsets_.push_back(vals_.size());
+}
+
+std::pair<const int64_t*, const int64_t*> TrieRelation::children(int64_t key) const {
+  auto it = std::lower_bound(keys_.begin(), keys_.end(), key);
+  if (it == keys_.end() || *it != key) return { nullptr, nullptr };
+  auto k = it - keys_.begin();
+  return { vals_.data() + offsets_[k], vals_.data() + offsets_[k+1] };
+}
+
+
+/*
+ * Queries
+ */
+
+CyclicQuery CyclicQuery::triangle() {
+  return { "triangle", 3, { {0,1}, {1,2}, {2,0} }, { {0,1}, {1,2} } };
+}
+
+CyclicQuery CyclicQuery::square() {
+  return { "square", 4, { {0,1}, {1,2}, {2,3}, {3,0} }, { {0,1}, {0,2}, {0,3}, {1,3} } };
+}
+
+CyclicQuery CyclicQuery::clique4() {
+  return { "clique4", 4, { {0,1}, {0,2}, {0,3}, {1,2}, {1,3}, {2,3} }, { {0,1}, {1,2}, {2,3} } };
+}
+
+
+/*
+ * LeapfrogTriejoin
+ */
+
+LeapfrogTriejoin::LeapfrogTriejoin(const CyclicQuery& q, const TrieRelation& R, const TrieRelation& Rt)
+  : q(q)
+  , sources(q.nvars)
+  , cursors(q.nvars)
+  , lower(q.nvars)
+  , binding(q.nvars)
+  , partials(std::max(q.nvars-1, 0))
+  , matches(0)
+{
+  for (auto& a : q.atoms) {
+    int x = a.first, y = a.second;
+    CHECK( x != y ) << "self-join atoms R(x,x) not supported";
+    // whichever variable is bound first indexes the trie
+    if (x < y) {
+      sources[x].push_back({ &R, -1 });
+      sources[y].push_back({ &R, x });
+    } else {
+      sources[y].push_back({ &Rt, -1 });
+      sources[x].push_back({ &Rt, y });
+    }
+  }
+  for (auto& l : q.less) {
+    CHECK( l.first < l.second ) << "`less` constraints must be in binding order";
+    lower[l.second].push_back(l.first);
+  }
+  for (int v=0; v<q.nvars; v++) {
+    CHECK( !sources[v].empty() ) << "variable " << v << " not in any atom";
+    cursors[v].resize(sources[v].size());
+  }
+}
+
+int64_t LeapfrogTriejoin::run(std::function<bool(int,int64_t)> accept,
+                              std::function<void(const int64_t*)> emit) {
+  this->accept = accept;
+  this->emit = emit;
+  std::fill(partials.begin(), partials.end(), 0);
+  matches = 0;
+  if (q.nvars > 0) bind(0);
+  return matches;
+}
+
+void LeapfrogTriejoin::bind(int var) {
+  auto& srcs = sources[var];
+  auto& cs = cursors[var];
+
+  for (size_t i=0; i<srcs.size(); i++) {
+    auto& s = srcs[i];
+    if (s.bound_var < 0) {
+      auto& ks = s.rel->keys();
+      cs[i] = { ks.data(), ks.data() + ks.size() };
+    } else {
+      auto c = s.rel->children(binding[s.bound_var]);
+      cs[i] = { c.first, c.second };
+    }
+    if (cs[i].pos == cs[i].end) return;
+  }
+
+  int64_t x = std::numeric_limits<int64_t>::min();
+  for (auto v : lower[var]) x = std::max(x, binding[v]+1);
+
+  // leapfrog: seek every list to the largest head until they all agree
+  while (true) {
+    bool agree = true;
+    for (auto& c : cs) {
+      c.pos = leapfrog_seek(c.pos, c.end, x);
+      if (c.pos == c.end) return;
+      if (*c.pos > x) {
+        x = *c.pos;
+        agree = false;
+      }
+    }
+    if (!agree) continue;
+
+    if (!accept || accept(var, x)) {
+      binding[var] = x;
+      if (var == q.nvars-1) {
+        matches++;
+        if (emit) emit(binding.data());
+      } else {
+        partials[var]++;
+        bind(var+1);
+      }
+    }
+    if (x == std::numeric_limits<int64_t>::max()) return;
+    x++;
+  }
+}
+
+
+int64_t binary_plan_intermediates(const CyclicQuery& q, const TrieRelation& R, const TrieRelation& Rt,
+                                  std::function<bool(int,int64_t)> accept) {
+  auto ok = [&](int var, int64_t v) { return !accept || accept(var, v); };
+
+  // per key of `T`, its tuples T(k,v) with x_i = k and x_j = v both accepted
+  auto counts = [&](const TrieRelation& T, int i, int j) {
+    std::vector<int64_t> n(T.keys().size(), 0);
+    for (size_t k=0; k<n.size(); k++) {
+      auto key = T.keys()[k];
+      if (!ok(i, key)) continue;
+      auto cs = T.children(key);
+      if (!accept) { n[k] = cs.second - cs.first; continue; }
+      for (auto c = cs.first; c != cs.second; c++) n[k] += ok(j, *c);
+    }
+    return n;
+  };
+  auto lookup = [](const TrieRelation& T, const std::vector<int64_t>& n, int64_t key) -> int64_t {
+    auto it = std::lower_bound(T.keys().begin(), T.keys().end(), key);
+    return (it == T.keys().end() || *it != key) ? 0 : n[it - T.keys().begin()];
+  };
+
+  auto in1 = counts(Rt, 1, 0);   // R(x_0,x_1) into each x_1
+  auto out1 = counts(R, 1, 2);   // R(x_1,x_2) out of each x_1
+
+  // |R(x_0,x_1) join R(x_1,x_2)|
+  int64_t two_paths = 0;
+  for (size_t k=0; k<R.keys().size(); k++) {
+    if (out1[k] > 0) two_paths += lookup(Rt, in1, R.keys()[k]) * out1[k];
+  }
+  if (q.nvars < 4) return two_paths;
+
+  // |R(x_0,x_1) join R(x_1,x_2) join R(x_2,x_3)|: in(x_1) * out(x_2) for each accepted (x_1,x_2)
+  auto out2 = counts(R, 2, 3);
+  int64_t three_paths = 0;
+  for (auto b : R.keys()) {
+    auto in_b = lookup(Rt, in1, b);
+    if (in_b == 0) continue;
+    auto cs = R.children(b);
+    for (auto c = cs.first; c != cs.second; c++) {
+      if (ok(2, *c)) three_paths += in_b * lookup(R, out2, *c);
+    }
+  }
+  return two_paths + three_paths;
+}
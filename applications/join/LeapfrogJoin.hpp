@@ -0,0 +1,129 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+#include "local_graph.hpp"
+
+/// Binary relation sorted and indexed as a two-level trie: the distinct values
+/// of the first attribute in order, each with its sorted, deduplicated values
+/// of the second attribute.
+class TrieRelation {
+  private:
+    std::vector<int64_t> keys_;
+    std::vector<int64_t> offsets_; // keys_.size()+1 offsets into vals_
+    std::vector<int64_t> vals_;
+  public:
+    /// index edges (src,dst) by src, or by dst if `transpose`
+    TrieRelation(const Edge * begin, const Edge * end, bool transpose = false);
+    TrieRelation(const std::vector<Edge>& edges, bool transpose = false)
+      : TrieRelation(edges.data(), edges.data()+edges.size(), transpose) {}
+
+    /// sorted distinct first attributes
+    const std::vector<int64_t>& keys() const { return keys_; }
+
+    /// sorted second attributes paired with `key`, as [first,last) (empty if none)
+    std::pair<const int64_t*, const int64_t*> children(int64_t key) const;
+
+    int64_t degree(int64_t key) const {
+      auto c = children(key);
+      return c.second - c.first;
+    }
+
+    /// number of (deduplicated) tuples
+    size_t size() const { return vals_.size(); }
+};
+
+/// Conjunctive query over a single binary relation R: each atom (i,j) is
+/// R(x_i,x_j), and each `less` pair (i,j) requires x_i < x_j (for breaking
+/// symmetry). Variables are bound in order x_0, x_1, ...
+///
+/// The built-in queries assume R is symmetric (each undirected edge stored both
+/// ways, as for triangles.cpp), and their `less` pairs count each undirected
+/// cycle or clique once rather than once per automorphism of the pattern.
+struct CyclicQuery {
+  std::string name;
+  int nvars;
+  std::vector<std::pair<int,int>> atoms;
+  std::vector<std::pair<int,int>> less;
+
+  /// R(x,y),R(y,z),R(z,x), x < y < z
+  static CyclicQuery triangle();
+  /// R(a,b),R(b,c),R(c,d),R(d,a), with a the least vertex and b < d
+  static CyclicQuery square();
+  /// R(a,b),R(a,c),R(a,d),R(b,c),R(b,d),R(c,d), a < b < c < d
+  static CyclicQuery clique4();
+};
+
+/// First position in sorted [first,last) holding a value >= x, found by galloping
+/// from `first` (exponential probe, then binary search), so a run of seeks over
+/// the same list costs O(log gap) each rather than O(log n).
+inline const int64_t * leapfrog_seek(const int64_t * first, const int64_t * last, int64_t x) {
+  if (first == last || *first >= x) return first;
+  // invariant: *lo < x
+  const int64_t * lo = first;
+  size_t step = 1;
+  while (step < static_cast<size_t>(last - lo) && lo[step] < x) {
+    lo += step;
+    step <<= 1;
+  }
+  const int64_t * hi = lo + std::min(step, static_cast<size_t>(last - lo));
+  return std::lower_bound(lo+1, hi, x);
+}
+
+/// Worst-case optimal multiway join (leapfrog triejoin) of a CyclicQuery over R.
+///
+/// Rather than joining one pair of atoms at a time, each variable is bound in
+/// turn to the values in the intersection of every atom that mentions it,
+/// computed by leapfrogging galloping seeks over the sorted tries. So partial
+/// bindings are only produced if they are consistent with every atom over the
+/// variables bound so far.
+class LeapfrogTriejoin {
+  private:
+    /// one sorted list intersected when binding a variable
+    struct Source {
+      const TrieRelation * rel;
+      int bound_var;  // trie level 2 under this variable's binding, or -1 for level 1 (keys)
+    };
+    /// position in one of those lists
+    struct Cursor { const int64_t * pos; const int64_t * end; };
+
+    const CyclicQuery& q;
+    std::vector<std::vector<Source>> sources;  // per variable
+    std::vector<std::vector<Cursor>> cursors;  // per variable
+    std::vector<std::vector<int>> lower;       // per variable: vars it must exceed
+    std::vector<int64_t> binding;
+    std::vector<int64_t> partials;
+    int64_t matches;
+
+    std::function<bool(int,int64_t)> accept;
+    std::function<void(const int64_t*)> emit;
+
+    void bind(int var);
+
+  public:
+    /// `q`, `R` and its transpose `Rt` must outlive this object
+    LeapfrogTriejoin(const CyclicQuery& q, const TrieRelation& R, const TrieRelation& Rt);
+
+    /// Count matches of the query. `accept(var, value)`, if given, can reject a
+    /// binding (e.g. to keep only the values this core's partition is responsible
+    /// for); `emit(values)` is called for every full match.
+    int64_t run(std::function<bool(int,int64_t)> accept = nullptr,
+                std::function<void(const int64_t*)> emit = nullptr);
+
+    /// number of partial bindings of x_0..x_k produced by the last run(), for
+    /// each k < nvars-1 (the intermediate results of this plan)
+    const std::vector<int64_t>& intermediates() const { return partials; }
+};
+
+/// Intermediate tuples the path-shaped cascades of binary joins in this directory
+/// (triangles*.cpp, squares*.cpp) produce on R before closing the cycle:
+/// |R(x_0,x_1) join R(x_1,x_2)|, plus |... join R(x_2,x_3)| for 4-variable queries.
+/// With `accept`, each atom R(x_i,x_j) only holds the tuples whose values it accepts
+/// for x_i and x_j (as in LeapfrogTriejoin::run), i.e. one hypercube cell's share.
+int64_t binary_plan_intermediates(const CyclicQuery& q, const TrieRelation& R, const TrieRelation& Rt,
+                                  std::function<bool(int,int64_t)> accept = nullptr);
@@ -8,3 +8,5 @@ GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, mr_mapping_runtime, 0);
 GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, mr_combining_runtime, 0);
 GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, mr_reducing_runtime, 0);
 GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, mr_reallocation_runtime, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, mr_shuffled_pairs, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, mr_shuffle_messages, 0);
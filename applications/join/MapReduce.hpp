@@ -7,14 +7,18 @@
 
 #include <functional>
 #include <cstdint>
+#include <cstring>
 #include <vector>
-#include <unordered_map>
+
+#include "Spill.hpp"
 
 
 GRAPPA_DECLARE_METRIC(SummarizingMetric<double>, mr_mapping_runtime);
 GRAPPA_DECLARE_METRIC(SummarizingMetric<double>, mr_combining_runtime);
 GRAPPA_DECLARE_METRIC(SummarizingMetric<double>, mr_reducing_runtime);
 GRAPPA_DECLARE_METRIC(SummarizingMetric<double>, mr_reallocation_runtime);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, mr_shuffled_pairs);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, mr_shuffle_messages);
 
 namespace MapReduce {
 
@@ -39,22 +43,291 @@ void forall_symmetric(GlobalAddress<RandomAccess> vs, AF accessor, CF f ) {
       //VLOG(1) << "wait done";
 }
 
+/// Values grouped by key, without a container per key: an open-addressing
+/// table maps each key to a dense group id, and values are appended to one
+/// arena tagged with their group. Reading the groups sorts the arena by group
+/// (counting sort) so each group's values are contiguous.
+///
+/// Alternatively, with combine(), each group holds a single value that new
+/// values are folded into as they arrive (don't mix append() and combine()).
+///
+/// With --spill_budget, a table that is among the largest on an over-budget
+/// core writes its groups to disk as a sorted run and starts over empty;
+/// for_each_group() then merges the runs back by key (see Spill.hpp).
+template <typename K, typename V>
+class GroupTable : public spill::Spillable {
+  std::vector<K> keys_;                         // per group
+  std::vector<uint32_t> slots_;                 // group+1, or 0 if empty
+  std::vector<std::pair<uint32_t,V>> values_;   // (group, value) arena
+
+  spill::Runs<K,V> runs_;
+  size_t charged_;
+  std::function<void(V&, const V&)> op_;        // combine()'s op, to fold values merged from runs
+
+  void grow() {
+    slots_.assign(std::max<size_t>(16, 2*slots_.size()), 0);
+    size_t mask = slots_.size()-1;
+    for (size_t g=0; g<keys_.size(); g++) {
+      size_t s = bittwiddle::mix64(std::hash<K>()(keys_[g])) & mask;
+      while (slots_[s] != 0) s = (s+1) & mask;
+      slots_[s] = g+1;
+    }
+  }
+
+  uint32_t find_or_insert(const K& key, bool * inserted) {
+    if (2*(keys_.size()+1) > slots_.size()) grow();
+    size_t mask = slots_.size()-1;
+    size_t s = bittwiddle::mix64(std::hash<K>()(key)) & mask;
+    for (; slots_[s] != 0; s = (s+1) & mask) {
+      if (keys_[slots_[s]-1] == key) {
+        *inserted = false;
+        return slots_[s]-1;
+      }
+    }
+    keys_.push_back(key);
+    slots_[s] = keys_.size();
+    *inserted = true;
+    return keys_.size()-1;
+  }
+
+  std::vector<spill::Entry<K,V>> entries() const {
+    std::vector<spill::Entry<K,V>> es;
+    es.reserve(values_.size());
+    for (auto& v : values_) es.emplace_back(keys_[v.first], v.second);
+    return es;
+  }
+
+  void free_memory() {
+    std::vector<K>().swap(keys_);
+    std::vector<uint32_t>().swap(slots_);
+    std::vector<std::pair<uint32_t,V>>().swap(values_);
+  }
+
+  void spill(std::true_type) {
+    auto es = entries();
+    free_memory();
+    runs_.write(es);
+    spill::update(this, charged_, 0);
+  }
+  void spill(std::false_type) { LOG(FATAL) << "spilling groups that aren't trivially copyable"; }
+
+  template <typename F>
+  void for_each_merged_group(F f, std::true_type) {
+    auto es = entries();
+    free_memory();
+    spill::update(this, charged_, es.capacity() * sizeof(es[0]));
+    std::stable_sort(es.begin(), es.end(), spill::key_less<K,V>);
+
+    spill::Merge<K,V> merge(runs_, es);
+    std::vector<V> group;
+    while (!merge.done()) {
+      K key = merge.next(group);
+      if (op_) {
+        for (size_t i=1; i<group.size(); i++) op_(group[0], group[i]);
+        group.resize(1);
+      }
+      f(key, group);
+    }
+  }
+  template <typename F>
+  void for_each_merged_group(F f, std::false_type) {}
+
+public:
+  GroupTable() : charged_(0) {
+    if (spill::can_spill<K,V>::value) spill::track(this);
+  }
+  GroupTable(const GroupTable&) = delete;
+  ~GroupTable() {
+    if (spill::can_spill<K,V>::value) spill::untrack(this);
+    spill::update(this, charged_, 0);
+  }
+
+  void append(const K& key, const V& val) {
+    bool inserted;
+    values_.emplace_back(find_or_insert(key, &inserted), val);
+    if (spill::enabled()) spill::update(this, charged_, memory_bytes());
+  }
+
+  /// fold `val` into the key's value with op(V& acc, const V& val)
+  template <typename Op>
+  void combine(const K& key, const V& val, Op op) {
+    bool inserted;
+    auto g = find_or_insert(key, &inserted);
+    if (inserted) {
+      DCHECK_EQ( g, values_.size() ) << "combine() on a table filled by append()";
+      values_.emplace_back(g, val);
+      if (spill::enabled()) {
+        if (!op_) op_ = op;
+        spill::update(this, charged_, memory_bytes());
+      }
+    } else {
+      op(values_[g].second, val);
+    }
+  }
+
+  size_t num_groups() const { return keys_.size(); }
+  size_t size() const { return values_.size(); }
+  bool spilled() const { return !runs_.empty(); }
+
+  size_t memory_bytes() const {
+    return keys_.capacity() * sizeof(K) + slots_.capacity() * sizeof(uint32_t)
+         + values_.capacity() * sizeof(values_[0]);
+  }
+  void spill() { spill(spill::can_spill<K,V>()); }
+
+  /// call f(const K& key, std::vector<V>& values) for each group; once the
+  /// table has spilled, this reads the runs back (so call it from a task).
+  /// The groups are moved out of the table first, since f may deliver pairs
+  /// locally and push the core over budget, which must not spill the table
+  /// being read; clear() the table before filling it again.
+  template <typename F>
+  void for_each_group(F f) {
+    if (spilled()) {
+      for_each_merged_group(f, spill::can_spill<K,V>());
+      return;
+    }
+    if (values_.empty()) return;
+    std::vector<K> keys;
+    std::vector<std::pair<uint32_t,V>> values;
+    keys.swap(keys_);
+    values.swap(values_);
+    std::vector<uint32_t>().swap(slots_);
+
+    std::vector<size_t> offsets(keys.size()+1, 0);
+    for (auto& v : values) offsets[v.first+1]++;
+    for (size_t g=0; g<keys.size(); g++) offsets[g+1] += offsets[g];
+
+    std::vector<V> grouped(values.size(), values[0].second);
+    auto pos = offsets;
+    for (auto& v : values) grouped[pos[v.first]++] = v.second;
+    std::vector<std::pair<uint32_t,V>>().swap(values);
+    if (spill::enabled()) {
+      spill::update(this, charged_, keys.capacity() * sizeof(K) + grouped.capacity() * sizeof(V)
+                                    + offsets.capacity() * sizeof(size_t));
+    }
+
+    std::vector<V> group;
+    for (size_t g=0; g<keys.size(); g++) {
+      group.assign(grouped.begin()+offsets[g], grouped.begin()+offsets[g+1]);
+      f(keys[g], group);
+    }
+  }
+
+  void clear() {
+    keys_.clear();
+    slots_.clear();
+    values_.clear();
+    runs_.clear();
+    if (spill::enabled()) spill::update(this, charged_, memory_bytes());
+  }
+};
+
 template <typename K, typename V, typename OutType>
 struct Reducer {
-  std::unordered_map<K, std::vector<V>> * groups;
+  GroupTable<K,V> * groups;
   std::vector<OutType> * result;
 
-  Reducer() : groups(new std::unordered_map<K, std::vector<V>>()), result(new std::vector<OutType>()) {}
+  Reducer() : groups(new GroupTable<K,V>()), result(new std::vector<OutType>()) {}
 
 } GRAPPA_BLOCK_ALIGNED; // using pointers as members because of #157
 
+namespace impl {
+
+  /// Per-core state for shuffling (key, value) pairs to Reducers.
+  ///
+  /// Pairs for a remote core are buffered and sent as one message per batch
+  /// (about MAX_MESSAGE_SIZE bytes), rather than one message per pair. If a job
+  /// provides an associative `combine_op`, pairs are also folded into a table of
+  /// one value per key on the map side before they are sent, and on the reduce
+  /// side as they arrive.
+  template <typename K, typename V, typename OutType>
+  struct Shuffle {
+    struct Record {
+      GlobalAddress<Reducer<K,V,OutType>> reducer;  // localized by the receiver
+      K key;
+      V val;
+    };
+    static const size_t batch_size = (MAX_MESSAGE_SIZE / sizeof(Record) > 1) ? MAX_MESSAGE_SIZE / sizeof(Record) - 1 : 1;
+
+    /// a batch travels by value in its message, so the sender never waits for it to go out
+    struct Batch {
+      size_t n;
+      char records[batch_size * sizeof(Record)];  // Records, unaligned
+    };
+
+    static std::vector<std::vector<Record>> outgoing;  // per destination core
+    static GroupTable<K,V> * map_side;                 // per core, only with combine_op
+    static std::function<void(V&, const V&)> combine_op;
+
+    static void deliver(const Record& r) {
+      auto groups = r.reducer.pointer()->groups;
+      if (combine_op) groups->combine(r.key, r.val, combine_op);
+      else            groups->append(r.key, r.val);
+    }
+
+    template < Grappa::GlobalCompletionEvent * GCE >
+    static void flush(Core dest) {
+      auto& out = outgoing[dest];
+      if (out.empty()) return;
+
+      Batch b;
+      b.n = out.size();
+      memcpy(b.records, out.data(), b.n * sizeof(Record));
+      out.clear();
+
+      mr_shuffle_messages++;
+      GCE->enroll();
+      Core origin = Grappa::mycore();
+      Grappa::send_heap_message(dest, [origin, b] {
+        Record r;
+        for (size_t i=0; i<b.n; i++) {
+          memcpy(&r, b.records + i*sizeof(Record), sizeof(Record));
+          deliver(r);
+        }
+        GCE->send_completion(origin);
+      });
+    }
+
+    template < Grappa::GlobalCompletionEvent * GCE >
+    static void send(GlobalAddress<Reducer<K,V,OutType>> r, const K& key, const V& val) {
+      mr_shuffled_pairs++;
+      if (r.core() == Grappa::mycore()) {
+        deliver(Record{ r, key, val });
+        return;
+      }
+      if (outgoing.empty()) outgoing.resize(Grappa::cores());
+      outgoing[r.core()].push_back(Record{ r, key, val });
+      if (outgoing[r.core()].size() >= batch_size) flush<GCE>(r.core());
+    }
+
+    /// send this core's partial batches (and map-side combined values, if any); call on all cores
+    template < Grappa::GlobalCompletionEvent * GCE >
+    static void flush_all(GlobalAddress<Reducer<K,V,OutType>> reducers, int64_t num_reducers) {
+      if (map_side) {
+        map_side->for_each_group([=](const K& key, std::vector<V>& vals) {
+          send<GCE>(reducers + std::hash<K>()(key) % num_reducers, key, vals[0]);
+        });
+        map_side->clear();
+      }
+      for (size_t c=0; c<outgoing.size(); c++) flush<GCE>(c);
+    }
+  };
+
+  template <typename K, typename V, typename OutType>
+  std::vector<std::vector<typename Shuffle<K,V,OutType>::Record>> Shuffle<K,V,OutType>::outgoing;
+  template <typename K, typename V, typename OutType>
+  GroupTable<K,V> * Shuffle<K,V,OutType>::map_side = nullptr;
+  template <typename K, typename V, typename OutType>
+  std::function<void(V&, const V&)> Shuffle<K,V,OutType>::combine_op;
+
+} // namespace impl
+
+/// Buffers the pair for the Reducer's core; batches are sent when full, and
+/// by flushIntermediate() (which mapExecute calls after the map).
 template <typename K, typename V, typename OutType, Grappa::GlobalCompletionEvent * GCE = &default_mr_gce>
 void reducer_append( GlobalAddress<Reducer<K,V,OutType>> r, K key, V val ) {
-  Grappa::delegate::call<Grappa::async, GCE>(r.core(), [=] {
-    VLOG(5) << "add (" << key << ", " << val << ") at " << r.pointer();
-    std::vector<V>& slot = (*(r->groups))[key];
-    slot.push_back(val);
-  });
+  VLOG(5) << "add (" << key << ", " << val << ") for " << r;
+  impl::Shuffle<K,V,OutType>::template send<GCE>(r, key, val);
 }
 // Overload for GCE specified
 template <Grappa::GlobalCompletionEvent * GCE, typename K, typename V, typename OutType>
@@ -62,6 +335,35 @@ void reducer_append( GlobalAddress<Reducer<K,V,OutType>> r, K key, V val ) {
   reducer_append<K,V,OutType,GCE>(r, key, val);
 }
 
+/// Send all buffered intermediate pairs and wait until every Reducer has them.
+template <typename K, typename V, typename OutType, Grappa::GlobalCompletionEvent * GCE = &default_mr_gce>
+void flushIntermediate( GlobalAddress<Reducer<K,V,OutType>> reducers, int64_t num_reducers ) {
+  // hold the GCE open until every core has enrolled its sends
+  GCE->enroll();
+  Grappa::on_all_cores([=] {
+    impl::Shuffle<K,V,OutType>::template flush_all<GCE>(reducers, num_reducers);
+  });
+  GCE->complete();
+  GCE->wait();
+}
+
+/// Use an associative, commutative op(V& acc, const V& val) to combine values
+/// with the same key eagerly, on both the map and reduce side, in subsequent
+/// jobs on Reducer<K,V,OutType>s; each key is then reduced with one value.
+/// Pass nullptr to go back to reducing every value.
+template <typename K, typename V, typename OutType, typename Op>
+void setCombineOp( Op op ) {
+  Grappa::on_all_cores([=] {
+    typedef impl::Shuffle<K,V,OutType> S;
+    S::combine_op = op;
+    if (S::combine_op && !S::map_side) S::map_side = new GroupTable<K,V>();
+    if (!S::combine_op && S::map_side) {
+      delete S::map_side;
+      S::map_side = nullptr;
+    }
+  });
+}
+
 template <typename K, typename V, typename OutType>
 struct MapperContext {
   GlobalAddress<Reducer<K,V,OutType>> reducers;
@@ -73,6 +375,11 @@ struct MapperContext {
 
   template < Grappa::GlobalCompletionEvent * GCE=&default_mr_gce >
   void emitIntermediate(K key, V val) const {
+    typedef impl::Shuffle<K,V,OutType> S;
+    if (S::map_side) {
+      S::map_side->combine(key, val, S::combine_op);
+      return;
+    }
     auto index = std::hash<K>()(key) % num_reducers;
     auto target = reducers + index;
     VLOG(5) << "index = " << index;
@@ -82,9 +389,9 @@ struct MapperContext {
 
 template <typename K, typename V>
 struct Combiner {
-  std::unordered_map<K, std::vector<V>> * groups;
+  GroupTable<K,V> * groups;
 
-  Combiner() : groups(new std::unordered_map<K, std::vector<V>>()) {}
+  Combiner() : groups(new GroupTable<K,V>()) {}
 } GRAPPA_BLOCK_ALIGNED;
 
 template <typename K, typename V, typename OutType>
@@ -101,8 +408,7 @@ struct CombiningMapperContext {
   // called within user map
   void emitIntermediate(K key, V val) const {
     DVLOG(5) << "push key " << key;
-    std::vector<V>& slot = (*(combining->groups))[key];
-    slot.push_back(val);
+    combining->groups->append(key, val);
   }
 
   // called within user combine
@@ -113,22 +419,21 @@ struct CombiningMapperContext {
     DVLOG(5) << "index = " << index;
     reducer_append<GCE>( target, key, val );
   }
-
-  void combineDoneWithKey( K key ) const {
-    DVLOG(4) << "clear key " << key;
-    (*(combining->groups))[key].clear();
-  }
 };
 
-template < typename K, typename V, typename OutType, typename CombineF >
+template < typename K, typename V, typename OutType, typename CombineF, Grappa::GlobalCompletionEvent * GCE=&default_mr_gce >
 void combineExecute(CombiningMapperContext<K,V,OutType> ctx, CombineF combinef) {
+  GCE->enroll();
   Grappa::on_all_cores([=] {
       auto local = ctx.combining->groups;
-      for (auto it=local->begin(); it!=local->end(); ++it) {
-        combinef( ctx, it->first, it->second );
-        ctx.combineDoneWithKey( it->first );
-      }
+      local->for_each_group([=](const K& key, std::vector<V>& vals) {
+        combinef( ctx, key, vals );
+      });
+      local->clear();
+      impl::Shuffle<K,V,OutType>::template flush_all<GCE>(ctx.reducers, ctx.num_reducers);
   });
+  GCE->complete();
+  GCE->wait();
 }
      
 
@@ -145,6 +450,7 @@ void mapExecute(MapperContext<K, V, OutType> ctx, GlobalAddress<T> keyvals, size
   Grappa::forall<GCE>(keyvals, num, [=]( T& kv ) {
      mf(ctx, kv);
   });
+  flushIntermediate<K,V,OutType,GCE>(ctx.reducers, ctx.num_reducers);
 }  
 
 //TODO get rid of this code duplication
@@ -162,14 +468,15 @@ void mapExecute(MapperContext<K, V, OutType> ctx, GlobalAddress<RA> keyvals_sym,
                                      [=]( T& kv ) { 
      mf(ctx, kv);
   });
+  flushIntermediate<K,V,OutType,GCE>(ctx.reducers, ctx.num_reducers);
 }  
 
 template < typename K, typename V, typename OutType, typename ReduceF, Grappa::GlobalCompletionEvent * GCE=&default_mr_gce > 
 void reduceExecute(GlobalAddress<Reducer<K,V,OutType>> reducers, size_t num, ReduceF rf) {
   Grappa::forall<GCE>(reducers, num, [=]( int64_t i, Reducer<K,V,OutType>& reducer) {
-    for ( auto local_it = reducer.groups->begin(); local_it!= reducer.groups->end(); ++local_it ) {
-      rf(reducer, local_it->first, local_it->second );
-    }
+    reducer.groups->for_each_group([&reducer,rf](const K& key, std::vector<V>& vals) {
+      rf(reducer, key, vals );
+    });
     // deallocate the group
     reducer.groups->clear();
   });
@@ -31,7 +31,7 @@ struct TupleB {
 
 //template < class IntIterable >
 //void NumCountReduce( const Reducer<int64_t,int64_t,WordCount>& ctx, int64_t word, IntIterable counts ) {
-void NumCountReduce( Reducer<int64_t,int64_t,WordCount>& ctx, int64_t word, std::vector<int64_t> counts ) {
+void NumCountReduce( Reducer<int64_t,int64_t,WordCount>& ctx, int64_t word, std::vector<int64_t>& counts ) {
     int64_t sum = 0; 
     int64_t i = 0;
     for ( auto local_it = counts.begin(); local_it!= counts.end(); ++local_it ) {
@@ -42,7 +42,7 @@ void NumCountReduce( Reducer<int64_t,int64_t,WordCount>& ctx, int64_t word, std:
     VLOG(1) << "reducer key " << word << " processed " << i << " values";
 }
 
-void NumCountCombiner( const CombiningMapperContext<int64_t,int64_t,WordCount>& ctx, int64_t word, std::vector<int64_t> counts ) {
+void NumCountCombiner( const CombiningMapperContext<int64_t,int64_t,WordCount>& ctx, int64_t word, std::vector<int64_t>& counts ) {
   int64_t sum = 0; 
   for ( auto local_it = counts.begin(); local_it!= counts.end(); ++local_it ) {
     sum += *local_it; 
@@ -161,12 +161,130 @@ void test_map_on_symmetric_randomAccess() {
 }
 
 
+// run the word count over `words`, where each of the `dictionary_size` words
+// appears equally often, and check every reducer's counts; returns the job time
+double run_word_count(GlobalAddress<int64_t> words, size_t numw, size_t dictionary_size,
+                      GlobalAddress<Reducer<int64_t,int64_t,WordCount>> reds, size_t numred) {
+  auto start = Grappa::walltime();
+  MapReduceJobExecute<int64_t, int64_t, int64_t, WordCount, decltype(NumCountMap), decltype(NumCountReduce)>(words, numw, reds, numred, &NumCountMap, &NumCountReduce);
+  auto time = Grappa::walltime() - start;
+
+  auto counter = Grappa::symmetric_global_alloc<aligned_int64_t>();
+  auto keys = Grappa::symmetric_global_alloc<aligned_int64_t>();
+  Grappa::forall(reds, numred, [=](int64_t i, Reducer<int64_t, int64_t, WordCount>& r) {
+    for ( auto local_it = r.result->begin(); local_it!= r.result->end(); ++local_it ) {
+      CHECK_EQ( local_it->count, numw / dictionary_size ) << "word " << local_it->word;
+      counter->_x += local_it->count;
+      keys->_x++;
+    }
+    r.result->clear();
+  });
+  CHECK_EQ( (Grappa::reduce<int64_t, aligned_int64_t, &collective_add, &getX>(counter)), numw );
+  CHECK_EQ( (Grappa::reduce<int64_t, aligned_int64_t, &collective_add, &getX>(keys)), dictionary_size );
+  return time;
+}
+
+void test_map_on_array_combine_op() {
+  LOG(INFO) << "test_map_on_array_combine_op";
+    size_t numw = 100000;
+    size_t dictionary_size = 1000;
+    size_t numred = 2*Grappa::cores();
+    GlobalAddress<int64_t> words = Grappa::global_alloc<int64_t>(numw);
+    Grappa::forall(words, numw, [=](int64_t i, int64_t& w) {
+      w = (i*541) % dictionary_size;
+    });
+
+    auto reds = allocateReducers<int64_t,int64_t,WordCount>( numred );
+    auto run = [=](const char * name) {
+      auto time = run_word_count(words, numw, dictionary_size, reds, numred);
+      LOG(INFO) << name << ": " << time << " s, "
+                << Grappa::sum_all_cores([]{ return mr_shuffle_messages.value(); }) << " shuffle messages";
+      Grappa::on_all_cores([]{ mr_shuffle_messages.reset(); });
+    };
+
+    run("grouped");
+    setCombineOp<int64_t,int64_t,WordCount>([](int64_t& acc, const int64_t& c) { acc += c; });
+    run("combined");
+    setCombineOp<int64_t,int64_t,WordCount>(nullptr);
+    run("grouped again");
+}
+
+void test_map_on_array_spill() {
+  LOG(INFO) << "test_map_on_array_spill";
+    size_t numw = 100000;
+    size_t dictionary_size = 1000;
+    size_t numred = 2*Grappa::cores();
+    GlobalAddress<int64_t> words = Grappa::global_alloc<int64_t>(numw);
+    Grappa::forall(words, numw, [=](int64_t i, int64_t& w) {
+      w = (i*541) % dictionary_size;
+    });
+
+    // a budget of a few thousand pairs per core
+    Grappa::on_all_cores([]{
+      FLAGS_spill_budget = 1 << 16;
+      spilled_bytes.reset();
+    });
+
+    auto reds = allocateReducers<int64_t,int64_t,WordCount>( numred );
+    auto run = [=](const char * name) {
+      auto time = run_word_count(words, numw, dictionary_size, reds, numred);
+      auto spilled = Grappa::sum_all_cores([]{ return spilled_bytes.value(); });
+      LOG(INFO) << name << ": " << time << " s, spilled " << spilled << " bytes";
+      CHECK( spilled > 0 );
+      Grappa::on_all_cores([]{ spilled_bytes.reset(); });
+    };
+
+    run("grouped, spilling");
+    // a tiny budget for the map-side and reducer tables of combined counts
+    Grappa::on_all_cores([]{ FLAGS_spill_budget = 1 << 12; });
+    setCombineOp<int64_t,int64_t,WordCount>([](int64_t& acc, const int64_t& c) { acc += c; });
+    run("combined, spilling");
+    setCombineOp<int64_t,int64_t,WordCount>(nullptr);
+    Grappa::on_all_cores([]{ FLAGS_spill_budget = 0; });
+}
+
+// pairs delivered while reading a table's groups can push the core over
+// budget; the table being read must still hand over every group
+void test_group_table_spill_during_iteration() {
+  LOG(INFO) << "test_group_table_spill_during_iteration";
+  size_t ngroups = 500;
+  GroupTable<int64_t,int64_t> read, written;
+  for (size_t i=0; i<4*ngroups; i++) read.append(i % ngroups, 1);
+
+  FLAGS_spill_budget = 1 << 12;
+  spilled_bytes.reset();
+  size_t groups = 0, values = 0;
+  read.for_each_group([&](const int64_t& key, std::vector<int64_t>& vals) {
+    groups++;
+    values += vals.size();
+    for (auto v : vals) written.append(key, v);
+  });
+  CHECK_EQ( groups, ngroups );
+  CHECK_EQ( values, 4*ngroups );
+  CHECK( spilled_bytes.value() > 0 );
+  read.clear();
+
+  groups = values = 0;
+  written.for_each_group([&](const int64_t& key, std::vector<int64_t>& vals) {
+    groups++;
+    values += vals.size();
+  });
+  CHECK_EQ( groups, ngroups );
+  CHECK_EQ( values, 4*ngroups );
+  written.clear();
+  FLAGS_spill_budget = 0;
+  spilled_bytes.reset();
+}
+
 int main(int argc, char** argv) {
   Grappa::init(&argc, &argv);
   Grappa::run([=] {
     test_map_on_array();
     test_map_on_symmetric_randomAccess();
     test_map_on_array_combining();
+    test_map_on_array_combine_op();
+    test_map_on_array_spill();
+    test_group_table_spill_during_iteration();
   });
   Grappa::finalize();
 }
@@ -15,6 +15,7 @@
 #include "squares_partition.hpp"
 #include "squares_bushy.hpp"
 #include "squares_partition_bushy.hpp"
+#include "leapfrog_partition.hpp"
 
 // graph gen
 #include "generator/make_graph.h"
@@ -101,7 +102,10 @@ int main(int argc, char** argv) {
       {"SquareQuery", new SquareQuery()}, 
       {"SquarePartition4way", new SquarePartition4way()},
       {"SquarePartitionBushy4way", new SquarePartitionBushy4way()},
-      {"SquareBushyPlan", new SquareBushyPlan()}
+      {"SquareBushyPlan", new SquareBushyPlan()},
+      {"LeapfrogTriangle", new LeapfrogPartition(&CyclicQuery::triangle)},
+      {"LeapfrogSquare", new LeapfrogPartition(&CyclicQuery::square)},
+      {"LeapfrogClique4", new LeapfrogPartition(&CyclicQuery::clique4)}
       });
 
     Query& q = *(qm[FLAGS_query]);
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+
+#include <glog/logging.h>
+#include <common.hpp>
+
+/// Cache-conscious local equijoin of two (key, value) lists.
+///
+/// Both sides are radix-partitioned on a hash of the key until a partition of
+/// the build side (the smaller one) and its table fit in `cache_bytes`. Each
+/// build partition gets a compact open-addressing table of (hash tag, index)
+/// slots, and the matching probe partition is looked up in batches, prefetching
+/// every slot of a batch before comparing any of them.
+///
+/// The hash is a full 64-bit mix of std::hash<K>, so keys that all landed on
+/// one reducer of HashJoinContext (std::hash<K>(key) % num_reducers == i)
+/// still spread evenly over partitions and slots.
+namespace radix_join {
+
+  template <typename K, typename V>
+  struct Hashed {
+    uint64_t hash;
+    K key;
+    V val;
+  };
+
+  /// tuples grouped by the top `bits` bits of their hash:
+  /// partition p is tuples[offsets[p], offsets[p+1])
+  template <typename K, typename V>
+  struct Partitions {
+    std::vector<Hashed<K,V>> tuples;
+    std::vector<size_t> offsets;
+  };
+
+  /// most partitions written to at once; more than this and the scatter
+  /// thrashes the TLB, so larger fanouts take several passes
+  const int max_pass_bits = 8;
+
+  template <typename K, typename V>
+  Partitions<K,V> partition(const std::vector<std::pair<K,V>>& in, int bits) {
+    size_t n = in.size();
+    std::vector<Hashed<K,V>> a(n), b(n);
+    for (size_t i=0; i<n; i++) {
+      a[i] = { bittwiddle::mix64(std::hash<K>()(in[i].first)), in[i].first, in[i].second };
+    }
+
+    std::vector<size_t> bounds = { 0, n };
+    std::vector<size_t> next, pos;
+    for (int done = 0; done < bits; ) {
+      int pass_bits = std::min(bits - done, max_pass_bits);
+      size_t fanout = size_t(1) << pass_bits;
+      int shift = 64 - done - pass_bits;
+      next.clear();
+      next.reserve((bounds.size()-1) * fanout + 1);
+
+      // split every partition of the previous pass on the next `pass_bits`
+      for (size_t s=0; s+1 < bounds.size(); s++) {
+        size_t lo = bounds[s], hi = bounds[s+1];
+        pos.assign(fanout, 0);
+        for (size_t i=lo; i<hi; i++) pos[(a[i].hash >> shift) & (fanout-1)]++;
+        size_t off = lo;
+        for (size_t d=0; d<fanout; d++) {
+          next.push_back(off);
+          auto c = pos[d];
+          pos[d] = off;
+          off += c;
+        }
+        for (size_t i=lo; i<hi; i++) b[pos[(a[i].hash >> shift) & (fanout-1)]++] = a[i];
+      }
+      next.push_back(n);
+
+      std::swap(a, b);
+      std::swap(bounds, next);
+      done += pass_bits;
+    }
+    return { std::move(a), std::move(bounds) };
+  }
+
+  /// open-addressing slot; `pos` is 1 + the tuple's index in its partition (0 = empty)
+  struct Slot {
+    uint32_t tag;
+    uint32_t pos;
+  };
+
+  inline uint32_t tag_of(uint64_t hash) { return hash >> 16; }
+
+  /// tuples probed together: all their slots are prefetched before the first compare
+  const size_t probe_batch = 16;
+
+  /// join matching partitions of `build` and `probe`, calling emit(build_val, probe_val)
+  template <typename K, typename VB, typename VP, typename F>
+  int64_t join_partitions(const Partitions<K,VB>& build, const Partitions<K,VP>& probe, F emit) {
+    CHECK_EQ( build.offsets.size(), probe.offsets.size() );
+    int64_t count = 0;
+    std::vector<Slot> slots;
+    size_t idx[probe_batch];
+
+    for (size_t p=0; p+1 < build.offsets.size(); p++) {
+      auto bt = build.tuples.data() + build.offsets[p];
+      size_t nb = build.offsets[p+1] - build.offsets[p];
+      auto pt = probe.tuples.data() + probe.offsets[p];
+      size_t np = probe.offsets[p+1] - probe.offsets[p];
+      if (nb == 0 || np == 0) continue;
+      CHECK( nb < UINT32_MAX ) << "partition too large for 32-bit slots";
+
+      // build: table at most half full
+      size_t capacity = 8;
+      while (capacity < 2*nb) capacity <<= 1;
+      size_t mask = capacity - 1;
+      slots.assign(capacity, Slot{0, 0});
+      for (size_t i=0; i<nb; i++) {
+        size_t s = bt[i].hash & mask;
+        while (slots[s].pos != 0) s = (s+1) & mask;
+        slots[s] = { tag_of(bt[i].hash), static_cast<uint32_t>(i+1) };
+      }
+
+      // probe: every key matching the tuple lies in the run of full slots from its home slot
+      for (size_t j=0; j<np; j += probe_batch) {
+        size_t m = std::min(probe_batch, np - j);
+        for (size_t k=0; k<m; k++) {
+          idx[k] = pt[j+k].hash & mask;
+          __builtin_prefetch(&slots[idx[k]]);
+        }
+        for (size_t k=0; k<m; k++) {
+          auto& t = pt[j+k];
+          auto tag = tag_of(t.hash);
+          for (size_t s = idx[k]; slots[s].pos != 0; s = (s+1) & mask) {
+            if (slots[s].tag == tag) {
+              auto& u = bt[slots[s].pos-1];
+              if (u.hash == t.hash && u.key == t.key) {
+                emit(u.val, t.val);
+                count++;
+              }
+            }
+          }
+        }
+      }
+    }
+    return count;
+  }
+
+  /// radix bits that bring a partition of `n` build tuples (plus table) under `cache_bytes`
+  template <typename K, typename V>
+  int partition_bits(size_t n, size_t cache_bytes) {
+    size_t bytes = n * (sizeof(Hashed<K,V>) + 2*sizeof(Slot));
+    int bits = 0;
+    while (bits < 24 && (bytes >> bits) > cache_bytes) bits++;
+    return bits;
+  }
+
+} // namespace radix_join
+
+/// Equijoin `left` and `right` on their keys, calling emit(left_val, right_val)
+/// for every matching pair; returns the number of pairs. Partitions are sized
+/// for `cache_bytes` (the per-core L2 by default).
+template <typename K, typename VL, typename VR, typename F>
+int64_t radix_hash_join(const std::vector<std::pair<K,VL>>& left,
+                        const std::vector<std::pair<K,VR>>& right,
+                        F emit, size_t cache_bytes = 256*1024) {
+  using namespace radix_join;
+  if (left.empty() || right.empty()) return 0;
+
+  // build on the smaller side
+  if (left.size() <= right.size()) {
+    int bits = partition_bits<K,VL>(left.size(), cache_bytes);
+    auto build = partition(left, bits);
+    auto probe = partition(right, bits);
+    return join_partitions(build, probe, [&](const VL& l, const VR& r) { emit(l, r); });
+  } else {
+    int bits = partition_bits<K,VR>(right.size(), cache_bytes);
+    auto build = partition(right, bits);
+    auto probe = partition(left, bits);
+    return join_partitions(build, probe, [&](const VR& r, const VL& l) { emit(l, r); });
+  }
+}
@@ -0,0 +1,66 @@
+/// Compare radix_hash_join() against a chained hash join (std::unordered_multimap)
+/// on one core, with a build side larger than L2.
+///
+/// Keys are uniform over --radix_bench_keys; the left side has --radix_bench_left
+/// tuples and the right side --radix_bench_right.
+
+#include <Grappa.hpp>
+#include <Metrics.hpp>
+#include <unordered_map>
+#include <random>
+#include "RadixJoin.hpp"
+
+DEFINE_int64( radix_bench_left, 1<<20, "Tuples on the left (build) side" );
+DEFINE_int64( radix_bench_right, 1<<22, "Tuples on the right (probe) side" );
+DEFINE_int64( radix_bench_keys, 1<<22, "Number of distinct keys the tuples are drawn from" );
+
+using namespace Grappa;
+
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, chained_join_time, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, radix_join_time, 0 );
+
+typedef std::vector<std::pair<int64_t,int64_t>> Tuples;
+
+Tuples random_tuples(size_t n, int64_t nkeys, int seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int64_t> k(0, nkeys-1);
+  Tuples ts;
+  for (size_t i=0; i<n; i++) ts.push_back({ k(gen), i });
+  return ts;
+}
+
+int main(int argc, char * argv[]) {
+  init(&argc, &argv);
+  run([]{
+    auto left = random_tuples(FLAGS_radix_bench_left, FLAGS_radix_bench_keys, 3);
+    auto right = random_tuples(FLAGS_radix_bench_right, FLAGS_radix_bench_keys, 4);
+
+    double t = walltime();
+    std::unordered_multimap<int64_t,int64_t> table;
+    for (auto& l : left) table.insert(l);
+    int64_t expected_count = 0, expected_sum = 0;
+    for (auto& r : right) {
+      auto range = table.equal_range(r.first);
+      for (auto it = range.first; it != range.second; ++it) {
+        expected_count++;
+        expected_sum += it->second * 31 + r.second;
+      }
+    }
+    chained_join_time = walltime() - t;
+
+    t = walltime();
+    int64_t sum = 0;
+    auto count = radix_hash_join(left, right, [&](const int64_t& l, const int64_t& r) {
+      sum += l * 31 + r;
+    });
+    radix_join_time = walltime() - t;
+
+    CHECK_EQ( count, expected_count );
+    CHECK_EQ( sum, expected_sum );
+    LOG(INFO) << count << " matches; chained: " << chained_join_time.value() << " s, "
+              << "radix: " << radix_join_time.value() << " s";
+
+    Metrics::merge_and_print();
+  });
+  finalize();
+}
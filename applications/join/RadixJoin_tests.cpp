@@ -0,0 +1,84 @@
+#include <boost/test/unit_test.hpp>
+#include <unordered_map>
+#include <random>
+#include "RadixJoin.hpp"
+
+
+BOOST_AUTO_TEST_SUITE( RadixJoin_tests );
+
+typedef std::vector<std::pair<int64_t,int64_t>> Tuples;
+
+Tuples random_tuples(size_t n, int64_t nkeys, int64_t stride, int seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<int64_t> k(0, nkeys-1);
+  Tuples ts;
+  for (size_t i=0; i<n; i++) ts.push_back({ k(gen)*stride, i });
+  return ts;
+}
+
+// number of matches and a checksum of the matching value pairs, by chained hash table
+std::pair<int64_t,int64_t> reference_join(const Tuples& left, const Tuples& right) {
+  std::unordered_multimap<int64_t,int64_t> table;
+  for (auto& t : left) table.insert(t);
+  int64_t count = 0, sum = 0;
+  for (auto& t : right) {
+    auto r = table.equal_range(t.first);
+    for (auto it = r.first; it != r.second; ++it) {
+      count++;
+      sum += it->second * 31 + t.second;
+    }
+  }
+  return { count, sum };
+}
+
+void check_join(const Tuples& left, const Tuples& right, size_t cache_bytes) {
+  int64_t sum = 0;
+  auto count = radix_hash_join(left, right, [&](const int64_t& l, const int64_t& r) {
+    sum += l * 31 + r;
+  }, cache_bytes);
+  auto expected = reference_join(left, right);
+  BOOST_CHECK_EQUAL( count, expected.first );
+  BOOST_CHECK_EQUAL( sum, expected.second );
+}
+
+BOOST_AUTO_TEST_CASE( testPartition ) {
+  BOOST_MESSAGE("Testing radix partitioning");
+
+  auto ts = random_tuples(10000, 500, 1, 0);
+  for (int bits : { 0, 3, 8, 13 }) {
+    auto p = radix_join::partition(ts, bits);
+    BOOST_CHECK_EQUAL( p.offsets.size(), (size_t(1) << bits) + 1 );
+    BOOST_CHECK_EQUAL( p.tuples.size(), ts.size() );
+    for (size_t i=0; i+1 < p.offsets.size(); i++) {
+      for (auto j = p.offsets[i]; j < p.offsets[i+1]; j++) {
+        auto& t = p.tuples[j];
+        BOOST_CHECK_EQUAL( t.hash, bittwiddle::mix64(std::hash<int64_t>()(t.key)) );
+        if (bits > 0) BOOST_CHECK_EQUAL( t.hash >> (64-bits), i );
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( testJoin ) {
+  BOOST_MESSAGE("Testing against a chained hash join");
+
+  // few keys (long chains of duplicates) to mostly unique keys
+  for (int64_t nkeys : { 1, 7, 1000, 100000 }) {
+    auto left = random_tuples(3000, nkeys, 1, nkeys);
+    auto right = random_tuples(5000, nkeys, 1, nkeys+1);
+    // one partition, and a few KB per partition (two partitioning passes)
+    check_join(left, right, 1 << 30);
+    check_join(left, right, 1 << 10);
+    // build side is the right one
+    check_join(right, left, 1 << 10);
+  }
+
+  // keys that all went to one of 16 reducers
+  check_join(random_tuples(4000, 1000, 16, 1), random_tuples(4000, 1000, 16, 2), 1 << 12);
+
+  Tuples empty;
+  check_join(empty, random_tuples(10, 5, 1, 0), 1 << 12);
+  check_join(random_tuples(10, 5, 1, 0), empty, 1 << 12);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
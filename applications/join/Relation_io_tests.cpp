@@ -157,6 +157,30 @@ BOOST_AUTO_TEST_CASE( test1 ) {
       BOOST_CHECK_EQUAL( four.get(1), (*results.data.localize()).get(1) );
     }
       
+    // columnar format, with a dictionary-encoded column and several chunks per core
+    std::string col_file = "write.col";
+    std::vector<std::string> names = { "a", "b", "c" };
+    {
+      columnar::Writer w( col_file, columnar::parse_types("is"), 3 );
+      for (int i=0; i<10; i++) w.append({ std::to_string(100+i), names[i%3] });
+    }
+    columnar::Reader meta( col_file );
+    BOOST_CHECK_EQUAL( meta.nrows(), 10 );
+    BOOST_CHECK_EQUAL( meta.nchunks(), 4 );
+    BOOST_CHECK( meta.dictionary(1) == names );
+
+    results = readTuplesUnordered<MaterializedTupleRef_V1_0_1>( col_file );
+    BOOST_CHECK_EQUAL( 10, results.numtuples );
+    std::vector<bool> seen(10, false);
+    for (int i=0; i<10; i++) {
+      auto t = delegate::read( results.data+i );
+      auto k = t.get(0) - 100;
+      BOOST_CHECK( k >= 0 && k < 10 && !seen[k] );
+      seen[k] = true;
+      BOOST_CHECK_EQUAL( t.get(1), k%3 );
+    }
+    std::remove(col_file.c_str());
+
 
   });
   Grappa::finalize();
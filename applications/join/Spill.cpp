@@ -0,0 +1,49 @@
+#include "Spill.hpp"
+
+DEFINE_int64(spill_budget, 0, "Bytes of MapReduce/HashJoin intermediate data to hold in memory per core before spilling to --spill_dir (0 = unlimited)");
+DEFINE_string(spill_dir, "/tmp", "Directory for spill files (local scratch)");
+DEFINE_int64(spill_read_buffer, 1<<18, "Bytes read at a time from each spilled run when merging");
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, spilled_bytes, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, spill_runs, 0);
+
+namespace spill {
+
+  // this core's containers and the bytes they hold
+  static std::vector<Spillable*> tracked;
+  static size_t in_memory = 0;
+  static bool spilling = false;
+
+  void track(Spillable * s) {
+    tracked.push_back(s);
+  }
+
+  void untrack(Spillable * s) {
+    auto it = std::find(tracked.begin(), tracked.end(), s);
+    if (it != tracked.end()) tracked.erase(it);
+  }
+
+  // spill the largest containers until back under half the budget
+  static void reclaim() {
+    spilling = true;
+    while (in_memory > size_t(FLAGS_spill_budget) / 2) {
+      Spillable * largest = nullptr;
+      size_t most = 0;
+      for (auto s : tracked) {
+        auto b = s->memory_bytes();
+        if (b > most) { most = b; largest = s; }
+      }
+      if (!largest) break;
+      VLOG(2) << "spilling " << most << " bytes (" << in_memory << " in memory)";
+      largest->spill();
+    }
+    spilling = false;
+  }
+
+  void update(Spillable * s, size_t& charged, size_t now) {
+    in_memory = in_memory - charged + now;
+    charged = now;
+    if (enabled() && !spilling && in_memory > size_t(FLAGS_spill_budget)) reclaim();
+  }
+
+} // namespace spill
@@ -0,0 +1,287 @@
+#pragma once
+
+#include <Grappa.hpp>
+#include <FileIO.hpp>
+#include <Metrics.hpp>
+
+#include <vector>
+#include <queue>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+
+DECLARE_int64(spill_budget);
+DECLARE_string(spill_dir);
+DECLARE_int64(spill_read_buffer);
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, spilled_bytes);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, spill_runs);
+
+/// Memory-bounded intermediate state for MapReduce and HashJoinContext.
+///
+/// Each core tracks the bytes held by its Spillable containers (reducer
+/// groups, join inputs) against --spill_budget. When a container grows past
+/// the budget, the largest containers on the core write their contents to a
+/// scratch file in --spill_dir as a run of (key, value) records sorted by key,
+/// until the core is back under half the budget. The reduce (or join) phase
+/// then merges a container's runs with what is left in memory, reading each
+/// run sequentially through FileIO, so only one group at a time needs to fit.
+///
+/// With the default budget of 0 nothing is tracked or spilled. Only containers
+/// whose keys and values are trivially copyable (and keys ordered by <) spill.
+namespace spill {
+
+  class Spillable {
+  public:
+    virtual ~Spillable() {}
+    /// bytes of intermediate data currently held in memory
+    virtual size_t memory_bytes() const = 0;
+    /// write the in-memory contents out as a sorted run and free them
+    virtual void spill() = 0;
+  };
+
+  /// per-core accounting (defined in Spill.cpp)
+  void track(Spillable * s);
+  void untrack(Spillable * s);
+  /// note that `s` now holds `now` bytes, having held `charged` before; may spill
+  void update(Spillable * s, size_t& charged, size_t now);
+
+  inline bool enabled() { return FLAGS_spill_budget > 0; }
+
+  /// a spilled record; stored as raw bytes, so only for trivially copyable K and V
+  template <typename K, typename V>
+  using Entry = std::pair<K,V>;
+
+  template <typename K, typename V>
+  struct can_spill : std::integral_constant<bool,
+    std::is_trivially_copyable<K>::value && std::is_trivially_copyable<V>::value> {};
+
+  template <typename K, typename V>
+  bool key_less(const Entry<K,V>& a, const Entry<K,V>& b) { return a.first < b.first; }
+
+  /// Sorted runs of Entry<K,V> in one scratch file, created on the first run
+  /// and removed with the Runs.
+  template <typename K, typename V>
+  class Runs {
+    int fd;
+    std::string path;
+    int64_t end;
+    std::vector<std::pair<int64_t,int64_t>> runs_;   // (offset, count)
+
+  public:
+    Runs() : fd(-1), end(0) {}
+    Runs(const Runs&) = delete;
+    ~Runs() { clear(); }
+
+    bool empty() const { return runs_.empty(); }
+    const std::vector<std::pair<int64_t,int64_t>>& runs() const { return runs_; }
+    int file() const { return fd; }
+
+    /// sort `es` by key and append it as a run; called from message handlers,
+    /// so writes with plain (non-suspending) pwrite
+    void write(std::vector<Entry<K,V>>& es) {
+      if (es.empty()) return;
+      std::stable_sort(es.begin(), es.end(), key_less<K,V>);
+      if (fd < 0) {
+        path = FLAGS_spill_dir + "/grappa-spill-" + std::to_string(Grappa::mycore()) + "-XXXXXX";
+        fd = mkstemp(&path[0]);
+        CHECK( fd >= 0 ) << "unable to create spill file " << path;
+      }
+      size_t bytes = es.size() * sizeof(Entry<K,V>);
+      const char * p = reinterpret_cast<const char*>(es.data());
+      for (size_t done = 0; done < bytes; ) {
+        auto w = pwrite(fd, p + done, bytes - done, end + done);
+        CHECK( w > 0 ) << "write to spill file " << path << " failed";
+        done += w;
+      }
+      runs_.emplace_back(end, es.size());
+      end += bytes;
+      spilled_bytes += bytes;
+      spill_runs++;
+    }
+
+    void clear() {
+      if (fd >= 0) {
+        close(fd);
+        unlink(path.c_str());
+        fd = -1;
+      }
+      runs_.clear();
+      end = 0;
+    }
+  };
+
+  /// Streams Entry<K,V>s in key order from a Runs' files plus an in-memory run,
+  /// a group of equal keys at a time. Reads suspend the calling task, so use it
+  /// from a task (e.g. in a forall), not from a message handler.
+  template <typename K, typename V>
+  class Merge {
+    typedef Entry<K,V> E;
+
+    struct Source {
+      int64_t offset, left;    // next unread record in the file, and records remaining
+      std::vector<E> buf;
+      size_t pos;
+    };
+    int fd;
+    std::vector<Source> sources;
+    const std::vector<E>& mem;
+    size_t mem_pos;
+
+    // heap of (key, source); the in-memory run is source -1
+    struct Head {
+      K key;
+      int64_t src;
+    };
+    struct HeadGreater {
+      bool operator()(const Head& a, const Head& b) const {
+        return b.key < a.key || (!(a.key < b.key) && b.src < a.src);
+      }
+    };
+    std::priority_queue<Head, std::vector<Head>, HeadGreater> heads;
+
+    bool fill(Source& s) {
+      if (s.pos < s.buf.size()) return true;
+      if (s.left == 0) return false;
+      int64_t n = std::min<int64_t>(s.left, std::max<int64_t>(1, FLAGS_spill_read_buffer / sizeof(E)));
+      s.buf.resize(n);
+      Grappa::impl::fread_blocking(s.buf.data(), n * sizeof(E), s.offset, fd);
+      s.offset += n * sizeof(E);
+      s.left -= n;
+      s.pos = 0;
+      return true;
+    }
+
+    const E& head(int64_t src) const {
+      return (src < 0) ? mem[mem_pos] : sources[src].buf[sources[src].pos];
+    }
+
+    void advance(int64_t src) {
+      if (src < 0) {
+        if (++mem_pos < mem.size()) heads.push(Head{ mem[mem_pos].first, -1 });
+      } else {
+        auto& s = sources[src];
+        s.pos++;
+        if (fill(s)) heads.push(Head{ s.buf[s.pos].first, src });
+      }
+    }
+
+  public:
+    /// `mem` must already be sorted by key (and outlive the Merge)
+    Merge(const Runs<K,V>& runs, const std::vector<E>& mem)
+      : fd(runs.file()), mem(mem), mem_pos(0)
+    {
+      for (auto& r : runs.runs()) sources.push_back(Source{ r.first, r.second, {}, 0 });
+      for (size_t i=0; i<sources.size(); i++) {
+        if (fill(sources[i])) heads.push(Head{ sources[i].buf[0].first, (int64_t)i });
+      }
+      if (!mem.empty()) heads.push(Head{ mem[0].first, -1 });
+    }
+
+    bool done() const { return heads.empty(); }
+    const K& key() const { return heads.top().key; }
+
+    /// move the values of the smallest remaining key into `vals`; returns the key
+    K next(std::vector<V>& vals) {
+      vals.clear();
+      K k = heads.top().key;
+      while (!heads.empty() && !(k < heads.top().key)) {
+        auto src = heads.top().src;
+        heads.pop();
+        vals.push_back(head(src).second);
+        advance(src);
+      }
+      return k;
+    }
+  };
+
+  /// List of (key, value) pairs that spills sorted runs when its core is over
+  /// budget; used for the inputs of a JoinReducer.
+  template <typename K, typename V>
+  class Buffer : public Spillable {
+    std::vector<Entry<K,V>> mem;
+    Runs<K,V> runs_;
+    size_t charged;
+
+    void spill(std::true_type) {
+      runs_.write(mem);
+      std::vector<Entry<K,V>>().swap(mem);
+      update(this, charged, 0);
+    }
+    void spill(std::false_type) { LOG(FATAL) << "spilling entries that aren't trivially copyable"; }
+
+  public:
+    Buffer() : charged(0) { if (can_spill<K,V>::value) track(this); }
+    Buffer(const Buffer&) = delete;
+    ~Buffer() {
+      if (can_spill<K,V>::value) untrack(this);
+      spill::update(this, charged, 0);
+    }
+
+    void emplace_back(const K& key, const V& val) {
+      mem.emplace_back(key, val);
+      if (enabled()) update(this, charged, memory_bytes());
+    }
+
+    size_t memory_bytes() const { return mem.capacity() * sizeof(Entry<K,V>); }
+    void spill() { spill(can_spill<K,V>()); }
+
+    bool spilled() const { return !runs_.empty(); }
+    const Runs<K,V>& runs() const { return runs_; }
+
+    /// the entries still in memory (all of them, unless spilled())
+    std::vector<Entry<K,V>>& entries() { return mem; }
+
+    void clear() {
+      std::vector<Entry<K,V>>().swap(mem);
+      runs_.clear();
+      update(this, charged, 0);
+    }
+  };
+
+  namespace impl {
+    template <typename K, typename VL, typename VR, typename F>
+    int64_t merge_join(Buffer<K,VL>& left, Buffer<K,VR>& right, F emit, std::true_type) {
+      auto& lmem = left.entries();
+      auto& rmem = right.entries();
+      std::stable_sort(lmem.begin(), lmem.end(), key_less<K,VL>);
+      std::stable_sort(rmem.begin(), rmem.end(), key_less<K,VR>);
+      Merge<K,VL> l(left.runs(), lmem);
+      Merge<K,VR> r(right.runs(), rmem);
+
+      std::vector<VL> ls;
+      std::vector<VR> rs;
+      int64_t count = 0;
+      while (!l.done() && !r.done()) {
+        if (l.key() < r.key()) {
+          l.next(ls);
+        } else if (r.key() < l.key()) {
+          r.next(rs);
+        } else {
+          l.next(ls);
+          r.next(rs);
+          for (auto& lv : ls) for (auto& rv : rs) emit(lv, rv);
+          count += ls.size() * rs.size();
+        }
+      }
+      return count;
+    }
+    template <typename K, typename VL, typename VR, typename F>
+    int64_t merge_join(Buffer<K,VL>& left, Buffer<K,VR>& right, F emit, std::false_type) {
+      LOG(FATAL) << "join inputs that can't spill have spilled";
+      return 0;
+    }
+  }
+
+  /// Sort-merge equijoin of two Buffers, at least one of which has spilled,
+  /// calling emit(left_val, right_val) per matching pair; of the spilled
+  /// tuples, only one key's values per side are read into memory at a time.
+  /// Returns the number of pairs.
+  template <typename K, typename VL, typename VR, typename F>
+  int64_t merge_join(Buffer<K,VL>& left, Buffer<K,VR>& right, F emit) {
+    return impl::merge_join(left, right, emit, std::integral_constant<bool,
+      can_spill<K,VL>::value && can_spill<K,VR>::value>());
+  }
+
+} // namespace spill
@@ -0,0 +1,204 @@
+#include "columnar.hpp"
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glog/logging.h>
+
+namespace columnar {
+
+std::vector<ColumnType> parse_types(const std::string& types) {
+  std::vector<ColumnType> ts;
+  for (auto c : types) {
+    switch (c) {
+      case 'i': ts.push_back(INT); break;
+      case 'd': ts.push_back(DOUBLE); break;
+      case 's': ts.push_back(STRING); break;
+      default: LOG(FATAL) << "unrecognized column type '" << c << "' in " << types;
+    }
+  }
+  return ts;
+}
+
+bool is_columnar(const std::string& path) {
+  char magic[sizeof(MAGIC)];
+  FILE * f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+  bool match = fread(magic, 1, sizeof(magic), f) == sizeof(magic)
+               && memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+  fclose(f);
+  return match;
+}
+
+/*
+ * Writer
+ */
+
+static void write_words(FILE * f, const int64_t * words, size_t n) {
+  CHECK_EQ( fwrite(words, sizeof(int64_t), n, f), n ) << "write failed";
+}
+
+Writer::Writer(const std::string& path, const std::vector<ColumnType>& types, int64_t chunk_rows)
+  : f(fopen(path.c_str(), "wb"))
+  , path(path)
+  , types(types)
+  , chunk_rows(chunk_rows)
+  , nrows(0)
+  , chunk(types.size())
+  , codes(types.size())
+  , dicts(types.size())
+{
+  CHECK( f != NULL ) << path << " failed to open";
+  CHECK( !types.empty() ) << "no columns";
+  CHECK( chunk_rows > 0 );
+  for (auto& c : chunk) c.reserve(chunk_rows);
+
+  // header is rewritten by close() once the counts are known
+  Header h = {};
+  write_words(f, reinterpret_cast<int64_t*>(&h), sizeof(h)/sizeof(int64_t));
+  for (auto t : types) write_words(f, reinterpret_cast<const int64_t*>(&t), 1);
+}
+
+Writer::~Writer() {
+  if (f) close();
+}
+
+void Writer::flush_chunk() {
+  if (chunk[0].empty()) return;
+  for (size_t c=0; c<chunk.size(); c++) {
+    index.push_back(ftell(f));
+    write_words(f, chunk[c].data(), chunk[c].size());
+    chunk[c].clear();
+  }
+}
+
+void Writer::append(const int64_t * row) {
+  for (size_t c=0; c<chunk.size(); c++) chunk[c].push_back(row[c]);
+  if (++nrows % chunk_rows == 0) flush_chunk();
+}
+
+void Writer::append(const std::vector<std::string>& fields) {
+  CHECK_EQ( fields.size(), types.size() ) << "row " << nrows << " has the wrong number of columns";
+  std::vector<int64_t> row(types.size());
+  for (size_t c=0; c<types.size(); c++) {
+    switch (types[c]) {
+      case INT: row[c] = std::stoll(fields[c]); break;
+      case DOUBLE: {
+        double d = std::stod(fields[c]);
+        memcpy(&row[c], &d, sizeof(d));
+        break;
+      }
+      case STRING: {
+        auto it = codes[c].find(fields[c]);
+        if (it == codes[c].end()) {
+          it = codes[c].emplace(fields[c], dicts[c].size()).first;
+          dicts[c].push_back(fields[c]);
+        }
+        row[c] = it->second;
+        break;
+      }
+    }
+  }
+  append(row.data());
+}
+
+int64_t Writer::close() {
+  flush_chunk();
+
+  Header h;
+  memcpy(h.magic, MAGIC, sizeof(MAGIC));
+  h.ncols = types.size();
+  h.nrows = nrows;
+  h.chunk_rows = chunk_rows;
+  h.nchunks = index.size() / types.size();
+  h.index_offset = ftell(f);
+  write_words(f, index.data(), index.size());
+
+  for (size_t c=0; c<types.size(); c++) {
+    if (types[c] != STRING) continue;
+    int64_t n = dicts[c].size();
+    write_words(f, &n, 1);
+    for (auto& s : dicts[c]) {
+      int64_t len = s.size();
+      write_words(f, &len, 1);
+      CHECK_EQ( fwrite(s.data(), 1, len, f), len );
+    }
+  }
+
+  fseek(f, 0, SEEK_SET);
+  write_words(f, reinterpret_cast<int64_t*>(&h), sizeof(h)/sizeof(int64_t));
+  fclose(f);
+  f = NULL;
+  return nrows;
+}
+
+/*
+ * Reader
+ */
+
+static void read_at(int fd, void * buf, size_t n, int64_t offset) {
+  char * p = static_cast<char*>(buf);
+  while (n > 0) {
+    auto r = pread(fd, p, n, offset);
+    CHECK( r > 0 ) << "read failed at offset " << offset;
+    p += r; n -= r; offset += r;
+  }
+}
+
+Reader::Reader(const std::string& path)
+  : fd(open(path.c_str(), O_RDONLY))
+{
+  CHECK( fd >= 0 ) << path << " failed to open";
+  read_at(fd, &h, sizeof(h), 0);
+  CHECK( memcmp(h.magic, MAGIC, sizeof(MAGIC)) == 0 ) << path << " is not a columnar relation";
+  types_.resize(h.ncols);
+  read_at(fd, types_.data(), h.ncols * sizeof(int64_t), sizeof(h));
+  index_.resize(h.nchunks * h.ncols);
+  read_at(fd, index_.data(), index_.size() * sizeof(int64_t), h.index_offset);
+}
+
+Reader::~Reader() {
+  ::close(fd);
+}
+
+void Reader::read_rows(int64_t start, int64_t n, int64_t * out) const {
+  CHECK( start >= 0 && start + n <= h.nrows );
+  std::vector<int64_t> buf;
+  for (int64_t r = start; r < start+n; ) {
+    int64_t chunk = r / h.chunk_rows;
+    int64_t in_chunk = r - chunk * h.chunk_rows;
+    int64_t m = std::min(h.chunk_rows - in_chunk, start + n - r);
+    buf.resize(m);
+    for (int64_t c=0; c<h.ncols; c++) {
+      read_at(fd, buf.data(), m * sizeof(int64_t), column_offset(chunk, c) + in_chunk * sizeof(int64_t));
+      for (int64_t i=0; i<m; i++) out[(r - start + i) * h.ncols + c] = buf[i];
+    }
+    r += m;
+  }
+}
+
+std::vector<std::string> Reader::dictionary(int64_t col) const {
+  CHECK_EQ( types_[col], STRING ) << "column " << col << " is not dictionary-encoded";
+  int64_t offset = h.index_offset + index_.size() * sizeof(int64_t);
+  std::vector<std::string> dict;
+  for (int64_t c=0; c<=col; c++) {
+    if (types_[c] != STRING) continue;
+    int64_t n;
+    read_at(fd, &n, sizeof(n), offset);
+    offset += sizeof(n);
+    for (int64_t i=0; i<n; i++) {
+      int64_t len;
+      read_at(fd, &len, sizeof(len), offset);
+      offset += sizeof(len);
+      if (c == col) {
+        std::string s(len, '\0');
+        if (len > 0) read_at(fd, &s[0], len, offset);
+        dict.push_back(std::move(s));
+      }
+      offset += len;
+    }
+  }
+  return dict;
+}
+
+} // namespace columnar
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <cstdio>
+
+/// Columnar relation files
+///
+/// Layout (all integers little-endian 64-bit):
+///
+///   header:  magic "GRPCOL01", ncols, nrows, chunk_rows, nchunks, index_offset
+///   types:   one ColumnType per column (padded to 8 bytes each)
+///   chunks:  for each chunk, each column's values as a packed array of 8-byte words
+///   index:   for each chunk, the file offset of each column's array
+///   dicts:   for each dictionary-encoded column, nstrings then (length, bytes)*
+///
+/// Every value is stored as one 8-byte word, so loading a chunk is a straight
+/// read of each column into place with no parsing: int64 columns are the
+/// value, double columns its bit pattern, and string columns an int64 code into
+/// the column's dictionary (codes are assigned in order of first appearance).
+
+namespace columnar {
+
+  enum ColumnType : int64_t { INT = 0, DOUBLE = 1, STRING = 2 };
+
+  const char MAGIC[8] = { 'G','R','P','C','O','L','0','1' };
+
+  /// default rows per chunk
+  const int64_t CHUNK_ROWS = 1 << 16;
+
+  struct Header {
+    char magic[8];
+    int64_t ncols;
+    int64_t nrows;
+    int64_t chunk_rows;
+    int64_t nchunks;
+    int64_t index_offset;
+  };
+
+  /// parse a type string with one of 'i', 'd', 's' per column
+  std::vector<ColumnType> parse_types(const std::string& types);
+
+  /// true if `path` starts with the columnar magic
+  bool is_columnar(const std::string& path);
+
+  /// Writes a columnar file a chunk at a time (buffering one chunk in memory).
+  class Writer {
+    FILE * f;
+    std::string path;
+    std::vector<ColumnType> types;
+    int64_t chunk_rows;
+    int64_t nrows;
+    std::vector<std::vector<int64_t>> chunk;                      // per column
+    std::vector<int64_t> index;                                   // nchunks x ncols
+    std::vector<std::unordered_map<std::string,int64_t>> codes;   // per column
+    std::vector<std::vector<std::string>> dicts;                  // per column
+
+    void flush_chunk();
+  public:
+    Writer(const std::string& path, const std::vector<ColumnType>& types, int64_t chunk_rows = CHUNK_ROWS);
+    ~Writer();
+
+    /// append a row of already-encoded 8-byte words
+    void append(const int64_t * row);
+
+    /// append a row of text fields, parsed (or dictionary-encoded) per column type
+    void append(const std::vector<std::string>& fields);
+
+    /// write the last chunk, index and dictionaries; returns number of rows
+    int64_t close();
+  };
+
+  /// Random access to a columnar file's metadata and rows with plain reads;
+  /// the Grappa loader (readTuplesUnordered) uses the same index.
+  class Reader {
+    int fd;
+    Header h;
+    std::vector<ColumnType> types_;
+    std::vector<int64_t> index_;
+  public:
+    Reader(const std::string& path);
+    ~Reader();
+
+    int64_t ncols() const { return h.ncols; }
+    int64_t nrows() const { return h.nrows; }
+    int64_t chunk_rows() const { return h.chunk_rows; }
+    int64_t nchunks() const { return h.nchunks; }
+    const std::vector<ColumnType>& types() const { return types_; }
+
+    /// file offset of column `col` of chunk `chunk`
+    int64_t column_offset(int64_t chunk, int64_t col) const { return index_[chunk*h.ncols + col]; }
+
+    /// read rows [start, start+n) into `out` as rows of ncols() words
+    void read_rows(int64_t start, int64_t n, int64_t * out) const;
+
+    /// the strings of dictionary-encoded column `col`, indexed by code
+    std::vector<std::string> dictionary(int64_t col) const;
+  };
+
+} // namespace columnar
@@ -0,0 +1,63 @@
+#include "columnar.hpp"
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <boost/tokenizer.hpp>
+#include <glog/logging.h>
+
+// Convert a relation in text (one row per line) or convert2bin's binary format
+// (rows of 8-byte words) to the columnar format, written to FILE.col.
+int main(int argc, char** argv) {
+
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0] << " FILE FORMAT{text,bin} TYPES{i,d,s per column} [SEPS] [BURNS]" << std::endl;
+    exit(1);
+  }
+
+  std::string fn(argv[1]);
+  auto types = columnar::parse_types(argv[3]);
+  const char * separators = (argc > 4) ? argv[4] : " ";
+  uint64_t burn = (argc > 5) ? atoi(argv[5]) : 0;
+
+  std::string outpath = fn+".col";
+  columnar::Writer out(outpath, types);
+
+  if (strncmp(argv[2], "text", 4) == 0) {
+    std::ifstream infile(fn, std::ifstream::in);
+    CHECK( infile.is_open() ) << fn << " failed to open";
+
+    std::string line;
+    std::vector<std::string> fields;
+    boost::char_separator<char> sep(separators);
+    while( std::getline( infile, line ) ) {
+      fields.clear();
+      uint64_t j = 0;
+      boost::tokenizer<boost::char_separator<char>> tk (line, sep);
+      for (auto i = tk.begin(); i != tk.end(); ++i) {
+        if (j++ >= burn) fields.push_back(*i);
+      }
+      if (fields.empty()) continue;
+      out.append(fields);
+    }
+  } else if (strncmp(argv[2], "bin", 3) == 0) {
+    for (auto t : types) CHECK( t != columnar::STRING ) << "binary input has no strings to encode";
+    std::ifstream infile(fn, std::ios_base::in | std::ios_base::binary);
+    CHECK( infile.is_open() ) << fn << " failed to open";
+
+    std::vector<int64_t> row(types.size());
+    while( infile.read((char*) row.data(), sizeof(int64_t)*row.size()) ) {
+      out.append(row.data());
+    }
+    CHECK( infile.gcount() == 0 ) << fn << " has a partial row at the end";
+  } else {
+    std::cerr << "unrecognized format " << argv[2] << std::endl;
+    exit(1);
+  }
+
+  auto rows = out.close();
+  columnar::Reader check(outpath);
+  std::cout << "columnar: " << outpath << std::endl;
+  std::cout << "rows: " << rows << std::endl;
+  std::cout << "cols: " << types.size() << std::endl;
+  std::cout << "chunks: " << check.nchunks() << std::endl;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "Query.hpp"
+#include "LeapfrogJoin.hpp"
+#include "grappa/graph.hpp"
+
+/// Cyclic query over one edge relation, evaluated by shuffling edges onto a
+/// hypercube of cores (one dimension per variable, as in SquarePartition4way)
+/// and running a leapfrog triejoin on each core's share.
+class LeapfrogPartition: public Query {
+  private:
+    GlobalAddress<Graph<Vertex>> index;
+    CyclicQuery (*make_query)(); // (plain function so it can be sent to all cores)
+  public:
+    LeapfrogPartition(CyclicQuery (*make_query)()) : make_query(make_query) {}
+
+    virtual void preprocessing(std::vector<tuple_graph> relations);
+
+    virtual void execute(std::vector<tuple_graph> relations);
+};
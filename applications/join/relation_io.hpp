@@ -13,8 +13,10 @@ namespace fs = boost::filesystem;
 #include <Grappa.hpp>
 #include <Cache.hpp>
 #include <ParallelLoop.hpp>
+#include <FileIO.hpp>
 #include "Tuple.hpp"
 #include "relation.hpp"
+#include "columnar.hpp"
 
 #include "grappa/graph.hpp"
 
@@ -125,9 +127,72 @@ tuple_graph readEdges( std::string fn, int64_t numTuples ) {
 }
 
 
+/// Load a columnar relation (see columnar.hpp). Each core claims a range of rows
+/// the size of its local piece of the array and reads just those rows of each
+/// column, found through the file's chunk index, straight into its tuples.
+template <typename T>
+size_t readColumnarUnordered( std::string data_path, GlobalAddress<T> * buf_addr, int64_t numfields ) {
+  double t = Grappa::walltime();
+  columnar::Reader meta(data_path);
+  CHECK_EQ( meta.ncols(), numfields ) << data_path << " has " << meta.ncols() << " columns";
+  CHECK( sizeof(int64_t) * numfields <= sizeof(T) );
+  size_t ntuples = meta.nrows();
+  VLOG(1) << data_path << " has " << ntuples << " rows in " << meta.nchunks() << " chunks";
+
+  auto tuples = Grappa::global_alloc<T>(ntuples);
+
+  int64_t offset_counter = 0;
+  auto offset_counter_addr = make_global( &offset_counter, Grappa::mycore() );
+
+  // we will broadcast the file name as bytes
+  CHECK( data_path.size() <= 2040 );
+  char data_path_char[2048];
+  sprintf(data_path_char, "%s", data_path.c_str());
+
+  on_all_cores( [=] {
+    columnar::Reader meta(data_path_char);
+    auto ncols = meta.ncols();
+    auto chunk_rows = meta.chunk_rows();
+
+    auto local_start = tuples.localize();
+    auto local_end = (tuples+ntuples).localize();
+    int64_t local_count = local_end - local_start;
+    int64_t offset = Grappa::delegate::fetch_and_add( offset_counter_addr, local_count );
+    VLOG(2) << "rows " << offset << ".." << offset+local_count;
+
+    auto fdesc = Grappa::impl::file_open(data_path_char, "r");
+    std::vector<int64_t> buf(std::min(chunk_rows, local_count));
+    for (int64_t r = offset; r < offset+local_count; ) {
+      int64_t chunk = r / chunk_rows;
+      int64_t in_chunk = r - chunk * chunk_rows;
+      int64_t n = std::min(chunk_rows - in_chunk, offset + local_count - r);
+      for (int64_t c=0; c<ncols; c++) {
+        Grappa::impl::fread_blocking(buf.data(), n * sizeof(int64_t),
+                                     meta.column_offset(chunk, c) + in_chunk * sizeof(int64_t), fdesc);
+        for (int64_t i=0; i<n; i++) {
+          reinterpret_cast<int64_t*>(&local_start[r - offset + i])[c] = buf[i];
+        }
+      }
+      r += n;
+    }
+    Grappa::impl::file_close(fdesc);
+  });
+
+  t = Grappa::walltime() - t;
+  double gb = (double)ntuples * numfields * sizeof(int64_t) / (1L<<30);
+  LOG(INFO) << data_path << ": loaded " << ntuples << " rows in " << t << " s (" << gb/t << " GB/s)";
+
+  *buf_addr = tuples;
+  return ntuples;
+}
+
 // assumes that for object T, the address of T is the address of its fields
 template <typename T>
 size_t readTuplesUnordered( std::string fn, GlobalAddress<T> * buf_addr, int64_t numfields ) {
+  if (columnar::is_columnar(FLAGS_relations+"/"+fn)) {
+    return readColumnarUnordered<T>( FLAGS_relations+"/"+fn, buf_addr, numfields );
+  }
+
   /*
   std::string metadata_path = FLAGS_relations+"/"+fn+"."+metadata; //TODO replace such metadatafiles with a real catalog
   std::ifstream metadata_file(metadata_path, std::ifstream::in);
@@ -25,6 +25,16 @@ int64_t fourth_root(int64_t x) {
   }
 }
 
+int64_t int_root(int64_t x, int64_t n) {
+  auto pow = [n](int64_t r) {
+    int64_t p = 1;
+    for (int64_t i=0; i<n; i++) p *= r;
+    return p;
+  };
+  int64_t r = 1;
+  while (pow(r+1) <= x) r++;
+  return r;
+}
 
 std::function<int64_t (int64_t)> makeHash( int64_t dim ) {
   // identity
@@ -20,4 +20,7 @@ namespace std {
 
 int64_t fourth_root(int64_t x);
 
+// largest r such that r^n <= x
+int64_t int_root(int64_t x, int64_t n);
+
 std::function<int64_t (int64_t)> makeHash( int64_t dim );
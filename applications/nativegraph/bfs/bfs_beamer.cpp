@@ -78,7 +78,6 @@ GlobalCompletionEvent phaser;
 Reducer<int64_t,ReducerType::Add> edge_count;
 
 void bfs(GlobalAddress<G> _g, int nbfs, TupleGraph tg) {
-  bool verified = false;
   double t;
       
   auto _frontier = GlobalBag<VertexID>::create(_g->nv);
@@ -205,14 +204,16 @@ void bfs(GlobalAddress<G> _g, int nbfs, TupleGraph tg) {
     double this_bfs_time = walltime() - t;
     LOG(INFO) << "(root=" << root << ", time=" << this_bfs_time << ")";
     
-    if (!verified) {
-      // only verify the first one to save time
+    if (root_idx < FLAGS_nverify) {
+      // only verify the first few to save time
       t = walltime();
-      bfs_nedge = verify(tg, g, root);
-      verify_time = (walltime()-t);
-      LOG(INFO) << verify_time;
-      verified = true;
-      Metrics::reset_all_cores(); // don't count the first one
+      auto nedge = verify_batch(tg, g, root, root_idx, nbfs);
+      if (!nedge.empty()) {
+        bfs_nedge = nedge[0];
+        verify_time = (walltime()-t);
+        LOG(INFO) << verify_time;
+        Metrics::reset_all_cores(); // don't count the verified ones
+      }
     } else {
       total_time += this_bfs_time;
     }
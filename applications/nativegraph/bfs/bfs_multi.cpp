@@ -0,0 +1,313 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+////////////////////////////////////////////////////////////////////////
+/// Multi-source BFS: runs the --nbfs traversals in batches of 64*K roots
+/// at once (K = --msbfs_words), after Then et al., "The More the Merrier:
+/// Efficient Multi-Source Graph Traversal" (VLDB 2014).
+///
+/// Each vertex keeps K words of bits (one bit per root) for the roots that
+/// have seen it, the roots whose frontier it is in, and the roots that
+/// reached it this level. One visit of an edge ORs a whole frontier word
+/// into the neighbor, so the batch shares the edge scans and messages that
+/// separate BFS's would each repeat. Like bfs_beamer, a level is done
+/// top-down (push frontier bits to neighbors) or bottom-up (vertices still
+/// missing roots pull their neighbors' frontier bits, stopping once they
+/// have them all), switching on the same alpha/beta heuristic.
+///
+/// Only levels are implicit in the bits; parents are recorded for the first
+/// --nverify roots (at most 16), which are then validated like the other
+/// variants. MTEPS counts, for every root, the edges of the vertices it
+/// reached (each undirected edge once).
+////////////////////////////////////////////////////////////////////////
+
+#include "common.hpp"
+#include <Reducer.hpp>
+
+DEFINE_int32(msbfs_words, 1, "Roots per multi-source BFS batch, in 64-bit words (1, 2 or 4)");
+
+DEFINE_double(beamer_alpha, 20.0, 
+  "Beamer BFS parameter (specifies when to switch to bottom-up)");
+DEFINE_double(beamer_beta, 20.0,
+  "Beamer BFS parameter (specifies when to switch back to top-down)");
+
+GRAPPA_DECLARE_METRIC(SummarizingMetric<double>, bfs_mteps);
+GRAPPA_DECLARE_METRIC(SummarizingMetric<double>, total_time);
+GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, bfs_nedge);
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, verify_time);
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, msbfs_batches, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, msbfs_bottom_up_levels, 0);
+
+const int MAX_TRACKED = 16;   // parents kept for validation
+
+GlobalAddress<G> g;
+G::Vertex * base;             // this core's first vertex
+int64_t nlocal;
+
+// K words per local vertex: roots that have seen it, whose frontier it is
+// in, and that reached it during the current level
+std::vector<uint64_t> seen, frontier, next;
+uint64_t all[4];              // bits of the roots in the batch
+std::vector<std::vector<VertexID>> parents;   // of the tracked roots
+
+GlobalCompletionEvent phaser;
+
+Reducer<int64_t,ReducerType::Add> frontier_size, frontier_edges, remaining_edges, reached_edges;
+
+inline int64_t local(G::Vertex& v) { return &v - base; }
+
+template< int K >
+struct Bits {
+  uint64_t w[K];
+  
+  static Bits of(const std::vector<uint64_t>& a, int64_t i) {
+    Bits b;
+    for (int k = 0; k < K; k++) b.w[k] = a[i*K+k];
+    return b;
+  }
+  bool any() const {
+    uint64_t x = 0;
+    for (int k = 0; k < K; k++) x |= w[k];
+    return x != 0;
+  }
+};
+
+/// roots of the batch that have neither seen local vertex `i` nor reached it this level
+template< int K >
+Bits<K> missing(int64_t i) {
+  Bits<K> b;
+  for (int k = 0; k < K; k++) b.w[k] = all[k] & ~(seen[i*K+k] | next[i*K+k]);
+  return b;
+}
+
+/// local vertex `i` is reached from neighbor `from` by the roots in `f`
+template< int K >
+void visit(int64_t i, const Bits<K>& f, VertexID from) {
+  for (int k = 0; k < K; k++) {
+    auto nw = f.w[k] & ~(seen[i*K+k] | next[i*K+k]);
+    if (nw == 0) continue;
+    next[i*K+k] |= nw;
+    for (size_t s = 64*k; s < parents.size() && s < 64*(k+1); s++) {
+      if (nw & (1ul << (s%64))) parents[s][i] = from;
+    }
+  }
+}
+
+template< int K >
+void top_down() {
+  forall(g, [](VertexID i, G::Vertex& v){
+    auto f = Bits<K>::of(frontier, local(v));
+    if (!f.any()) return;
+    // note: 'async' to avoid running out of workers (as in bfs_beamer)
+    forall<async>(adj(g,v), [i,f](G::Edge& e){
+      delegate::call<async>(e.ga, [i,f](G::Vertex& u){
+        visit<K>(local(u), f, i);
+      });
+    });
+  });
+}
+
+template< int K >
+void bottom_up() {
+  forall<&phaser>(g, [](G::Vertex& v){
+    if (!missing<K>(local(v)).any()) return;
+    auto va = make_linear(&v);
+    forall<async,&phaser>(adj(g,v), [=,&v](G::Edge& e){
+      // stop asking once every root has found this vertex
+      auto want = missing<K>(local(v));
+      if (!want.any()) return;
+      
+      phaser.enroll();
+      auto eva = e.ga;
+      send_heap_message(eva.core(), [=]{
+        auto& ev = *eva.pointer();
+        auto f = Bits<K>::of(frontier, local(ev));
+        for (int k = 0; k < K; k++) f.w[k] &= want.w[k];
+        if (f.any()) {
+          auto eid = g->id(ev);
+          send_heap_message(va.core(), [=]{
+            visit<K>(local(*va.pointer()), f, eid);
+            phaser.complete();
+          });
+        } else {
+          phaser.send_completion(va.core());
+        }
+      });
+    });
+  });
+}
+
+/// Traverse from all `roots` at once; returns the time taken.
+template< int K >
+double bfs_batch(const std::vector<VertexID>& roots, size_t ntracked) {
+  int64_t n = roots.size();
+  on_all_cores([n,ntracked]{
+    auto local_vs = iterate_local(g->vs, g->nv);
+    base = local_vs.begin();
+    nlocal = local_vs.size();
+    seen.assign(nlocal*K, 0);
+    frontier.assign(nlocal*K, 0);
+    next.assign(nlocal*K, 0);
+    for (int k = 0; k < K; k++) {
+      auto nk = std::min<int64_t>(std::max<int64_t>(n - 64*k, 0), 64);
+      all[k] = (nk == 64) ? ~0ul : (1ul << nk) - 1;
+    }
+    parents.assign(ntracked, std::vector<VertexID>(nlocal, -1));
+  });
+  
+  for (int64_t s = 0; s < n; s++) {
+    auto r = roots[s];
+    delegate::call(g->vs+r, [s,r](G::Vertex& v){
+      auto i = local(v);
+      seen[i*K + s/64] |= 1ul << (s%64);
+      frontier[i*K + s/64] |= 1ul << (s%64);
+      if (s < (int64_t)parents.size()) parents[s][i] = r;
+    });
+  }
+  
+  double t = walltime();
+  
+  bool top_down_level = true;
+  int64_t nf = n;
+  int64_t prev_nf = -1;
+  int64_t fe = 0;
+  int64_t remaining = g->nadj;
+  int depth = 0;
+  
+  while (nf > 0) {
+    VLOG(1) << "remaining_edges = " << remaining << ", nf = " << nf << ", prev_nf = " << prev_nf << ", frontier_edges = " << fe;
+    if (top_down_level && fe > remaining/FLAGS_beamer_alpha && nf > prev_nf) {
+      VLOG(1) << "switching to bottom-up";
+      top_down_level = false;
+    } else if (!top_down_level && fe < g->nv/FLAGS_beamer_beta && nf < prev_nf) {
+      VLOG(1) << "switching to top-down";
+      top_down_level = true;
+    }
+    
+    if (top_down_level) {
+      top_down<K>();
+    } else {
+      bottom_up<K>();
+      msbfs_bottom_up_levels++;
+    }
+    
+    // what was reached this level is the next frontier
+    frontier_size = 0;
+    frontier_edges = 0;
+    remaining_edges = 0;
+    on_all_cores([]{
+      int64_t nfl = 0, fel = 0, rel = 0;
+      for (int64_t i = 0; i < nlocal; i++) {
+        bool any = false, done = true;
+        for (int k = 0; k < K; k++) {
+          auto f = next[i*K+k];
+          frontier[i*K+k] = f;
+          seen[i*K+k] |= f;
+          next[i*K+k] = 0;
+          any |= (f != 0);
+          done &= (seen[i*K+k] == all[k]);
+        }
+        if (any) { nfl++; fel += base[i].nadj; }
+        if (!done) rel += base[i].nadj;
+      }
+      frontier_size += nfl;
+      frontier_edges += fel;
+      remaining_edges += rel;
+    });
+    prev_nf = nf;
+    nf = frontier_size;
+    fe = frontier_edges;
+    remaining = remaining_edges;
+    depth++;
+  }
+  
+  double time = walltime() - t;
+  
+  reached_edges = 0;
+  on_all_cores([]{
+    int64_t e = 0;
+    for (int64_t i = 0; i < nlocal; i++) {
+      int64_t nroots = 0;
+      for (int k = 0; k < K; k++) nroots += __builtin_popcountl(seen[i*K+k]);
+      e += nroots * base[i].nadj;
+    }
+    reached_edges += e;
+  });
+  LOG(INFO) << "(roots=" << n << ", levels=" << depth << ", time=" << time << ")";
+  return time;
+}
+
+template< int K >
+void bfs_multi(int nbfs, TupleGraph tg) {
+  const int64_t batch = 64*K;
+  for (int64_t b = 0; b < nbfs; b += batch) {
+    std::vector<VertexID> roots;
+    for (int64_t s = b; s < std::min<int64_t>(b + batch, nbfs); s++) roots.push_back(choose_root(g));
+    
+    size_t ntracked = 0;
+    if (b < FLAGS_nverify) {
+      ntracked = std::min<int64_t>(std::min<int64_t>(FLAGS_nverify - b, MAX_TRACKED), roots.size());
+    }
+    
+    double time = bfs_batch<K>(roots, ntracked);
+    int64_t nedge = reached_edges / 2;
+    msbfs_batches++;
+    
+    if (ntracked > 0) {
+      double t = walltime();
+      for (size_t s = 0; s < ntracked; s++) {
+        forall(g, [s](G::Vertex& v){ v->parent = parents[s][local(v)]; });
+        BFSValidator<G>::snapshot(g, roots[s]);
+      }
+      auto nedges = BFSValidator<G>::validate(tg);
+      verify_time = (walltime()-t);
+      LOG(INFO) << verify_time;
+      bfs_nedge = nedges[0];
+    }
+    
+    total_time += time;
+    bfs_mteps += nedge / time / 1.0e6;
+  }
+}
+
+void bfs(GlobalAddress<G> _g, int nbfs, TupleGraph tg) {
+  call_on_all_cores([=]{ g = _g; });
+  switch (FLAGS_msbfs_words) {
+    case 1: bfs_multi<1>(nbfs, tg); break;
+    case 2: bfs_multi<2>(nbfs, tg); break;
+    case 4: bfs_multi<4>(nbfs, tg); break;
+    default: LOG(FATAL) << "--msbfs_words must be 1, 2 or 4";
+  }
+}
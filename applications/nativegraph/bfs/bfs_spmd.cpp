@@ -78,7 +78,7 @@ Frontier frontier;
 GlobalCompletionEvent joiner;
 
 void bfs(GlobalAddress<G> g, int nbfs, TupleGraph tg) {
-  bool verified = false;
+  std::vector<double> unverified_times;
   
   // initialize frontier on each core
   call_on_all_cores([g]{
@@ -161,15 +161,19 @@ void bfs(GlobalAddress<G> g, int nbfs, TupleGraph tg) {
     LOG(INFO) << "(root=" << root << ", time=" << this_total_time << ")";
     total_time += this_total_time;
     
-    if (!verified) {
-      // only verify the first one to save time
+    if (root_idx < FLAGS_nverify) {
+      // only verify the first few to save time (MTEPS once their edge counts are known)
+      unverified_times.push_back(this_total_time);
       t = walltime();
-      bfs_nedge = verify(tg, g, root);
-      verify_time = (walltime()-t);
-      LOG(INFO) << verify_time;
-      verified = true;
+      auto nedge = verify_batch(tg, g, root, root_idx, nbfs);
+      if (!nedge.empty()) {
+        verify_time = (walltime()-t);
+        LOG(INFO) << verify_time;
+        bfs_nedge = nedge[0];
+        for (size_t k = 0; k < nedge.size(); k++) bfs_mteps += nedge[k] / unverified_times[k] / 1.0e6;
+      }
+    } else {
+      bfs_mteps += bfs_nedge / this_total_time / 1.0e6;
     }
-    
-    bfs_mteps += bfs_nedge / this_total_time / 1.0e6;
   }
 }
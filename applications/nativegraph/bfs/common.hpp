@@ -37,3 +37,15 @@ inline int64_t verify(TupleGraph tg, GlobalAddress<G> g, int64_t root) {
   return VerificatorBase<G>::verify(tg, g, root);
 }
 
+DECLARE_int32(nverify);
+
+/// Validate the trees of the first `--nverify` BFS runs together, in one
+/// pass after the last of them. Call after each run; returns the edge counts
+/// of the validated trees at the end of the batch, otherwise nothing.
+inline std::vector<int64_t> verify_batch(TupleGraph tg, GlobalAddress<G> g, int64_t root, int root_idx, int nbfs) {
+  if (root_idx >= FLAGS_nverify) return {};
+  BFSValidator<G>::snapshot(g, root);
+  if (root_idx+1 < std::min(FLAGS_nverify, nbfs)) return {};
+  return BFSValidator<G>::validate(tg);
+}
+
@@ -44,6 +44,7 @@ DEFINE_bool( metrics, false, "Dump metrics");
 DEFINE_int32(scale, 10, "Log2 number of vertices.");
 DEFINE_int32(edgefactor, 16, "Average number of edges per vertex.");
 DEFINE_int32(nbfs, 1, "Number of BFS traversals to do.");
+DEFINE_int32(nverify, 1, "Number of BFS trees to validate (the first ones, together in one pass).");
 
 DEFINE_string(path, "", "Path to graph source file.");
 DEFINE_string(format, "bintsv4", "Format of graph source file.");
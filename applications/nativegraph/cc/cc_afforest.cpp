@@ -0,0 +1,253 @@
+////////////////////////////////////////////////////////////////////////
+/// Afforest Connected Components (Sutton, Ben-Nun & Barak, 2018) for
+/// Grappa Graph: Shiloach-Vishkin style union-find with pointer jumping
+////////////////////////////////////////////////////////////////////////
+///
+/// Each vertex's `color` is its parent in a union-find forest. A parent is
+/// never larger than its child, so the root of a tree is its smallest
+/// vertex, and a root can only be hooked under a smaller vertex.
+///
+/// Unions are done by "hooks" (x,y), executed on the core that owns x: walk
+/// up from x to its root while the path stays on this core, then either
+/// hook the root under y (if y is smaller), swap roles (if y is larger), or
+/// forward the hook to the core owning the next vertex on the path.
+/// Forwarded hooks are buffered per destination core, deduplicated, and
+/// sent in batches; each round delivers one batch of hooks per core pair,
+/// until none are left.
+///
+/// Afforest first links each vertex to only its first `--neighbor_rounds`
+/// neighbors, compressing in between. That is usually enough to form most
+/// of the giant component, which is found by sampling `--num_samples`
+/// vertices; the remaining edges are then linked only from vertices outside
+/// it (every edge is stored in both directions, so none is lost).
+
+#include <Grappa.hpp>
+#include "common.hpp"
+
+#include <random>
+#include <unordered_map>
+
+DEFINE_int32(neighbor_rounds, 2, "Afforest: neighbors per vertex to link before sampling for the largest component");
+DEFINE_int64(num_samples, 1024, "Afforest: vertices sampled to find the largest intermediate component");
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, hook_rounds, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, hook_batches, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, hooks_forwarded, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, hooks_combined, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, skipped_vertices, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, sample_link_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, finish_link_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, compress_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, relabeled_roots, 0);
+
+struct Hook {
+  int64_t x, y;
+  bool operator<(const Hook& h) const { return x < h.x || (x == h.x && y < h.y); }
+  bool operator==(const Hook& h) const { return x == h.x && y == h.y; }
+};
+
+static const size_t hook_batch = MAX_MESSAGE_SIZE / sizeof(Hook) - 1;
+
+/// a batch travels by value in its message
+struct HookBatch {
+  size_t n;
+  Hook hooks[hook_batch];
+};
+
+GlobalAddress<G> g;
+GlobalCompletionEvent hook_gce;
+
+std::vector<Hook> pending;                  // hooks for vertices on this core
+std::vector<std::vector<Hook>> outgoing;    // forwarded hooks, per destination core
+
+int64_t nc;
+
+/// Execute hook (x,y), x on this core, as far as it goes locally.
+void hook(int64_t x, int64_t y) {
+  while (true) {
+    auto& vx = *(g->vs+x).pointer();
+    auto p = vx->color;
+    if (p != x) {
+      x = p;                    // climb
+    } else if (y == x) {
+      return;                   // already in the same tree
+    } else if (y < x) {
+      vx->color = y;            // hook root under the smaller vertex
+      return;
+    } else {
+      std::swap(x, y);          // hook y's root under x instead
+    }
+    auto c = (g->vs+x).core();
+    if (c != mycore()) {
+      outgoing[c].push_back(Hook{x, y});
+      return;
+    }
+  }
+}
+
+/// Send this core's forwarded hooks, combining duplicates.
+void flush_hooks() {
+  Core origin = mycore();
+  for (Core c = 0; c < cores(); c++) {
+    auto& out = outgoing[c];
+    if (out.empty()) continue;
+    std::sort(out.begin(), out.end());
+    auto n = std::unique(out.begin(), out.end()) - out.begin();
+    hooks_forwarded += n;
+    hooks_combined += out.size() - n;
+    for (int64_t i = 0; i < n; i += hook_batch) {
+      HookBatch b;
+      b.n = std::min<int64_t>(hook_batch, n - i);
+      std::copy(out.begin()+i, out.begin()+i+b.n, b.hooks);
+      hook_batches++;
+      hook_gce.enroll();
+      send_heap_message(c, [origin,b]{
+        pending.insert(pending.end(), b.hooks, b.hooks+b.n);
+        hook_gce.send_completion(origin);
+      });
+    }
+    out.clear();
+  }
+}
+
+/// Run `start` on all cores (to issue hooks from local vertices), then
+/// deliver forwarded hooks in rounds until none are left.
+template< typename F >
+void run_hooks(F start) {
+  int64_t remaining;
+  bool first = true;
+  do {
+    hook_gce.enroll();
+    on_all_cores([start,first]{
+      if (first) start();
+      std::vector<Hook> work;
+      work.swap(pending);
+      for (auto& h : work) hook(h.x, h.y);
+      flush_hooks();
+    });
+    hook_gce.complete();
+    hook_gce.wait();
+    hook_rounds++;
+    first = false;
+    remaining = sum_all_cores([]{ return pending.size(); });
+  } while (remaining > 0);
+}
+
+/// Hook each local vertex to its neighbors [r0,r1), skipping the vertices of
+/// component `skip`.
+void link_neighbors(int64_t r0, int64_t r1, color_t skip) {
+  run_hooks([r0,r1,skip]{
+    for (auto& v : iterate_local(g->vs, g->nv)) {
+      if (!v.valid) continue;
+      if (v->color == skip) { skipped_vertices++; continue; }
+      auto i = g->id(v);
+      for (int64_t r = r0; r < std::min(r1, v.nadj); r++) {
+        hook(i, v.local_adj[r]);
+      }
+    }
+  });
+}
+
+/// Pointer jumping: point every vertex directly at its root.
+void compress() {
+  GRAPPA_TIME_REGION(compress_time) {
+    forall(g, [](int64_t i, G::Vertex& v){
+      auto p = v->color;
+      if (p == i) return;
+      while (true) {
+        auto gp = delegate::call(g->vs+p, [](G::Vertex& u){ return u->color; });
+        if (gp == p) break;
+        p = gp;
+      }
+      v->color = p;
+    });
+  }
+}
+
+/// After hooks from only a few vertices: point every vertex at its root,
+/// looking up each distinct label once per core (there are far fewer labels
+/// than vertices, so this is cheaper than compress()).
+void relabel() {
+  on_all_cores([]{
+    std::unordered_map<color_t,color_t> root;
+    for (auto& v : iterate_local(g->vs, g->nv)) root.emplace(v->color, v->color);
+    std::vector<std::pair<color_t,color_t>> labels(root.begin(), root.end());
+    forall_here(0, labels.size(), [&labels](int64_t i){
+      auto p = labels[i].first;
+      while (true) {
+        auto gp = delegate::call(g->vs+p, [](G::Vertex& u){ return u->color; });
+        if (gp == p) break;
+        p = gp;
+      }
+      labels[i].second = p;
+    });
+    for (auto& l : labels) {
+      if (l.second != l.first) relabeled_roots++;
+      root[l.first] = l.second;
+    }
+    for (auto& v : iterate_local(g->vs, g->nv)) v->color = root[v->color];
+  });
+}
+
+size_t count_components() {
+  call_on_all_cores([]{ nc = 0; });
+  forall(g, [](int64_t i, G::Vertex& v){ if (v->color == i) nc++; });
+  return reduce<int64_t,collective_add>(&nc);
+}
+
+/// Most frequent label among a random sample of vertices.
+color_t largest_component() {
+  std::mt19937_64 rng(12345);
+  std::uniform_int_distribution<int64_t> dist(0, g->nv-1);
+  std::unordered_map<color_t,int64_t> counts;
+  color_t best = -1;
+  int64_t most = 0;
+  for (int64_t s = 0; s < FLAGS_num_samples; s++) {
+    auto c = delegate::call(g->vs+dist(rng), [](G::Vertex& v){ return v->color; });
+    if (++counts[c] > most) { most = counts[c]; best = c; }
+  }
+  VLOG(1) << "largest component: " << best << " (" << most << " of " << FLAGS_num_samples << " samples)";
+  return best;
+}
+
+size_t connected_components(GlobalAddress<G> _g) {
+  double t = walltime();
+  
+  call_on_all_cores([=]{
+    g = _g;
+    pending.clear();
+    outgoing.assign(cores(), std::vector<Hook>());
+  });
+  // (invalid vertices too, so edges inserted later can hook them)
+  forall(g->vs, g->nv, [](int64_t i, G::Vertex& v){ v->init(i); });
+  
+  GRAPPA_TIME_REGION(sample_link_time) {
+    for (int64_t r = 0; r < FLAGS_neighbor_rounds; r++) {
+      link_neighbors(r, r+1, -1);
+      compress();
+    }
+  }
+  LOG(INFO) << sample_link_time;
+  
+  GRAPPA_TIME_REGION(finish_link_time) {
+    auto skip = largest_component();
+    link_neighbors(FLAGS_neighbor_rounds, std::numeric_limits<int64_t>::max(), skip);
+  }
+  LOG(INFO) << finish_link_time;
+  
+  compress();
+  components_time = (walltime()-t);
+  LOG(INFO) << compress_time;
+  
+  return count_components();
+}
+
+size_t insert_edges(GlobalAddress<G> _g, GlobalAddress<TupleGraph::Edge> edges, int64_t n) {
+  // union-find only ever merges: hook just the new edges onto the labeling
+  apply_edge_batch(_g, edges, n, EdgeOp::Insert, [](G::Vertex& v, VertexID j){
+    pending.push_back(Hook{g->id(v), j});
+  });
+  run_hooks([]{});
+  relabel();
+  return count_components();
+}
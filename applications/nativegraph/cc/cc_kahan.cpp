@@ -1,25 +1,24 @@
+////////////////////////////////////////////////////////////////////////
+/// Simon Kahan's 3-phase Connected Components (for Grappa Graph)
+////////////////////////////////////////////////////////////////////////
+
 #include <Grappa.hpp>
 #include <GlobalHashSet.hpp>
-#include <graph/Graph.hpp>
+#include "common.hpp"
 
-using namespace Grappa;
 namespace d = Grappa::delegate;
 
-DECLARE_int64(hash_size);
-DECLARE_int64(concurrent_roots);
-
-GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, pram_passes);
-GRAPPA_DECLARE_METRIC(SimpleMetric<int64_t>, set_size);
-GRAPPA_DECLARE_METRIC(SimpleMetric<double>, set_insert_time);
-GRAPPA_DECLARE_METRIC(SimpleMetric<double>, pram_time);
-GRAPPA_DECLARE_METRIC(SimpleMetric<double>, propagate_time);
-GRAPPA_DECLARE_METRIC(SimpleMetric<double>, components_time);
-GRAPPA_DECLARE_METRIC(SimpleMetric<double>, graph_create_time);
-
+DEFINE_int64(hash_size, 1<<14, "size of GlobalHashSet");
+DEFINE_int64(concurrent_roots, 1, "number of concurrent `explores`");
 
-extern GlobalCompletionEvent phaser;
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, pram_passes, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, set_size, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, set_insert_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, pram_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, propagate_time, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, graph_create_time, 0);
 
-using color_t = long;
+GlobalCompletionEvent phaser;
 
 struct Edge {
   int64_t start, end;
@@ -43,19 +42,6 @@ namespace std {
 }
 
 
-struct CCData {
-  color_t color;
-  bool visited;
-  
-  void init(color_t c = -1, bool v = false) {
-    color = c;
-    visited = v;
-  }
-};
-
-using G = Graph<CCData,Empty>;
-
-
 color_t color(GlobalAddress<G::Vertex> v) {
   return delegate::call(v, [](G::Vertex& v){ return v->color; });
 }
@@ -211,6 +197,8 @@ size_t connected_components(GlobalAddress<G> _g) {
   call_on_all_cores([=]{
     comp_set = _set;
     g = _g;
+    local_set.clear();
+    nc = 0;
   });
     
   GRAPPA_TIME_REGION(set_insert_time) {
@@ -306,3 +294,9 @@ size_t connected_components(GlobalAddress<G> _g) {
   auto ncomponents = reduce<int64_t,collective_add>(&nc);
   return ncomponents;
 }
+
+size_t insert_edges(GlobalAddress<G> g, GlobalAddress<TupleGraph::Edge> edges, int64_t n) {
+  // the phases start from scratch, so just label the grown graph again
+  apply_edge_batch(g, edges, n, EdgeOp::Insert);
+  return connected_components(g);
+}
@@ -0,0 +1,66 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <Grappa.hpp>
+#include <graph/Graph.hpp>
+
+using namespace Grappa;
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, components_time);
+
+using color_t = long;
+
+struct CCData {
+  color_t color;
+  bool visited;
+  
+  void init(color_t c = -1, bool v = false) {
+    color = c;
+    visited = v;
+  }
+};
+
+using G = Graph<CCData,Empty>;
+
+/// Label every vertex with a component (`color`); returns the number of
+/// components with at least one edge. Each component's label is the index of
+/// one of its vertices, whose own label is itself.
+size_t connected_components(GlobalAddress<G> g);
+
+/// Insert `n` edges (the tuples at `edges`) into `g`, which has been labeled
+/// by connected_components(), and bring the labels up to date; returns the
+/// new number of components.
+size_t insert_edges(GlobalAddress<G> g, GlobalAddress<TupleGraph::Edge> edges, int64_t n);
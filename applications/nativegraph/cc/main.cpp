@@ -33,11 +33,12 @@
 ////////////////////////////////////////////////////////////////////////
 
 ////////////////////////////////////////////////////////////////////////
-/// Simon Kahan's 3-phase Connected Components (for Grappa Graph)
+/// Connected Components driver (for Grappa Graph); the algorithm is
+/// linked in: cc_kahan.cpp or cc_afforest.cpp
 ////////////////////////////////////////////////////////////////////////
 
 #include <Grappa.hpp>
-#include "cc_kahan.hpp"
+#include "common.hpp"
 
 DEFINE_bool( metrics, false, "Dump metrics");
 
@@ -47,28 +48,35 @@ DEFINE_int32(edgefactor, 16, "Average number of edges per vertex.");
 DEFINE_string(path, "", "Path to graph source file.");
 DEFINE_string(format, "bintsv4", "Format of graph source file.");
 
+DEFINE_int32(update_batches, 0, "Build the graph without the last --update_fraction of the edges, label it, then insert those edges in this many batches, updating the labels after each");
+DEFINE_double(update_fraction, 0.1, "Fraction of the edges held back for --update_batches");
+
+DEFINE_bool(verify, false, "Check that every edge joins vertices with the same component label, and that labels are component roots.");
+
 GRAPPA_DEFINE_METRIC(SimpleMetric<double>, init_time, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<double>, tuple_time, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<double>, construction_time, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<double>, total_time, 0);
 
-////////////////////
-// used in cc_kahan
-GlobalCompletionEvent phaser;
-
-DEFINE_int64(hash_size, 1<<14, "size of GlobalHashSet");
-DEFINE_int64(concurrent_roots, 1, "number of concurrent `explores`");
-
 GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, ncomponents, 0);
-GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, pram_passes, 0);
-GRAPPA_DEFINE_METRIC(SimpleMetric<int64_t>, set_size, 0);
-GRAPPA_DEFINE_METRIC(SimpleMetric<double>, set_insert_time, 0);
-GRAPPA_DEFINE_METRIC(SimpleMetric<double>, pram_time, 0);
-GRAPPA_DEFINE_METRIC(SimpleMetric<double>, propagate_time, 0);
 GRAPPA_DEFINE_METRIC(SimpleMetric<double>, components_time, 0);
-GRAPPA_DEFINE_METRIC(SimpleMetric<double>, graph_create_time, 0);
+GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, update_time, 0);
 
-size_t connected_components(GlobalAddress<G> g);
+int64_t max_id;
+
+void verify(GlobalAddress<G> g) {
+  forall(g, [g](int64_t i, G::Vertex& v){
+    auto c = v->color;
+    CHECK(c >= 0 && c < g->nv) << "vertex " << i << " has no component";
+    auto cc = delegate::call(g->vs+c, [](G::Vertex& r){ return r->color; });
+    CHECK_EQ(cc, c) << "label of vertex " << i << " is not a root";
+    forall<async>(adj(g,v), [c](G::Edge& e){
+      auto ec = delegate::call(e.ga, [](G::Vertex& u){ return u->color; });
+      CHECK_EQ(ec, c) << "edge to " << e.id << " crosses components";
+    });
+  });
+  LOG(INFO) << "verified";
+}
 
 int main(int argc, char* argv[]) {
   init(&argc, &argv);
@@ -91,7 +99,14 @@ int main(int argc, char* argv[]) {
     LOG(INFO) << "constructing graph";
     t = walltime();
     
-    auto g = G::Undirected(tg);
+    // with updates, the first graph has only some of the edges (but all the vertices)
+    TupleGraph initial = tg;
+    if (FLAGS_update_batches > 0) initial.nedge -= tg.nedge * FLAGS_update_fraction;
+    call_on_all_cores([]{ max_id = 0; });
+    forall(tg.edges, tg.nedge, [](TupleGraph::Edge& e){ max_id = std::max(max_id, std::max(e.v0, e.v1)); });
+    auto nv = reduce<int64_t,collective_max>(&max_id) + 1;
+    
+    auto g = G::create(initial, false, true, nv);
     
     construction_time = walltime()-t;
     LOG(INFO) << construction_time;
@@ -101,19 +116,29 @@ int main(int argc, char* argv[]) {
     }
     LOG(INFO) << total_time;
     
+    auto held = tg.nedge - initial.nedge;
+    for (int64_t b = 0; b < FLAGS_update_batches; b++) {
+      auto start = initial.nedge + held * b / FLAGS_update_batches;
+      auto n = initial.nedge + held * (b+1) / FLAGS_update_batches - start;
+      t = walltime();
+      auto nc = insert_edges(g, tg.edges+start, n);
+      double time = walltime() - t;
+      ncomponents = nc;
+      update_time += time;
+      LOG(INFO) << "(batch=" << b << ", edges=" << n << ", components=" << nc << ", time=" << time << ")";
+    }
+    
     if (FLAGS_scale <= 8) {
       g->dump([](std::ostream& o, G::Vertex& v){
         o << "{ label:" << v->color << " }";
       });
     }
     
+    if (FLAGS_verify) verify(g);
+    
     if (FLAGS_metrics) Metrics::merge_and_print();
     else {
-      LOG(INFO) << "\n" << set_insert_time
-                << "\n" << pram_time
-                << "\n" << propagate_time
-                << "\n" << ncomponents
-                << "\n" << set_size
+      LOG(INFO) << "\n" << ncomponents
                 << "\n" << components_time;
     }
     Metrics::merge_and_dump_to_file();
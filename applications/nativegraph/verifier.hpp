@@ -4,10 +4,417 @@
 #include <Grappa.hpp>
 #include <graph/Graph.hpp>
 
+#include <vector>
+#include <algorithm>
+
 using namespace Grappa;
 
 extern int64_t nedge_traversed;
 
+/// Distributed validation of BFS parent trees, following the Graph500 rules:
+///
+/// - the root is its own parent
+/// - every other tree vertex's parent is a vertex in the tree, and following
+///   parents leads to the root without a cycle
+/// - every input edge has both endpoints in the tree or neither (so the tree
+///   spans a whole connected component)
+/// - levels (depth in the parent tree) of the endpoints of every input edge
+///   differ by at most one (tree edges differ by exactly one, by construction)
+/// - every tree vertex but the root is joined to its parent by an input edge
+///
+/// Levels are computed from the parents by pointer jumping, a logarithmic
+/// number of rounds. The edge pass is a forall over each core's share of the
+/// TupleGraph edges. Endpoints' (parent, level) pairs are bulk-fetched from
+/// their owners in one request and one reply message per batch of vertices
+/// per core, through a per-core cache. Violations are counted per core (the
+/// first few are logged) and the counts combined in one reduction at the end.
+///
+/// Several trees can be validated in one pass: snapshot() each BFS result (a
+/// copy of the parents), then validate() them all. Every fetch and edge scan
+/// then serves all of them.
+template <typename G>
+class BFSValidator {
+  using Vertex = typename G::Vertex;
+  
+  enum Rule { ROOT, PARENT, CYCLE, SPAN, LEVEL, TREE_EDGE, NRULES };
+  
+  static const char * rule_name(int r) {
+    switch (r) {
+      case ROOT:      return "root is not its own parent";
+      case PARENT:    return "parent is not a tree vertex";
+      case CYCLE:     return "parents do not lead to the root";
+      case SPAN:      return "edge leaves the tree";
+      case LEVEL:     return "edge joins levels more than one apart";
+      case TREE_EDGE: return "no edge to parent";
+    }
+    return "?";
+  }
+  
+  /// level of a tree vertex that failed a check (not checked further)
+  static const int64_t FAILED = -2;
+  
+  struct Tree {
+    int64_t root;
+    std::vector<int64_t> parent, anc, level;   // per local vertex
+    std::vector<bool> seen;
+  };
+  
+  static const size_t max_trees = 16;
+  static const size_t reply_words = MAX_MESSAGE_SIZE / sizeof(int64_t) - 2;
+  static const size_t request_words = reply_words / 3;
+  
+  /// fixed-size batch of words; travels by value in its message
+  template< size_t N >
+  struct Words {
+    size_t n;
+    int64_t w[N];
+  };
+  
+  /// Per-core cache of vertices to fetch: each distinct vertex gets a slot,
+  /// and its (x, level) words for every tree end up at 2*ntrees*slot.
+  struct Cache {
+    std::vector<int64_t> keys;     // open addressing, -1 = empty
+    std::vector<uint32_t> slot_of;
+    std::vector<int64_t> ids;      // by slot
+    std::vector<int64_t> vals;
+    size_t mask;
+    
+    void reset(size_t n) {
+      size_t cap = 1;
+      while (cap < 2*n) cap *= 2;
+      keys.assign(cap, -1);
+      slot_of.resize(cap);
+      ids.clear();
+      mask = cap - 1;
+    }
+    uint32_t slot(int64_t id) {
+      auto h = (uint64_t(id) * 0x9e3779b97f4a7c15ULL >> 20) & mask;
+      while (keys[h] != id) {
+        if (keys[h] == -1) {
+          keys[h] = id;
+          slot_of[h] = ids.size();
+          ids.push_back(id);
+          break;
+        }
+        h = (h + 1) & mask;
+      }
+      return slot_of[h];
+    }
+    const int64_t * get(uint32_t s, size_t t) const { return &vals[(s*ntrees() + t)*2]; }
+    static size_t ntrees() { return trees.size(); }
+  };
+  
+  using Getter = void (*)(const Tree&, int64_t, int64_t*);
+  
+  static GlobalAddress<G> g;
+  static Vertex * base;
+  static std::vector<int64_t> ids;             // of local vertices
+  static std::vector<Tree> trees;
+  static std::vector<int64_t> counts;          // per tree: errors by rule, then edges
+  static std::vector<std::vector<int64_t>> marks;  // (tree, vertex) pairs, per core
+  static int64_t nlogged;
+  static int64_t active;                       // vertices not yet at their root
+  static GlobalCompletionEvent gce;
+  
+  static int64_t local(int64_t id) { return (g->vs+id).pointer() - base; }
+  
+  /// count an error; true if it should also be logged
+  static bool error(size_t t, Rule r) {
+    counts[t*(NRULES+1) + r]++;
+    return nlogged++ < 10;
+  }
+  
+  static void get_anc(const Tree& tr, int64_t i, int64_t * out) {
+    out[0] = tr.anc[i]; out[1] = tr.level[i];
+  }
+  static void get_parent(const Tree& tr, int64_t i, int64_t * out) {
+    out[0] = tr.parent[i]; out[1] = tr.level[i];
+  }
+  
+  static void fill(int64_t id, Getter get, int64_t * out) {
+    auto i = local(id);
+    for (size_t t = 0; t < trees.size(); t++) get(trees[t], i, out+2*t);
+  }
+  
+  /// Fetch get() of every tree for each vertex in the cache: local ones are
+  /// read directly, the rest with one request and one reply per batch.
+  static void fetch(Getter get, Cache& cache) {
+    size_t width = 2*trees.size();
+    size_t per_msg = reply_words / width;
+    if (per_msg > request_words) per_msg = request_words;
+    
+    cache.vals.resize(cache.ids.size() * width);
+    std::vector<std::vector<uint32_t>> by_core(cores());
+    for (uint32_t s = 0; s < cache.ids.size(); s++) {
+      auto c = (g->vs+cache.ids[s]).core();
+      if (c == mycore()) fill(cache.ids[s], get, &cache.vals[s*width]);
+      else by_core[c].push_back(s);
+    }
+    
+    CompletionEvent ce;
+    auto pce = &ce;
+    auto vals = cache.vals.data();
+    Core origin = mycore();
+    for (Core c = 0; c < cores(); c++) {
+      auto& out = by_core[c];
+      for (size_t k = 0; k < out.size(); k += per_msg) {
+        Words<request_words> req;
+        req.n = std::min(per_msg, out.size() - k);
+        for (size_t i = 0; i < req.n; i++) req.w[i] = cache.ids[out[k+i]];
+        auto slots = &out[k];
+        ce.enroll();
+        send_heap_message(c, [origin,pce,vals,slots,get,width,req]{
+          Words<reply_words> rep;
+          rep.n = req.n;
+          for (size_t i = 0; i < req.n; i++) fill(req.w[i], get, rep.w + i*width);
+          send_heap_message(origin, [pce,vals,slots,width,rep]{
+            for (size_t i = 0; i < rep.n; i++) {
+              std::copy(rep.w + i*width, rep.w + (i+1)*width, vals + slots[i]*width);
+            }
+            pce->complete();
+          });
+        });
+      }
+    }
+    ce.wait();
+  }
+  
+  static void send_marks(Core c) {
+    auto& out = marks[c];
+    if (out.empty()) return;
+    Words<request_words> b;
+    b.n = out.size();
+    std::copy(out.begin(), out.end(), b.w);
+    out.clear();
+    gce.enroll();
+    Core origin = mycore();
+    send_heap_message(c, [origin,b]{
+      for (size_t i = 0; i < b.n; i += 2) trees[b.w[i]].seen[local(b.w[i+1])] = true;
+      gce.send_completion(origin);
+    });
+  }
+  
+  /// note that vertex `id` of tree `t` has an edge to its parent
+  static void mark(size_t t, int64_t id) {
+    auto c = (g->vs+id).core();
+    if (c == mycore()) {
+      trees[t].seen[local(id)] = true;
+    } else {
+      marks[c].push_back(t);
+      marks[c].push_back(id);
+      if (marks[c].size() + 2 > request_words) send_marks(c);
+    }
+  }
+  
+  /// pointer jumping: one round of anc <- anc[anc], level += level[anc];
+  /// returns the number of local vertices not yet at their root
+  static int64_t jump() {
+    Cache cache;
+    cache.reset(ids.size() * trees.size());
+    std::vector<uint32_t> slot(ids.size() * trees.size());
+    for (size_t t = 0; t < trees.size(); t++) {
+      auto& tr = trees[t];
+      for (size_t i = 0; i < ids.size(); i++) {
+        if (tr.anc[i] >= 0 && tr.anc[i] != tr.root) slot[t*ids.size()+i] = cache.slot(tr.anc[i]);
+      }
+    }
+    fetch(&get_anc, cache);
+    
+    int64_t active = 0;
+    for (size_t t = 0; t < trees.size(); t++) {
+      auto& tr = trees[t];
+      for (size_t i = 0; i < ids.size(); i++) {
+        auto a = tr.anc[i];
+        if (a < 0 || a == tr.root) continue;
+        auto p = cache.get(slot[t*ids.size()+i], t);
+        if (p[0] == -1) {
+          if (error(t, PARENT)) LOG(ERROR) << "root " << tr.root << ": ancestor " << a << " of " << ids[i] << " is not in the tree";
+          tr.anc[i] = tr.level[i] = FAILED;
+        } else if (p[0] == FAILED) {
+          tr.anc[i] = tr.level[i] = FAILED;
+        } else {
+          tr.level[i] += p[1];
+          tr.anc[i] = p[0];
+          if (tr.anc[i] != tr.root) active++;
+        }
+      }
+    }
+    return active;
+  }
+  
+  /// check this core's share of the input edges
+  static void check_edges(TupleGraph tg) {
+    const size_t chunk = 1 << 16;
+    Cache cache;
+    std::vector<uint32_t> slot(2*chunk);
+    auto edges = iterate_local(tg.edges, tg.nedge);
+    auto nedge = edges.size();
+    auto nv = g->nv;
+    auto valid = [nv](const TupleGraph::Edge& e) {
+      return e.v0 >= 0 && e.v1 >= 0 && e.v0 < nv && e.v1 < nv;
+    };
+    for (size_t k = 0; k < nedge; k += chunk) {
+      auto e0 = edges.begin() + k;
+      size_t n = std::min(chunk, nedge - k);
+      cache.reset(2*n);
+      for (size_t x = 0; x < n; x++) {
+        if (!valid(e0[x])) continue;
+        slot[2*x] = cache.slot(e0[x].v0);
+        slot[2*x+1] = cache.slot(e0[x].v1);
+      }
+      fetch(&get_parent, cache);
+      
+      for (size_t x = 0; x < n; x++) {
+        if (!valid(e0[x])) continue;
+        auto i = e0[x].v0, j = e0[x].v1;
+        for (size_t t = 0; t < trees.size(); t++) {
+          auto pi = cache.get(slot[2*x], t), pj = cache.get(slot[2*x+1], t);
+          auto li = pi[1], lj = pj[1];
+          if (li == FAILED || lj == FAILED) continue;
+          if ((li >= 0) != (lj >= 0)) {
+            if (error(t, SPAN)) LOG(ERROR) << "root " << trees[t].root << ": edge (" << i << "," << j << ") has only one endpoint in the tree";
+            continue;
+          }
+          if (li < 0) continue;
+          // both in the tree: counts as traversed (including self-edges and duplicates)
+          counts[t*(NRULES+1) + NRULES]++;
+          if (li - lj > 1 || lj - li > 1) {
+            if (error(t, LEVEL)) LOG(ERROR) << "root " << trees[t].root << ": edge (" << i << "," << j << ") joins levels " << li << " and " << lj;
+          }
+          if (i != j) {
+            if (pi[0] == j) mark(t, i);
+            if (pj[0] == i) mark(t, j);
+          }
+        }
+      }
+    }
+    for (Core c = 0; c < cores(); c++) send_marks(c);
+  }
+  
+public:
+  
+  /// Save the parents of the BFS tree from `root` (for the next validate()).
+  static void snapshot(GlobalAddress<G> _g, int64_t root) {
+    on_all_cores([_g,root]{
+      g = _g;
+      auto local_vs = iterate_local(g->vs, g->nv);
+      base = local_vs.begin();
+      ids.clear();
+      Tree tr;
+      tr.root = root;
+      for (auto& v : local_vs) {
+        ids.push_back(g->id(v));
+        tr.parent.push_back(v.valid ? v->parent : -1);
+      }
+      trees.push_back(std::move(tr));
+      CHECK_LE(trees.size(), max_trees) << "validate() at most " << max_trees << " trees at a time";
+    });
+  }
+  
+  /// Validate all snapshotted trees (then forget them); fails if any breaks
+  /// the rules. Returns the number of input edges in each tree.
+  static std::vector<int64_t> validate(TupleGraph tg) {
+    auto k = trees.size();
+    
+    on_all_cores([]{
+      counts.assign(trees.size() * (NRULES+1), 0);
+      marks.assign(cores(), std::vector<int64_t>());
+      nlogged = 0;
+      auto nv = g->nv;
+      for (size_t t = 0; t < trees.size(); t++) {
+        auto& tr = trees[t];
+        tr.anc.resize(ids.size());
+        tr.level.resize(ids.size());
+        tr.seen.assign(ids.size(), false);
+        for (size_t i = 0; i < ids.size(); i++) {
+          auto p = tr.parent[i];
+          tr.anc[i] = p;
+          tr.level[i] = 1;
+          if (ids[i] == tr.root) {
+            if (p != tr.root && error(t, ROOT)) LOG(ERROR) << "root " << tr.root << " has parent " << p;
+            tr.anc[i] = tr.root;
+            tr.level[i] = 0;
+          } else if (p == -1) {
+            tr.level[i] = -1;
+          } else if (p < 0 || p >= nv || p == ids[i]) {
+            if (error(t, p == ids[i] ? CYCLE : PARENT)) LOG(ERROR) << "root " << tr.root << ": vertex " << ids[i] << " has parent " << p;
+            tr.anc[i] = tr.level[i] = FAILED;
+          }
+        }
+      }
+    });
+    
+    // levels: paths halve every round, so past log2(nv) rounds the rest are cycles
+    int64_t max_rounds = 2;
+    for (int64_t n = g->nv; n > 1; n /= 2) max_rounds++;
+    int64_t rounds = 0;
+    do {
+      on_all_cores([]{ active = allreduce<int64_t,collective_add>(jump()); });
+      rounds++;
+    } while (active > 0 && rounds < max_rounds);
+    
+    on_all_cores([]{
+      for (size_t t = 0; t < trees.size(); t++) {
+        auto& tr = trees[t];
+        for (size_t i = 0; i < ids.size(); i++) {
+          if (tr.anc[i] >= 0 && tr.anc[i] != tr.root) {
+            if (error(t, CYCLE)) LOG(ERROR) << "root " << tr.root << ": parents of " << ids[i] << " do not reach the root";
+            tr.anc[i] = tr.level[i] = FAILED;
+          }
+        }
+      }
+    });
+    
+    gce.enroll();
+    on_all_cores([tg]{ check_edges(tg); });
+    gce.complete();
+    gce.wait();
+    
+    on_all_cores([]{
+      for (size_t t = 0; t < trees.size(); t++) {
+        auto& tr = trees[t];
+        for (size_t i = 0; i < ids.size(); i++) {
+          if (tr.level[i] > 0 && !tr.seen[i]) {
+            if (error(t, TREE_EDGE)) LOG(ERROR) << "root " << tr.root << ": no edge from " << ids[i] << " to its parent " << tr.parent[i];
+          }
+        }
+      }
+      auto n = counts.size();
+      auto total = locale_alloc<int64_t>(n);
+      std::copy(counts.begin(), counts.end(), total);
+      allreduce_inplace<int64_t,collective_add>(total, n);
+      std::copy(total, total+n, counts.begin());
+      locale_free(total);
+    });
+    
+    std::vector<int64_t> nedge(k);
+    int64_t nerrors = 0;
+    for (size_t t = 0; t < k; t++) {
+      auto c = &counts[t*(NRULES+1)];
+      for (int r = 0; r < NRULES; r++) {
+        if (c[r] > 0) LOG(ERROR) << "BFS tree from " << trees[t].root << ": " << c[r] << " x " << rule_name(r);
+        nerrors += c[r];
+      }
+      nedge[t] = c[NRULES];
+    }
+    VLOG(1) << "validated " << k << " trees (" << rounds << " pointer-jumping rounds)";
+    
+    call_on_all_cores([]{ trees.clear(); });
+    CHECK_EQ(nerrors, 0) << "BFS validation failed";
+    return nedge;
+  }
+};
+
+template <typename G> GlobalAddress<G> BFSValidator<G>::g;
+template <typename G> typename G::Vertex * BFSValidator<G>::base;
+template <typename G> std::vector<int64_t> BFSValidator<G>::ids;
+template <typename G> std::vector<typename BFSValidator<G>::Tree> BFSValidator<G>::trees;
+template <typename G> std::vector<int64_t> BFSValidator<G>::counts;
+template <typename G> std::vector<std::vector<int64_t>> BFSValidator<G>::marks;
+template <typename G> int64_t BFSValidator<G>::nlogged;
+template <typename G> int64_t BFSValidator<G>::active;
+template <typename G> GlobalCompletionEvent BFSValidator<G>::gce;
+
 template <typename G>
 class VerificatorBase {
   using Vertex = typename G::Vertex;
@@ -58,72 +465,12 @@ public:
     });
   }
 
+  /// Validate the BFS tree from `root` (see BFSValidator); returns the
+  /// number of input edges in it.
   static inline int64_t verify(TupleGraph tg, GlobalAddress<G> g, int64_t root) {
-
-    // check root
-    delegate::call(g->vs+root, [=](Vertex& v){
-        CHECK_EQ(v->parent, root);
-    });
-
-    call_on_all_cores([]{ nedge_traversed = 0; });
-
-    // verify levels & parents match
-    forall(tg.edges, tg.nedge, [=](TupleGraph::Edge& e){
-      auto max_bfsvtx = g->nv - 1;
-      auto i = e.v0, j = e.v1;
-
-      int64_t lvldiff;
-
-      if (i < 0 || j < 0) return;
-      CHECK(!(i > max_bfsvtx && j <= max_bfsvtx)) << "Error!";
-      CHECK(!(j > max_bfsvtx && i <= max_bfsvtx)) << "Error!";
-      if (i > max_bfsvtx) // both i & j are on the same side of max_bfsvtx
-      return;
-
-      // All neighbors must be in the tree.
-      auto ti = get_parent(g,i), tj = get_parent(g,j);
-      CHECK(!(ti >= 0 && tj < 0)) << "Error! ti=" << ti << ", tj=" << tj;
-      CHECK(!(tj >= 0 && ti < 0)) << "Error! ti=" << ti << ", tj=" << tj;
-      if (ti < 0) // both i & j have the same sign
-        return;
-
-      /* Both i and j are in the tree, count as a traversed edge.
-         NOTE: This counts self-edges and repeated edges.  They're
-         part of the input data.
-      */
-      nedge_traversed++;
-
-      auto mark_seen = [g](int64_t i){
-        delegate::call(g->vs+i, [](Vertex& v){ v->seen = true; });
-      };
-
-      // Mark seen tree edges.
-      if (i != j) {
-        if (ti == j)
-          mark_seen(i);
-        if (tj == i)
-          mark_seen(j);
-      }
-      lvldiff = get_level(g,i) - get_level(g,j);
-      /* Check that the levels differ by no more than one. */
-      CHECK(!(lvldiff > 1 || lvldiff < -1)) << "Error, levels differ by more than one! " << "(k = " << ", lvl[" << i << "]=" 
-        << get_level(g,i) << ", lvl[" << j << "]=" << get_level(g,j) << ")";
-
-    });
-
-    nedge_traversed = Grappa::reduce<int64_t,collective_add>(&nedge_traversed);
-
-    // check that every BFS edge was seen & that there's only one root
-    forall(g, [=](VertexID i, Vertex& v){
-      if (i != root) {
-        CHECK(!(v->parent >= 0 && !v->seen)) << "Error!" << "VertexID: " << i <<" v->parent =" << v->parent << " v->seen = " << v->seen;
-        CHECK_NE(v->parent, i);
-      }
-    });
-
-    // everything checked out!
+    BFSValidator<G>::snapshot(g, root);
+    nedge_traversed = BFSValidator<G>::validate(tg)[0];
     VLOG(1) << "verified!\n";
-
     return nedge_traversed;
   }
 };
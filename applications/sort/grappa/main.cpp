@@ -25,6 +25,7 @@
 #include <ParallelLoop.hpp>
 #include <Metrics.hpp>
 #include <AsyncDelegate.hpp>
+#include <Sort.hpp>
 
 #include "npb_intsort.h"
 
@@ -100,6 +101,7 @@ bool read_from_disk;
 bool generate;
 bool write_to_disk;
 bool do_sort;
+std::string algorithm;
 
 #define LOBITS (log2maxkey - log2buckets)
 
@@ -309,10 +311,7 @@ int main(int argc, char* argv[]) {
     /////////
     // sort
     /////////
-    if (do_sort) {
-      bucket_sort(array, nelems, nbuckets);
-
-      // verify
+    auto verify = [array]{
       size_t jump = nelems/17;
       uint64_t prev;
       for (size_t i=0; i<nelems; i+=jump) {
@@ -323,6 +322,23 @@ int main(int argc, char* argv[]) {
           prev = curr;
         }
       }
+    };
+    
+    if (do_sort && (algorithm == "bucket" || algorithm == "both")) {
+      bucket_sort(array, nelems, nbuckets);
+      verify();
+    }
+    
+    if (do_sort && (algorithm == "sample" || algorithm == "both")) {
+      if (algorithm == "both") {
+        // re-randomize what bucket_sort just sorted
+        forall(array, nelems, [](int64_t i, uint64_t& e){ e = next_random(); });
+      }
+      t = Grappa::walltime();
+      Grappa::sort(array, nelems);
+      double sample_sort_time = Grappa::walltime() - t;
+      LOG(INFO) << "sample_sort_time: " << sample_sort_time;
+      verify();
     }
 
     Metrics::merge_and_print();
@@ -341,6 +357,7 @@ static void printHelp(const char * exe) {
   printf("  --write,w   Save array to file.\n");
   printf("  --read,r  Read from file rather than generating.\n");
   printf("  --nosort  Skip sort.\n");
+  printf("  --algorithm,a  Which sort to run: 'bucket' (default), 'sample' (Grappa::sort), or 'both' to compare.\n");
   exit(0);
 }
 
@@ -354,7 +371,9 @@ static void parseOptions(int argc, char ** argv) {
     {"gen", no_argument, 0, 'g'},
     {"read", no_argument, 0, 'r'},
     {"write", no_argument, 0, 'w'},
-    {"nosort", no_argument, 0, 'n'}
+    {"nosort", no_argument, 0, 'n'},
+    {"algorithm", required_argument, 0, 'a'},
+    {0, 0, 0, 0}
   };
   
   // defaults
@@ -362,6 +381,7 @@ static void parseOptions(int argc, char ** argv) {
   read_from_disk = false;
   write_to_disk = false;
   do_sort = true;
+  algorithm = "bucket";
   scale = 8;
 
   // at least 2*num_nodes buckets by default
@@ -379,7 +399,7 @@ static void parseOptions(int argc, char ** argv) {
   while (c != -1) {
     int option_index = 0;
     npb_class cls;
-    c = getopt_long(argc, argv, "hs:b:", long_opts, &option_index);
+    c = getopt_long(argc, argv, "hs:b:a:", long_opts, &option_index);
     switch (c) {
       case 'h':
         printHelp(argv[0]);
@@ -410,6 +430,10 @@ static void parseOptions(int argc, char ** argv) {
         break;
       case 'n':
         do_sort = false;
+        break;
+      case 'a':
+        algorithm = optarg;
+        break;
     }
   }
   nelems = 1L << scale;
@@ -17,7 +17,7 @@ $cmd = %Q[ make -j mpi_run TARGET=sort.exe NNODE=%{nnode} PPN=%{ppn}
     --io_blocks_per_node=%{io_blocks_per_node}
     --io_blocksize_mb=%{io_blocksize_mb}
     --v=1
-    -- -s %{scale} --log2buckets=%{log2buckets} --log2maxkey=%{log2maxkey} 
+    -- -s %{scale} --log2buckets=%{log2buckets} --log2maxkey=%{log2maxkey} --algorithm=%{algorithm}
   '
 ].gsub(/[\n\r\ ]+/," ")
 $machinename = "sampa"
@@ -28,6 +28,7 @@ $params = {
   scale: [20],
   log2buckets: [7],
   log2maxkey: [10],
+  algorithm: %w[ bucket sample ],
   nnode: [12],
   ppn: [3],
   nworkers: [1024],
@@ -5,6 +5,7 @@ $params = {
   scale: [16],
   log2buckets: [7],
   log2maxkey: [10],
+  algorithm: %w[ bucket sample ],
   nnode: [12],
   ppn: [2],
   nworkers: [1024],
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+/// Compare a bulk shuffle with Grappa::alltoallv() against the same shuffle done with
+/// one async delegate per element (as in the sort and graph construction code).
+///
+/// Each element of a global array is sent to the core chosen by hashing it.
+
+#include "Grappa.hpp"
+#include "Collective.hpp"
+#include "Delegate.hpp"
+#include "ParallelLoop.hpp"
+#include "GlobalAllocator.hpp"
+#include "Metrics.hpp"
+
+DEFINE_int64( shuffle_per_core, 1<<20, "Number of 8-byte elements shuffled from each core" );
+
+using namespace Grappa;
+
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, alltoallv_shuffle_time, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, delegate_shuffle_time, 0 );
+
+std::vector<int64_t> received;
+
+inline Core owner(int64_t x) {
+  return (x * 0x9E3779B97F4A7C15ULL >> 32) % cores();
+}
+
+int main(int argc, char * argv[]) {
+  init(&argc, &argv);
+  run([]{
+    int64_t n = FLAGS_shuffle_per_core * cores();
+    auto data = global_alloc<int64_t>(n);
+    forall(data, n, [](int64_t i, int64_t& x){ x = i; });
+    
+    double t = walltime();
+    on_all_cores([data,n]{
+      int64_t * local = data.localize();
+      int64_t nlocal = (data+n).localize() - local;
+      int64_t * recv;
+      alltoallv<int64_t>([=](size_t * counts){
+        for (int64_t i=0; i<nlocal; i++) counts[owner(local[i])]++;
+      }, [=](int64_t ** next){
+        for (int64_t i=0; i<nlocal; i++) *next[owner(local[i])]++ = local[i];
+      }, &recv);
+      locale_free(recv);
+    });
+    alltoallv_shuffle_time = walltime() - t;
+    
+    t = walltime();
+    forall(data, n, [](int64_t i, int64_t& x){
+      auto v = x;
+      delegate::call<async>(owner(v), [v]{ received.push_back(v); });
+    });
+    delegate_shuffle_time = walltime() - t;
+    
+    CHECK_EQ(sum_all_cores([]{ return received.size(); }), static_cast<size_t>(n));
+    
+    global_free(data);
+    Metrics::merge_and_print();
+  });
+  finalize();
+}
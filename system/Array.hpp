@@ -42,6 +42,7 @@
 #include "GlobalAllocator.hpp"
 #include <type_traits>
 #include "Delegate.hpp"
+#include "Primitives.hpp"
 
 namespace Grappa {
 /// @addtogroup Containers
@@ -140,6 +141,31 @@ void memcpy(GlobalAddress<T> dst, GlobalAddress<T> src, size_t nelem) {
   }
 }
 
+/// Copy element `k` of `src` to element `k` of `dst`, where either may be strided, a
+/// struct member column, or an index list (see Selection in IncoherentGather.hpp).
+/// Runs in the calling task, moving a chunk at a time with Incoherent<T>::Gather and
+/// Incoherent<T>::Scatter, so each chunk's gather overlaps the previous chunk's scatter.
+///
+/// @code
+///   // copy the weights out of an array of edges
+///   Grappa::memcpy(Selection<double>::strided(weights, n, 1),
+///                  Selection<double>::column(edges, n, &Edge::weight));
+/// @endcode
+template< typename T >
+void memcpy(const Selection<T>& dst, const Selection<T>& src) {
+  CHECK_EQ(dst.count, src.count);
+  const size_t chunk = 1 << 12;
+  std::vector<T> bufs[2] = { std::vector<T>(chunk), std::vector<T>(chunk) };
+  std::unique_ptr<typename Incoherent<T>::Scatter> writing;
+  for (size_t k=0, b=0; k<src.count; k+=chunk, b^=1) {
+    size_t n = std::min(chunk, src.count-k);
+    typename Incoherent<T>::Gather g(src.slice(k,n), &bufs[b][0]);
+    g.block_until_acquired();
+    writing.reset(new typename Incoherent<T>::Scatter(dst.slice(k,n), &bufs[b][0]));
+    writing->start_release();
+  }
+}
+
 /// Helper so we don't have to change the code if we change a Global pointer to a normal pointer (in theory).
 template< typename T >
 inline void memcpy(T* dst, T* src, size_t nelem) {
@@ -163,11 +189,11 @@ void memcpy_async(GlobalAddress<T> dst, GlobalAddress<T> src, size_t nelem) {
   });
 }
 
-/// not implemented yet
+/// In-place exclusive prefix sum: `array[i]` becomes the sum of the elements before it.
+/// (See Primitives.hpp for other scans.)
 template< typename T >
 void prefix_sum(GlobalAddress<T> array, size_t nelem) {
-  // not implemented
-  CHECK(false) << "prefix_sum is currently unimplemented!";
+  exclusive_scan(array, nelem, array);
 }
 
 namespace util {
@@ -184,10 +210,15 @@ namespace util {
   /// @endcode
   template<typename T>
   inline std::string array_str(const char * name, GlobalAddress<T> base, size_t nelem, int width = 10) {
+    std::vector<T> xs(nelem);
+    if (nelem > 0) {
+      typename Incoherent<T>::RO c(base, nelem, &xs[0]);
+      c.block_until_acquired();
+    }
     std::stringstream ss; ss << "\n" << name << ": [";
     for (size_t i=0; i<nelem; i++) {
       if (i % width == 0) ss << "\n  ";
-      ss << " " << delegate::read(base+i);
+      ss << " " << xs[i];
     }
     ss << "\n]";
     return ss.str();
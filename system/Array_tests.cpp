@@ -115,10 +115,6 @@ void test_prefix_sum() {
   auto xs = Grappa::global_alloc<int64_t>(N);
   Grappa::memset(xs, 1, N);
   
-  // prefix-sum
-//  for (int64_t i=0; i<N; i++) {
-//    Grappa::delegate::write(xs+i, i);
-//  }
   Grappa::prefix_sum(xs, N);
   
   Grappa::forall(xs, N, [](int64_t i, int64_t& v){
@@ -163,7 +159,7 @@ BOOST_AUTO_TEST_CASE( test1 ) {
     test_memset_memcpy<int64_t,7>(true); // test async
     // test_memset_memcpy<double,7.0>();
     test_complex();
-    // test_prefix_sum(); // (not implemented yet)
+    test_prefix_sum();
     test_push_buffer();
     
     BOOST_MESSAGE("Testing memcpy on 2D addresses");
@@ -44,6 +44,7 @@
 
 #include "IncoherentAcquirer.hpp"
 #include "IncoherentReleaser.hpp"
+#include "IncoherentGather.hpp"
 
 /// stats for caches
 class CacheMetrics {
@@ -387,12 +388,121 @@ public:
   }
 };
 
+/// Read-only cache object for a Selection of elements (strided, a struct member
+/// column, or an index list) instead of a contiguous range. Element `k` of the
+/// selection is cached at `[k]`.
+///
+/// @b Example:
+/// @code
+///   int64_t buf[n];
+///   Incoherent<int64_t>::Gather c(Selection<int64_t>::indexed(xs, n, indices), buf);
+///   c.start_acquire();        // overlap with other acquires...
+///   c.block_until_acquired();
+/// @endcode
+template< typename T, template< typename TT > class Allocator >
+class CacheGather {
+protected:
+  Selection< T > selection_;
+  Allocator< T > storage_;
+  T * pointer_;
+  GatherAcquirer< T > acquirer_;
+
+public:
+  explicit CacheGather( const Selection< T >& selection, T * buffer = NULL )
+    : selection_( selection )
+    , storage_( buffer, selection.count )
+    , pointer_( storage_.pointer() )
+    , acquirer_( &selection_, &pointer_ )
+  { }
+
+  /// send acquire messages
+  void start_acquire() {
+    CacheMetrics::count_ro_acquire( sizeof(T)*selection_.count );
+    acquirer_.start_acquire();
+  }
+
+  /// block until acquire is completed
+  void block_until_acquired() {
+    acquirer_.block_until_acquired();
+  }
+
+  /// reassign cache to a different selection of the same size or smaller
+  void reset( const Selection< T >& selection ) {
+    block_until_acquired();
+    CHECK_LE( selection.count, selection_.count );
+    selection_ = selection;
+    acquirer_.reset();
+  }
+
+  const Selection< T >& selection() const { return selection_; }
+
+  /// Dereference cache
+  operator const T*() {
+    block_until_acquired();
+    return pointer_;
+  }
+};
+
+/// Write-only cache object for a Selection of elements: fill in `[k]` for each
+/// element `k` of the selection, then release to write them all back.
+template< typename T, template< typename TT > class Allocator >
+class CacheScatter {
+protected:
+  Selection< T > selection_;
+  Allocator< T > storage_;
+  T * pointer_;
+  ScatterReleaser< T > releaser_;
+
+public:
+  explicit CacheScatter( const Selection< T >& selection, T * buffer = NULL )
+    : selection_( selection )
+    , storage_( buffer, selection.count )
+    , pointer_( storage_.pointer() )
+    , releaser_( &selection_, &pointer_ )
+  { }
+
+  ~CacheScatter() {
+    block_until_released();
+  }
+
+  /// send release messages
+  void start_release() {
+    CacheMetrics::count_wo_release( sizeof(T)*selection_.count );
+    releaser_.start_release();
+  }
+
+  /// block until release is completed
+  void block_until_released() {
+    if( !releaser_.released() ) {
+      start_release();
+      releaser_.block_until_released();
+    }
+  }
+
+  /// reassign cache to a different selection of the same size or smaller
+  void reset( const Selection< T >& selection ) {
+    block_until_released();
+    CHECK_LE( selection.count, selection_.count );
+    selection_ = selection;
+    releaser_.reset();
+  }
+
+  const Selection< T >& selection() const { return selection_; }
+
+  /// Dereference cache
+  operator T*() {
+    return pointer_;
+  }
+};
+
 /// All the incoherent caches with the right fields filled in.
 template< typename T >
 struct Incoherent {
   typedef CacheRO< T, CacheAllocator, IncoherentAcquirer, NullReleaser > RO;
   typedef CacheRW< T, CacheAllocator, IncoherentAcquirer, IncoherentReleaser > RW;
   typedef CacheWO< T, CacheAllocator, NullAcquirer, IncoherentReleaser > WO;
+  typedef CacheGather< T, CacheAllocator > Gather;
+  typedef CacheScatter< T, CacheAllocator > Scatter;
 };
 
 /// @}
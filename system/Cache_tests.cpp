@@ -360,6 +360,49 @@ BOOST_AUTO_TEST_CASE( test1 ) {
       Grappa::global_free( array );
     }
 
+    {
+      BOOST_MESSAGE("Gather/scatter test");
+      const size_t n = 1000;
+      auto xs = Grappa::global_alloc<int64_t>(n);
+      Grappa::forall(xs, n, [](int64_t i, int64_t& x){ x = i; });
+
+      // every 3rd element
+      const size_t m = n / 3;
+      std::vector<int64_t> buf(m);
+      {
+        Incoherent<int64_t>::Gather g(Selection<int64_t>::strided(xs, m, 3), &buf[0]);
+        g.block_until_acquired();
+        for (size_t k = 0; k < m; k++) BOOST_CHECK_EQUAL(g[k], 3*k);
+      }
+
+      // scatter negated values back through an index list
+      std::vector<int64_t> idx(m);
+      for (size_t k = 0; k < m; k++) idx[k] = (k * 7919) % n;
+      std::sort(idx.begin(), idx.end());
+      idx.erase(std::unique(idx.begin(), idx.end()), idx.end());
+      for (size_t k = 0; k < idx.size(); k++) buf[k] = -idx[k];
+      {
+        Incoherent<int64_t>::Scatter sc(Selection<int64_t>::indexed(xs, idx.size(), &idx[0]), &buf[0]);
+        sc.block_until_released();
+      }
+      for (size_t k = 0; k < idx.size(); k++) {
+        BOOST_CHECK_EQUAL(Grappa::delegate::read(xs+idx[k]), -idx[k]);
+      }
+
+      // column of a struct array, copied out with the bulk memcpy
+      struct Pair { int64_t a; double b; };
+      auto ps = Grappa::global_alloc<Pair>(n);
+      Grappa::forall(ps, n, [](int64_t i, Pair& p){ p.a = i; p.b = 0.5 * i; });
+      auto bs = Grappa::global_alloc<double>(n);
+      Grappa::memcpy(Selection<double>::strided(bs, n, 1),
+                     Selection<double>::column(ps, n, &Pair::b));
+      for (size_t i = 0; i < n; i += 97) BOOST_CHECK_EQUAL(Grappa::delegate::read(bs+i), 0.5 * i);
+
+      Grappa::global_free(bs);
+      Grappa::global_free(ps);
+      Grappa::global_free(xs);
+    }
+
     {
       BOOST_MESSAGE("Empty cache test");
 
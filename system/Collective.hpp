@@ -45,6 +45,9 @@
 
 #include <functional>
 #include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
 
 // TODO/FIXME: use actual max message size (have Communicator be able to tell us)
 const size_t MAX_MESSAGE_SIZE = 3192;
@@ -498,6 +501,305 @@ namespace Grappa {
     return total;
   }
   
+  namespace impl {
+    
+    /// Per-core state for Grappa::alltoallv (one instance per element type).
+    template< typename T >
+    struct Alltoallv {
+      /// run of elements from `src` bound for `dst`, handed to the core relaying them off-locale
+      struct Segment { const T * elems; size_t n; Core src; Core dst; };
+      /// header preceding each run of elements packed into a relayed chunk
+      struct Record { size_t offset; size_t n; Core src; Core dst; };
+      
+      static CompletionEvent counts_ce, peers_ce, handoffs_ce, data_ce;
+      static std::vector<size_t> recv_counts;
+      static size_t * recv_offsets;                  // (locale-shared, written into by peers)
+      static T * recv;                               // (locale-shared, written into by peers)
+      static std::vector<T*> peer_recv;              // receive buffers of cores in this locale
+      static std::vector<size_t*> peer_offsets;
+      static std::vector<std::vector<std::pair<const Segment*,size_t>>> handoffs; // by locale
+      static std::vector<char*> chunks;              // sent from here, freed once all have arrived
+      
+      /// copy elements from `src` directly into the receive buffer of `dst` (in this locale)
+      static void place(Core src, Core dst, size_t offset, const void * elems, size_t n) {
+        DCHECK(peer_recv[dst] != nullptr) << "core " << dst << " not in locale " << mylocale();
+        std::memcpy(peer_recv[dst] + peer_offsets[dst][src] + offset, elems, n*sizeof(T));
+      }
+      
+      /// let `dst` know `n` of its elements have landed
+      static void credit(Core dst, size_t n) {
+        if (dst == mycore()) {
+          data_ce.complete(n);
+        } else {
+          send_heap_message(dst, [n]{ data_ce.complete(n); });
+        }
+      }
+      
+      /// unpack a chunk relayed from another locale (runs on this locale's receiving core)
+      static void deliver(const char * buf, size_t size) {
+        Core dst = -1;
+        size_t landed = 0;
+        for (size_t i = 0; i < size; ) {
+          Record r;
+          std::memcpy(&r, buf+i, sizeof(r));
+          i += sizeof(r);
+          place(r.src, r.dst, r.offset, buf+i, r.n);
+          i += r.n * sizeof(T);
+          
+          // records are grouped by destination, so credit each run once
+          if (r.dst != dst) {
+            if (landed > 0) credit(dst, landed);
+            dst = r.dst;
+            landed = 0;
+          }
+          landed += r.n;
+        }
+        if (landed > 0) credit(dst, landed);
+      }
+      
+      /// pack segments (grouped by destination) into message-sized chunks and send them to `to`
+      static void relay(Core to, const std::vector<Segment>& segs) {
+        char * chunk = nullptr;
+        size_t used = 0;
+        auto flush = [&]{
+          if (used > 0) {
+            send_heap_message(to, [](void * payload, size_t payload_size){
+              deliver(static_cast<char*>(payload), payload_size);
+            }, chunk, used);
+            chunks.push_back(chunk);
+          } else if (chunk) {
+            locale_free(chunk);
+          }
+          chunk = nullptr;
+          used = 0;
+        };
+        for (auto& s : segs) {
+          for (size_t k = 0; k < s.n; ) {
+            if (chunk && MAX_MESSAGE_SIZE - used < sizeof(Record) + sizeof(T)) flush();
+            if (!chunk) chunk = locale_alloc<char>(MAX_MESSAGE_SIZE);
+            
+            size_t m = std::min(s.n - k, (MAX_MESSAGE_SIZE - used - sizeof(Record)) / sizeof(T));
+            Record r = { k, m, s.src, s.dst };
+            std::memcpy(chunk+used, &r, sizeof(r));
+            used += sizeof(r);
+            std::memcpy(chunk+used, s.elems+k, m*sizeof(T));
+            used += m*sizeof(T);
+            k += m;
+          }
+        }
+        flush();
+      }
+    };
+    template< typename T > CompletionEvent Alltoallv<T>::counts_ce;
+    template< typename T > CompletionEvent Alltoallv<T>::peers_ce;
+    template< typename T > CompletionEvent Alltoallv<T>::handoffs_ce;
+    template< typename T > CompletionEvent Alltoallv<T>::data_ce;
+    template< typename T > std::vector<size_t> Alltoallv<T>::recv_counts;
+    template< typename T > size_t * Alltoallv<T>::recv_offsets;
+    template< typename T > T * Alltoallv<T>::recv;
+    template< typename T > std::vector<T*> Alltoallv<T>::peer_recv;
+    template< typename T > std::vector<size_t*> Alltoallv<T>::peer_offsets;
+    template< typename T > std::vector<std::vector<std::pair<const typename Alltoallv<T>::Segment*,size_t>>> Alltoallv<T>::handoffs;
+    template< typename T > std::vector<char*> Alltoallv<T>::chunks;
+    
+  } // namespace impl
+  
+  /// Called from SPMD context. Personalized all-to-all exchange: this core sends
+  /// `send_counts[c]` elements to each core `c`, taken in core order from `send`, and
+  /// receives everything sent to it, ordered by source core, into a new buffer `*recv`
+  /// (allocated with `locale_alloc`; caller must `locale_free` it). Returns the number of
+  /// elements received; if `recv_counts` is given, it gets how many came from each core.
+  ///
+  /// Data moves in bulk rather than as per-element messages. Blocks destined for cores in
+  /// this locale are copied straight into their receive buffers through locale-shared
+  /// memory. Blocks for another locale are handed to the core the aggregator uses as the
+  /// source for that locale (`source_core_for_locale_`), which packs everything from this
+  /// locale into full-size chunks for that locale's receiving core
+  /// (`dest_core_for_locale_`), which in turn copies each run into place. So each pair of
+  /// locales exchanges a stream of full messages between one pair of cores, rather than
+  /// one stream per pair of cores.
+  ///
+  /// Blocks until every core has received everything, so suffices as a global barrier.
+  ///
+  /// @b Example:
+  /// @code
+  ///   Grappa::on_all_cores([]{
+  ///     int64_t * send = locale_alloc<int64_t>(n);
+  ///     std::vector<size_t> counts(cores());
+  ///     // ... fill `send` grouped by destination, `counts[c]` elements for core c ...
+  ///     int64_t * recv;
+  ///     size_t nrecv = Grappa::alltoallv(send, &counts[0], &recv);
+  ///     locale_free(send);
+  ///     // ... use recv[0..nrecv) ...
+  ///     locale_free(recv);
+  ///   });
+  /// @endcode
+  ///
+  /// @warning `send` must be in locale-shared memory (e.g. `locale_alloc`), as other cores
+  ///          in this locale read from it directly.
+  ///
+  /// @warning Only one alltoallv of a given element type may be in flight at a time
+  ///          (uses static per-core state).
+  template< typename T >
+  size_t alltoallv(const T * send, const size_t * send_counts, T ** recv, size_t * recv_counts = nullptr) {
+    typedef impl::Alltoallv<T> A;
+    typedef typename A::Segment Segment;
+    static_assert(sizeof(typename A::Record) + sizeof(T) <= MAX_MESSAGE_SIZE,
+                  "element too large to be exchanged in a message");
+    auto& route = impl::global_rdma_aggregator;
+    const Core me = mycore();
+    
+    // (cores in a locale are numbered contiguously, as the aggregator also assumes)
+    auto locale_first = [](Locale l) -> Core { return l * locale_cores(); };
+    
+    // set up for everything we'll receive before anyone can send it
+    A::recv_counts.assign(cores(), 0);
+    A::peer_recv.assign(cores(), nullptr);
+    A::peer_offsets.assign(cores(), nullptr);
+    A::handoffs.assign(locales(), {});
+    A::counts_ce.enroll(cores());
+    A::peers_ce.enroll(locale_cores());
+    for (Locale l = 0; l < locales(); l++) {
+      if (l != mylocale() && route.source_core_for_locale_[l] == me) {
+        A::handoffs_ce.enroll(locale_cores());
+      }
+    }
+    barrier();
+    
+    // tell everyone how much to expect, then make room for it
+    std::vector<size_t> send_offsets(cores(), 0);
+    for (Core c = 1; c < cores(); c++) send_offsets[c] = send_offsets[c-1] + send_counts[c-1];
+    if (send_offsets[cores()-1] + send_counts[cores()-1] > 0) {
+      impl::locale_shared_memory.validate_address(const_cast<T*>(send));
+    }
+    
+    for (Core i = 0; i < cores(); i++) {
+      Core c = (me + i) % cores();
+      auto n = send_counts[c];
+      send_heap_message(c, [me,n]{
+        A::recv_counts[me] = n;
+        A::counts_ce.complete();
+      });
+    }
+    A::counts_ce.wait();
+    
+    size_t nrecv = 0;
+    A::recv_offsets = locale_alloc<size_t>(cores());
+    for (Core c = 0; c < cores(); c++) {
+      A::recv_offsets[c] = nrecv;
+      nrecv += A::recv_counts[c];
+    }
+    A::recv = locale_alloc<T>(std::max<size_t>(nrecv,1));
+    A::data_ce.enroll(nrecv);
+    
+    // publish our receive buffer to the rest of the locale
+    auto r = A::recv;
+    auto o = A::recv_offsets;
+    for (Core c = locale_first(mylocale()); c < locale_first(mylocale()+1); c++) {
+      send_heap_message(c, [me,r,o]{
+        A::peer_recv[me] = r;
+        A::peer_offsets[me] = o;
+        A::peers_ce.complete();
+      });
+    }
+    A::peers_ce.wait();
+    barrier();
+    
+    // same locale: copy straight into the destination's receive buffer
+    for (Core i = 0; i < locale_cores(); i++) {
+      Core d = locale_first(mylocale()) + (locale_mycore() + i) % locale_cores();
+      if (send_counts[d] > 0) {
+        A::place(me, d, 0, send + send_offsets[d], send_counts[d]);
+        A::credit(d, send_counts[d]);
+      }
+    }
+    
+    // other locales: hand our blocks to this locale's relay for each
+    Segment * segs = locale_alloc<Segment>(cores());
+    size_t nsegs = 0;
+    for (Locale i = 1; i < locales(); i++) {
+      Locale l = (mylocale() + i) % locales();
+      const Segment * first = segs + nsegs;
+      size_t n = 0;
+      for (Core d = locale_first(l); d < locale_first(l+1); d++) {
+        if (send_counts[d] > 0) {
+          segs[nsegs++] = Segment{ send + send_offsets[d], send_counts[d], me, d };
+          n++;
+        }
+      }
+      send_heap_message(route.source_core_for_locale_[l], [first,n,l]{
+        A::handoffs[l].emplace_back(first, n);
+        A::handoffs_ce.complete();
+      });
+    }
+    
+    // relay: once the whole locale has handed off, ship it all in full chunks
+    A::handoffs_ce.wait();
+    for (Locale l = 0; l < locales(); l++) {
+      if (A::handoffs[l].empty()) continue;
+      std::vector<Segment> all;
+      for (auto& h : A::handoffs[l]) all.insert(all.end(), h.first, h.first + h.second);
+      std::stable_sort(all.begin(), all.end(), [](const Segment& a, const Segment& b){
+        return a.dst < b.dst;
+      });
+      A::relay(route.dest_core_for_locale_[l], all);
+    }
+    
+    A::data_ce.wait();
+    barrier(); // everyone has everything, so no one is still reading our buffers
+    
+    for (auto c : A::chunks) locale_free(c);
+    A::chunks.clear();
+    A::handoffs.clear();
+    locale_free(segs);
+    locale_free(A::recv_offsets);
+    A::recv_offsets = nullptr;
+    
+    if (recv_counts) std::copy(A::recv_counts.begin(), A::recv_counts.end(), recv_counts);
+    *recv = A::recv;
+    A::recv = nullptr;
+    return nrecv;
+  }
+  
+  /// Called from SPMD context. alltoallv() with the send buffer built by callbacks:
+  /// `count(size_t * counts)` adds to `counts[c]` the number of elements bound for each
+  /// core `c`, then `fill(T ** next)` writes each element `x` for core `c` with
+  /// `*next[c]++ = x`.
+  ///
+  /// @b Example:
+  /// @code
+  ///   Grappa::on_all_cores([]{
+  ///     int64_t * recv;
+  ///     size_t nrecv = Grappa::alltoallv<int64_t>([](size_t * counts){
+  ///       for (auto& e : local_edges) counts[owner(e.v)]++;
+  ///     }, [](int64_t ** next){
+  ///       for (auto& e : local_edges) *next[owner(e.v)]++ = e.v;
+  ///     }, &recv);
+  ///     // ...
+  ///     locale_free(recv);
+  ///   });
+  /// @endcode
+  template< typename T, typename CountF, typename FillF >
+  typename std::enable_if< !std::is_pointer<CountF>::value, size_t >::type
+  alltoallv(CountF count, FillF fill, T ** recv, size_t * recv_counts = nullptr) {
+    std::vector<size_t> counts(cores(), 0);
+    count(&counts[0]);
+    
+    std::vector<T*> next(cores());
+    size_t total = 0;
+    for (auto n : counts) total += n;
+    T * send = locale_alloc<T>(std::max<size_t>(total,1));
+    
+    next[0] = send;
+    for (Core c = 1; c < cores(); c++) next[c] = next[c-1] + counts[c-1];
+    fill(&next[0]);
+    DCHECK_EQ(next[cores()-1], send + total) << "fill() wrote a different number of elements than count()";
+    
+    auto nrecv = alltoallv(send, &counts[0], recv, recv_counts);
+    locale_free(send);
+    return nrecv;
+  }
+  
   /// @}
 } // namespace Grappa
 
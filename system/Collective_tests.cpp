@@ -112,6 +112,50 @@ BOOST_AUTO_TEST_CASE( test1 ) {
       for (int i=0; i<N; i++) BOOST_CHECK_EQUAL(xs[i], Grappa::cores() * i);
     });
     
+    BOOST_MESSAGE("testing alltoallv");
+    Grappa::on_all_cores([]{
+      // some blocks empty, some spanning several messages
+      auto count = [](Core src, Core dst) -> size_t { return ((src + dst) % 3) * 1000; };
+      auto tag = [](Core src, Core dst, size_t i) -> int64_t { return (src*cores() + dst)*1000000L + i; };
+      
+      std::vector<size_t> send_counts(cores());
+      size_t nsend = 0;
+      for (Core c = 0; c < cores(); c++) nsend += send_counts[c] = count(mycore(), c);
+      int64_t * send = locale_alloc<int64_t>(nsend);
+      int64_t * p = send;
+      for (Core c = 0; c < cores(); c++) {
+        for (size_t i = 0; i < send_counts[c]; i++) *p++ = tag(mycore(), c, i);
+      }
+      
+      int64_t * recv;
+      std::vector<size_t> recv_counts(cores());
+      size_t nrecv = Grappa::alltoallv(send, &send_counts[0], &recv, &recv_counts[0]);
+      locale_free(send);
+      
+      size_t k = 0;
+      for (Core c = 0; c < cores(); c++) {
+        BOOST_CHECK_EQUAL(recv_counts[c], count(c, mycore()));
+        for (size_t i = 0; i < recv_counts[c]; i++, k++) {
+          if (recv[k] != tag(c, mycore(), i)) BOOST_CHECK_EQUAL(recv[k], tag(c, mycore(), i));
+        }
+      }
+      BOOST_CHECK_EQUAL(nrecv, k);
+      locale_free(recv);
+      
+      // count-then-fill version: core c gets c+1 copies of each sender's id
+      Core * ids;
+      nrecv = Grappa::alltoallv<Core>([](size_t * counts){
+        for (Core c = 0; c < cores(); c++) counts[c] += c+1;
+      }, [](Core ** next){
+        for (Core c = 0; c < cores(); c++) {
+          for (Core i = 0; i <= c; i++) *next[c]++ = mycore();
+        }
+      }, &ids);
+      BOOST_CHECK_EQUAL(nrecv, cores() * (mycore()+1));
+      for (size_t i = 0; i < nrecv; i++) BOOST_CHECK_EQUAL(ids[i], i / (mycore()+1));
+      locale_free(ids);
+    });
+    
     Grappa::call_on_all_cores([]{ global_x = 1; });
     
     auto total = Grappa::sum_all_cores([]{ return global_x; });
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+#include "CombiningDelegate.hpp"
+#include "Collective.hpp"
+#include <vector>
+
+DEFINE_int64(combining_slots, 64, "Pending combinable updates tracked per destination core, in 2-way sets by address; when a set is full, the oldest update in it is sent without further combining");
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, combining_updates, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, combining_hits, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, combining_messages, 0);
+
+namespace Grappa {
+namespace impl {
+
+// this core's slots, cores() * FLAGS_combining_slots of them, allocated on first use
+static std::vector< CombiningMessageBase* > slots;
+
+static inline size_t set_index( Core dest, intptr_t raw ) {
+  // consecutive words take consecutive sets, and each run of `sets` words
+  // starts at a hashed set, so neither neighbors nor strides share a set
+  size_t sets = FLAGS_combining_slots / combining_ways;
+  uint64_t word = static_cast<uint64_t>( raw ) / sizeof(int64_t);
+  uint64_t h = bittwiddle::mix64( word / sets ) + word;
+  return (dest * sets + h % sets) * combining_ways;
+}
+
+CombiningMessageBase ** combining_set( Core dest, intptr_t raw ) {
+  if( slots.empty() ) {
+    CHECK_GE( FLAGS_combining_slots, combining_ways );
+    slots.assign( cores() * (FLAGS_combining_slots / combining_ways) * combining_ways, nullptr );
+  }
+  return &slots[ set_index( dest, raw ) ];
+}
+
+void CombiningMessageBase::mark_sent() {
+  // on the sending core this is the final mark, after which the message is freed
+  if( Grappa::mycore() == source_ && !slots.empty() ) {
+    auto set = &slots[ set_index( destination_, target_ ) ];
+    for( int w = 0; w < combining_ways; w++ ) {
+      if( set[w] == this ) set[w] = nullptr;
+    }
+  }
+  MessageBase::mark_sent();
+}
+
+} // namespace impl
+
+namespace delegate {
+
+static uint64_t updates_here, hits_here;
+
+double combining_hit_rate() {
+  on_all_cores([]{
+    updates_here = combining_updates.value();
+    hits_here = combining_hits.value();
+  });
+  uint64_t updates = reduce<uint64_t,collective_add>(&updates_here);
+  uint64_t hits = reduce<uint64_t,collective_add>(&hits_here);
+  return updates ? double(hits) / updates : 0.0;
+}
+
+} // namespace delegate
+} // namespace Grappa
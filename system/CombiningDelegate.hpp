@@ -0,0 +1,289 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Addressing.hpp"
+#include "Communicator.hpp"
+#include "MessageBase.hpp"
+#include "SharedMessagePool.hpp"
+#include "GlobalCompletionEvent.hpp"
+#include "Collective.hpp"
+#include "Metrics.hpp"
+#include <cstring>
+#include <type_traits>
+
+/// Number of combining slots per destination core (see delegate::combine).
+DECLARE_int64(combining_slots);
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, combining_updates);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, combining_hits);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, combining_messages);
+
+namespace Grappa {
+
+  namespace impl {
+
+    /// A message applying `*target = Op(*target, value)` on the target's core; with
+    /// --compact_messages the target goes as an offset into the heap chunk (or, for a 2D
+    /// address, as the home core's pointer; see core_offset()). Async writes and
+    /// increments send one each; delegate::combine also lets later updates to the same
+    /// address be folded into it for as long as it waits in the aggregator. For that, the
+    /// sending core keeps it in a slot of a small 2-way set-associative table per
+    /// destination (by address) until it is sent; merging locks the message with `state_`,
+    /// and serializing or delivering it seals it for good, so later updates go in a new
+    /// message instead. Slots are only touched by the sending core, which is also where
+    /// the message is finally marked sent and freed.
+    class CombiningMessageBase : public MessageBase {
+    protected:
+      enum State { OPEN = 0, LOCKED = 1, SEALED = 2 };
+      volatile int32_t state_;
+
+      CombiningMessageBase( Core dest, intptr_t target, intptr_t op, GlobalCompletionEvent * gce )
+        : MessageBase( dest ), state_( OPEN ), target_( target ), op_( op ), gce_( gce ) {}
+
+      /// Stop further merges; spins while the sending core is in the middle of one.
+      void seal() {
+        while( !__sync_bool_compare_and_swap( &state_, OPEN, SEALED ) ) {
+          if( state_ == SEALED ) return;
+        }
+      }
+
+    public:
+      const intptr_t target_; ///< raw global address being updated
+      const intptr_t op_;     ///< combining function, so only like updates are merged
+      GlobalCompletionEvent * const gce_; ///< enrolled once for the message, so only updates to the same one are merged
+
+      bool lock() { return __sync_bool_compare_and_swap( &state_, OPEN, LOCKED ); }
+      void unlock() { __sync_synchronize(); state_ = OPEN; }
+
+      virtual void mark_sent();
+    };
+
+    const int combining_ways = 2;
+
+    /// The set of `combining_ways` slots, newest first, for updates to `raw` going to
+    /// `dest` (defined in CombiningDelegate.cpp).
+    CombiningMessageBase ** combining_set( Core dest, intptr_t raw );
+
+    template< typename T, T (*Op)(const T&, const T&) >
+    class CombiningMessage : public CombiningMessageBase {
+      struct Wire {
+        intptr_t target;
+        T value;
+        GlobalCompletionEvent * gce;
+        Core origin;
+      };
+
+    public:
+      T value_;
+
+      CombiningMessage( Core dest, intptr_t target, T value, GlobalCompletionEvent * gce )
+        : CombiningMessageBase( dest, target, reinterpret_cast<intptr_t>( Op ), gce )
+        , value_( value ) {}
+
+      static void apply( intptr_t target, const T& value ) {
+        T * p = GlobalAddress<T>::Raw( target ).pointer();
+        *p = Op( *p, value );
+      }
+
+      static char * deserialize_and_call( char * t ) {
+        Wire w;
+        memcpy( &w, t, sizeof(w) );
+        apply( w.target, w.value );
+        if( w.gce ) w.gce->send_completion( w.origin );
+        return t + sizeof(w);
+      }
+
+      /// Same, for messages written with --compact_messages: the target is a tagged heap
+      /// offset or pointer and the completion event and origin are varints.
+      static char * deserialize_compact( char * t ) {
+        T * p = reinterpret_cast< T * >( core_offset_pointer( get_varint( t ) ) );
+        T value;
+        memcpy( &value, t, sizeof(T) );
+        t += sizeof(T);
+        auto gce = reinterpret_cast< GlobalCompletionEvent * >( get_varint( t ) );
+        Core origin = get_varint( t );
+        *p = Op( *p, value );
+        if( gce ) gce->send_completion( origin );
+        return t;
+      }
+
+      virtual void deliver_locally() {
+        if( !is_delivered_ ) {
+          seal();
+          apply( target_, value_ );
+          if( gce_ ) gce_->send_completion( source_ );
+          is_delivered_ = true;
+        }
+        this->mark_sent();
+      }
+
+      virtual char * serialize_to( char * p, size_t max_size ) {
+        MessageBase::serialize_to( p, max_size );
+        // (the exact size takes a few varints to work out, so only when it might not fit)
+        const size_t full = 1 + sizeof(MessageFPAddr) + sizeof(Wire);
+        const size_t compact = 2 + message_header_dest_size + 10 + sizeof(T) + 10 + 3;
+        const size_t most = full > compact ? full : compact;
+        if( max_size < most && serialized_size() > max_size ) return p;
+        seal();
+        if( FLAGS_compact_messages ) {
+          p = write_message_header( p, destination_, DeserializerID< &deserialize_compact >::id, &deserialize_compact );
+          p = put_varint( p, core_offset( target_ ) );
+          memcpy( p, &value_, sizeof(T) );
+          p += sizeof(T);
+          p = put_varint( p, reinterpret_cast< uintptr_t >( gce_ ) );
+          return put_varint( p, static_cast< uint16_t >( source_ ) );
+        }
+        p = write_message_header( p, destination_, 0, &deserialize_and_call );
+        Wire w = { target_, value_, gce_, source_ };
+        memcpy( p, &w, sizeof(w) );
+        return p + sizeof(w);
+      }
+
+      virtual const size_t serialized_size() const {
+        if( FLAGS_compact_messages ) {
+          return message_header_size( DeserializerID< &deserialize_compact >::id )
+            + varint_size( core_offset( target_ ) ) + sizeof(T)
+            + varint_size( reinterpret_cast< uintptr_t >( gce_ ) ) + varint_size( static_cast< uint16_t >( source_ ) );
+        }
+        return message_header_size( 0 ) + sizeof(Wire);
+      }
+      virtual const size_t size() const { return sizeof(*this); }
+      virtual const char * typestr() { return "CombiningMessage"; }
+    };
+
+    template< typename T, T (*Op)(const T&, const T&) >
+    CombiningMessage<T,Op> * update_message( GlobalAddress<T> target, T value, GlobalCompletionEvent * gce ) {
+      auto m = new (SharedMessagePool::alloc(sizeof(CombiningMessage<T,Op>)))
+        CombiningMessage<T,Op>( target.core(), target.raw_bits(), value, gce );
+      m->delete_after_send();
+      return m;
+    }
+
+    template< typename T >
+    T update_assign( const T& a, const T& b ) { return b; }
+
+    /// Send one async update on its own (never combined), in a CombiningMessage for the
+    /// compact encoding (about half the bytes of the equivalent delegate::call<async>).
+    template< typename T, T (*Op)(const T&, const T&), GlobalCompletionEvent * C >
+    void send_update( GlobalAddress<T> target, T value ) {
+      if( C ) C->enroll();
+      update_message<T,Op>( target, value, C )->enqueue();
+    }
+
+    /// Used by delegate::increment<async> and delegate::write<async> (with
+    /// --compact_messages) for values that can go in an update message; return false
+    /// for others.
+    template< GlobalCompletionEvent * C, typename T, typename U >
+    typename std::enable_if< std::is_arithmetic<T>::value, bool >::type
+    send_increment( GlobalAddress<T> target, U inc ) {
+      send_update< T, collective_add, C >( target, inc );
+      return true;
+    }
+    template< GlobalCompletionEvent * C, typename T, typename U >
+    typename std::enable_if< !std::is_arithmetic<T>::value, bool >::type
+    send_increment( GlobalAddress<T> target, U inc ) { return false; }
+
+    template< GlobalCompletionEvent * C, typename T, typename U >
+    typename std::enable_if< std::is_trivially_copyable<T>::value, bool >::type
+    send_write( GlobalAddress<T> target, U value ) {
+      send_update< T, update_assign, C >( target, value );
+      return true;
+    }
+    template< GlobalCompletionEvent * C, typename T, typename U >
+    typename std::enable_if< !std::is_trivially_copyable<T>::value, bool >::type
+    send_write( GlobalAddress<T> target, U value ) { return false; }
+
+  } // namespace impl
+
+  namespace delegate {
+    /// @addtogroup Delegates
+    /// @{
+
+    /// Asynchronously update `*target = Op(*target, value)`, where `Op` is associative and
+    /// commutative (e.g. collective_add, collective_min, collective_bor). If an update with
+    /// the same `Op` to the same address (and enrolled with the same `C`) is still waiting
+    /// to be sent from this core, the value is folded into it instead of adding a message,
+    /// so updates to hot addresses (histogram buckets, degree counts, label minima) cost one
+    /// message per flush rather than one each. Like other async delegates, enrolls with `C`
+    /// (once per message); combined updates may be applied out of order with other
+    /// delegates to `target`.
+    ///
+    /// @b Example:
+    /// @code
+    ///   delegate::combine<int64_t,collective_min>(label, mine);
+    ///   delegate::increment<combining>(count, 1);   // same as combine<T,collective_add>
+    /// @endcode
+    template< typename T, T (*Op)(const T&, const T&), GlobalCompletionEvent * C = &impl::local_gce >
+    void combine( GlobalAddress<T> target, T value ) {
+      combining_updates++;
+      if( target.core() == mycore() ) {
+        impl::CombiningMessage<T,Op>::apply( target.raw_bits(), value );
+        return;
+      }
+      auto set = impl::combining_set( target.core(), target.raw_bits() );
+      int way = -1;
+      for( int w = 0; w < impl::combining_ways; w++ ) {
+        auto s = set[w];
+        if( s && s->target_ == target.raw_bits() && s->op_ == reinterpret_cast<intptr_t>( Op ) && s->gce_ == C ) {
+          if( s->lock() ) {
+            auto m = static_cast< impl::CombiningMessage<T,Op>* >( s );
+            m->value_ = Op( m->value_, value );
+            m->unlock();
+            combining_hits++;
+            return;
+          }
+          way = w;   // already being sent: take its slot
+          break;
+        }
+      }
+      if( C ) C->enroll();
+      combining_messages++;
+      auto m = impl::update_message<T,Op>( target, value, C );
+      if( way < 0 ) {
+        for( int w = impl::combining_ways - 1; w > 0; w-- ) set[w] = set[w-1];
+        way = 0;
+      }
+      set[way] = m;
+      m->enqueue();
+    }
+
+    /// Fraction of combined updates since the start (or the last reset of metrics) that
+    /// were folded into a pending message, over all cores. Call from one task.
+    double combining_hit_rate();
+
+    /// @}
+  } // namespace delegate
+
+} // namespace Grappa
@@ -34,6 +34,8 @@
 
 #include <cassert>
 #include <limits>
+#include <sched.h>
+#include <pthread.h>
 
 #include <gflags/gflags.h>
 
@@ -61,6 +63,9 @@ DEFINE_int64( log2_buffer_size, 19, "Size of Communicator buffers" );
 
 static const int MIN_LOG2_BUFFER_SIZE = 15;
 
+DEFINE_bool( progress_thread, false, "Post and test MPI sends and receives from a dedicated thread per core instead of from the polling worker (needs MPI_THREAD_MULTIPLE; the thread spins, so give it a CPU of its own)" );
+DEFINE_int64( progress_thread_cpu_offset, -1, "If >= 0, pin each core's progress thread to CPU (locale core + offset), e.g. to put it on the core's hyperthread sibling" );
+
 #ifndef COMMUNICATOR_TEST
 // // other metrics
 // GRAPPA_DEFINE_METRIC( SimpleMetric<uint64_t>, communicator_messages, 0);
@@ -107,6 +112,14 @@ Communicator::Communicator( )
   , external_sends()
   , collective_context(NULL)
 
+  , use_progress_thread( false )
+  , progress_thread()
+  , progress_done( false )
+  , progress_queue()
+  , progress_queue_mask(0)
+  , progress_queue_head(0)
+  , progress_queue_tail(0)
+
   , locale_comm()
   , grappa_comm()
     
@@ -131,7 +144,14 @@ void Communicator::init( int * argc_p, char ** argv_p[] ) {
   {
     HeapLeakChecker::Disabler disable_leak_checks_here;
 #endif
-  MPI_CHECK( MPI_Init( argc_p, argv_p ) ); 
+  if( FLAGS_progress_thread ) {
+    int provided = MPI_THREAD_SINGLE;
+    MPI_CHECK( MPI_Init_thread( argc_p, argv_p, MPI_THREAD_MULTIPLE, &provided ) );
+    use_progress_thread = ( provided == MPI_THREAD_MULTIPLE );
+    LOG_IF( WARNING, !use_progress_thread ) << "MPI doesn't provide MPI_THREAD_MULTIPLE; ignoring --progress_thread";
+  } else {
+    MPI_CHECK( MPI_Init( argc_p, argv_p ) ); 
+  }
 #ifdef HEAPCHECK_ENABLE
   }
 #endif
@@ -179,25 +199,22 @@ void Communicator::init( int * argc_p, char ** argv_p[] ) {
 
   
   // verify locale numbering is consistent with locales
-  int32_t localemin = std::numeric_limits<int32_t>::max();
-  int32_t localemax = std::numeric_limits<int32_t>::min();
-  MPI_CHECK( MPI_Reduce( &mylocaleint, &localemin, 1, MPI_INT32_T,
+  // (min and max in one reduction, as min of x and -x)
+  int32_t locale_ids[2] = { mylocaleint, -mylocaleint };
+  int32_t locale_ids_min[2];
+  MPI_CHECK( MPI_Reduce( locale_ids, locale_ids_min, 2, MPI_INT32_T,
                          MPI_MIN, 0, locale_comm ) );
-  MPI_CHECK( MPI_Reduce( &mylocaleint, &localemax, 1, MPI_INT32_T,
-                         MPI_MAX, 0, locale_comm ) );
   if( 0 == locale_mycoreint ) {
-    CHECK_EQ( localemin, localemax ) << "Locale ID is not consistent across locale!";
+    CHECK_EQ( locale_ids_min[0], -locale_ids_min[1] ) << "Locale ID is not consistent across locale!";
   }
 
   // verify locale core count is the same across job
-  int32_t locale_coresmin = std::numeric_limits<int32_t>::max();
-  int32_t locale_coresmax = std::numeric_limits<int32_t>::min();
-  MPI_CHECK( MPI_Reduce( &locale_coresint, &locale_coresmin, 1, MPI_INT32_T,
+  int32_t locale_cores[2] = { locale_coresint, -locale_coresint };
+  int32_t locale_cores_min[2];
+  MPI_CHECK( MPI_Reduce( locale_cores, locale_cores_min, 2, MPI_INT32_T,
                          MPI_MIN, 0, grappa_comm ) );
-  MPI_CHECK( MPI_Reduce( &locale_coresint, &locale_coresmax, 1, MPI_INT32_T,
-                         MPI_MAX, 0, grappa_comm ) );
   if( 0 == grappa_mycoreint ) {
-    CHECK_EQ( locale_coresmin, locale_coresmax ) << "Number of cores per locale is not the same across job!";
+    CHECK_EQ( locale_cores_min[0], -locale_cores_min[1] ) << "Number of cores per locale is not the same across job!";
   }
 
   
@@ -214,9 +231,6 @@ void Communicator::init( int * argc_p, char ** argv_p[] ) {
   MPI_CHECK( MPI_Comm_set_errhandler( locale_comm, MPI_ERRORS_RETURN ) );
   MPI_CHECK( MPI_Comm_set_errhandler( grappa_comm, MPI_ERRORS_RETURN ) );
 
-
-  MPI_CHECK( MPI_Barrier( grappa_comm ) );
-
   // initialize masks
   receive_mask = (1 << FLAGS_log2_concurrent_receives) - 1;
   send_mask = (1 << FLAGS_log2_concurrent_sends) - 1;
@@ -247,6 +261,21 @@ void Communicator::activate() {
     receives[i].size = 1 << FLAGS_log2_buffer_size;
   }
 
+  if( use_progress_thread ) {
+    // room for every context at once, including external sends
+    progress_queue_mask = (4L << std::max( FLAGS_log2_concurrent_sends, FLAGS_log2_concurrent_receives )) - 1;
+    progress_queue.reset( new CommunicatorContext*[ progress_queue_mask + 1 ] );
+    progress_thread = std::thread( [this] { progress_loop(); } );
+    if( FLAGS_progress_thread_cpu_offset >= 0 ) {
+      cpu_set_t cpus;
+      CPU_ZERO( &cpus );
+      CPU_SET( locale_mycore_ + FLAGS_progress_thread_cpu_offset, &cpus );
+      int err = pthread_setaffinity_np( progress_thread.native_handle(), sizeof(cpus), &cpus );
+      LOG_IF( WARNING, err != 0 ) << "Couldn't pin progress thread to CPU "
+                                  << locale_mycore_ + FLAGS_progress_thread_cpu_offset;
+    }
+  }
+
   repost_receive_buffers();
 
   DVLOG(3) << "Entering activation barrier";
@@ -322,7 +351,15 @@ void Communicator::post_send( CommunicatorContext * c,
   DVLOG(6) << "Posting send " << c << " to " << dest
            << " with buf " << c->buf
            << " callback " << (void*)c->callback;
-  MPI_CHECK( MPI_Isend( c->buf, size, MPI_BYTE, dest, tag, grappa_comm, &c->request ) );
+  if( use_progress_thread ) {
+    c->is_receive = false;
+    c->peer = dest;
+    c->tag = tag;
+    c->transferred = size;
+    progress_enqueue( c );
+  } else {
+    MPI_CHECK( MPI_Isend( c->buf, size, MPI_BYTE, dest, tag, grappa_comm, &c->request ) );
+  }
 #ifndef COMMUNICATOR_TEST
   communicator_message_bytes += size;
 #endif
@@ -341,25 +378,103 @@ void Communicator::post_external_send( CommunicatorContext * c,
 }
 
 void Communicator::post_receive( CommunicatorContext * c ) {
-  MPI_CHECK( MPI_Irecv( c->buf, c->size, MPI_BYTE, MPI_ANY_SOURCE, MPI_ANY_TAG, grappa_comm, &c->request ) );
+  if( use_progress_thread ) {
+    c->is_receive = true;
+    progress_enqueue( c );
+  } else {
+    MPI_CHECK( MPI_Irecv( c->buf, c->size, MPI_BYTE, MPI_ANY_SOURCE, MPI_ANY_TAG, grappa_comm, &c->request ) );
+  }
   DVLOG(6) << "Posted receive " << c << " with buf " << c->buf << " callback " << (void*) c->callback;
 }
 
 
 
 
-void Communicator::garbage_collect() {
+/// Start the request for `c` on the progress thread.
+void Communicator::progress_enqueue( CommunicatorContext * c ) {
+  c->complete = 0;
+  // (the ring has room for every context, so this only waits if the thread is behind)
+  while( progress_queue_head - __atomic_load_n( &progress_queue_tail, __ATOMIC_ACQUIRE ) > progress_queue_mask ) {
+    sched_yield();
+  }
+  progress_queue[ progress_queue_head & progress_queue_mask ] = c;
+  __atomic_store_n( &progress_queue_head, progress_queue_head + 1, __ATOMIC_RELEASE );
+}
+
+/// Body of the progress thread: post whatever the core has queued, and test
+/// everything in flight, until finish().
+void Communicator::progress_loop() {
+  std::vector< CommunicatorContext * > active;
+  while( !progress_done ) {
+    bool idle = true;
+    
+    int64_t head = __atomic_load_n( &progress_queue_head, __ATOMIC_ACQUIRE );
+    while( progress_queue_tail != head ) {
+      auto c = progress_queue[ progress_queue_tail & progress_queue_mask ];
+      if( c->is_receive ) {
+        MPI_CHECK( MPI_Irecv( c->buf, c->size, MPI_BYTE, MPI_ANY_SOURCE, MPI_ANY_TAG, grappa_comm, &c->request ) );
+      } else {
+        MPI_CHECK( MPI_Isend( c->buf, c->transferred, MPI_BYTE, c->peer, c->tag, grappa_comm, &c->request ) );
+      }
+      active.push_back( c );
+      __atomic_store_n( &progress_queue_tail, progress_queue_tail + 1, __ATOMIC_RELEASE );
+      idle = false;
+    }
+    
+    for( size_t i = 0; i < active.size(); ) {
+      auto c = active[i];
+      int flag;
+      MPI_Status status;
+      MPI_CHECK( MPI_Test( &c->request, &flag, &status ) );
+      if( flag ) {
+        if( c->is_receive ) {
+          MPI_CHECK( MPI_Get_count( &status, MPI_BYTE, &c->transferred ) );
+          c->peer = status.MPI_SOURCE;
+          c->tag = status.MPI_TAG;
+        }
+        __atomic_store_n( &c->complete, 1, __ATOMIC_RELEASE );
+        active[i] = active.back();
+        active.pop_back();
+        idle = false;
+      } else {
+        i++;
+      }
+    }
+    
+    // give the CPU back if we're sharing it
+    if( idle ) sched_yield();
+  }
+}
+
+bool Communicator::test( CommunicatorContext * c, int * source, int * tag, int * size ) {
+  if( use_progress_thread ) {
+    if( !__atomic_load_n( &c->complete, __ATOMIC_ACQUIRE ) ) return false;
+    *source = c->peer;
+    *tag = c->tag;
+    *size = c->transferred;
+    return true;
+  }
   int flag;
   MPI_Status status;
+  MPI_CHECK( MPI_Test( &c->request, &flag, &status ) );
+  if( flag ) {
+    *source = status.MPI_SOURCE;
+    *tag = status.MPI_TAG;
+    MPI_CHECK( MPI_Get_count( &status, MPI_BYTE, size ) );
+  }
+  return flag;
+}
+
+void Communicator::garbage_collect() {
+  int source, tag, size;
 
   // check for completed sends and re-enable
   while( send_tail != send_head ) {
     auto c = &sends[send_tail];
     if( c->reference_count > 0 ) {
-      MPI_CHECK( MPI_Test( &c->request, &flag, &status ) );
-      if( flag ) {
+      if( test( c, &source, &tag, &size ) ) {
         if( c->callback ) {
-          (c->callback)( c, status.MPI_SOURCE, status.MPI_TAG, c->size );
+          (c->callback)( c, source, tag, c->size );
         }
         c->reference_count = 0;
         send_tail = (send_tail + 1) & send_mask;
@@ -375,11 +490,10 @@ void Communicator::garbage_collect() {
   while( !external_sends.empty() ) {
     auto c = external_sends.front();
     if( c->reference_count > 0 ) {
-      MPI_CHECK( MPI_Test( &c->request, &flag, &status ) );
-      if( flag ) {
+      if( test( c, &source, &tag, &size ) ) {
         c->reference_count = 0;
         if( c->callback ) {
-          (c->callback)( c, status.MPI_SOURCE, status.MPI_TAG, c->size );
+          (c->callback)( c, source, tag, c->size );
         }
         external_sends.pop_front();
       } else { // not sent yet
@@ -425,23 +539,18 @@ static void receive( CommunicatorContext * c, int size ) {
 }
 
 void Communicator::process_received_buffers() {
-  MPI_Status status;
+  int source, tag, size;
 
   while( receive_dispatch != receive_head ) {
-    int flag;
     auto c = &receives[receive_dispatch];
     
-    MPI_CHECK( MPI_Test( &c->request, &flag, &status ) );
-    
     // if message has been received
-    if( flag ) {
-      int size = 0;
-      MPI_CHECK( MPI_Get_count( &status, MPI_BYTE, &size ) );
+    if( test( c, &source, &tag, &size ) ) {
       c->reference_count = 1;
       // start delivering received buffer
       receive( c, size );
       if( c->callback ) {
-        (c->callback)( c, status.MPI_SOURCE, status.MPI_TAG, size );
+        (c->callback)( c, source, tag, size );
       }
       receive_dispatch = (receive_dispatch + 1) & receive_mask;
       // update if anything has finished delivery
@@ -494,6 +603,11 @@ static void finalize_mpi(void)
 /// tear down communication layer.
 void Communicator::finish(int retval) {
   
+  if( progress_thread.joinable() ) {
+    progress_done = true;
+    progress_thread.join();
+  }
+  
   MPI_CHECK( MPI_Barrier( grappa_comm ) );
   
   // get rid of any outstanding sends
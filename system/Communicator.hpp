@@ -66,6 +66,7 @@
 #include <mpi.h>
 #include <memory>
 #include <deque>
+#include <thread>
 
 #ifdef VTRACE
 #include <vt_user.h>
@@ -86,7 +87,16 @@ struct CommunicatorContext {
   int size;
   int reference_count;
   void (*callback)( CommunicatorContext * c, int source, int tag, int received_size );
-  CommunicatorContext(): request(MPI_REQUEST_NULL), buf(NULL), size(0), reference_count(0), callback(NULL) {}
+
+  // used with --progress_thread: what to post, and what completed
+  bool is_receive;
+  int peer;         //< destination of a send; source of a completed receive
+  int tag;
+  int transferred;  //< bytes to send; bytes received
+  int complete;     //< set (with release semantics) by the progress thread
+
+  CommunicatorContext(): request(MPI_REQUEST_NULL), buf(NULL), size(0), reference_count(0), callback(NULL)
+                       , is_receive(false), peer(-1), tag(0), transferred(0), complete(0) {}
 };
 
 namespace Grappa {
@@ -153,6 +163,26 @@ private:
   std::deque<CommunicatorContext*> external_sends;
   CommunicatorContext * collective_context;
   
+  /// With --progress_thread, point-to-point sends and receives are posted and tested
+  /// by a dedicated OS thread, so the core itself never calls into MPI for them (it
+  /// still does for collectives, so MPI must provide MPI_THREAD_MULTIPLE). Contexts
+  /// to post go through a single-producer/single-consumer ring; the thread marks them
+  /// `complete` when their request finishes, and the core runs callbacks and delivers
+  /// messages as usual when it next polls.
+  bool use_progress_thread;
+  std::thread progress_thread;
+  volatile bool progress_done;
+  std::unique_ptr< CommunicatorContext*[] > progress_queue;
+  int64_t progress_queue_mask;
+  int64_t progress_queue_head;   //< next slot the core will fill
+  int64_t progress_queue_tail;   //< next slot the thread will post
+  
+  void progress_loop();
+  void progress_enqueue( CommunicatorContext * c );
+  
+  /// Has the request on `c` finished? If so, fill in what it transferred.
+  bool test( CommunicatorContext * c, int * source, int * tag, int * size );
+  
 public:
   MPI_Comm locale_comm; // locale-local communicator
   MPI_Comm grappa_comm; // grappa-specific communicator
@@ -283,6 +313,11 @@ public:
     MPI_CHECK( MPI_Barrier( grappa_comm ) );
   }
 
+  /// Barrier among the cores of this locale only
+  inline void locale_barrier() {
+    MPI_CHECK( MPI_Barrier( locale_comm ) );
+  }
+
   template< typename T >
   inline void allreduce_inplace(T * p, MPI_Datatype type, MPI_Op op) {
     MPI_CHECK( MPI_Allreduce( MPI_IN_PLACE, p, 1, type, op, grappa_comm ) );
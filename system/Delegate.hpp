@@ -41,6 +41,8 @@
 #include "DelegateBase.hpp"
 #include "GlobalCompletionEvent.hpp"
 #include "AsyncDelegate.hpp"
+#include "DelegateBatch.hpp"
+#include "CombiningDelegate.hpp"
 #include <type_traits>
 
 GRAPPA_DECLARE_METRIC(SummarizingMetric<uint64_t>, flat_combiner_fetch_and_add_amount);
@@ -107,6 +109,14 @@ namespace Grappa {
     
   } // namespace impl
   
+  namespace impl {
+    /// Copy `n` bytes at global address `raw` out of this core's global cache, fetching
+    /// the line that holds them on a miss (defined in GlobalCache.cpp). Returns false,
+    /// without reading anything, if the bytes can't be cached (local, disabled, or
+    /// spanning two lines).
+    bool global_cache_read(intptr_t raw, void * out, size_t n);
+  }
+
   namespace delegate {
     
 #define AUTO_INVOKE(expr) decltype(expr) { return expr; }
@@ -245,6 +255,13 @@ namespace Grappa {
               GlobalCompletionEvent * C = &impl::local_gce,
               typename T = decltype(nullptr) >
     T read(GlobalAddress<T> target) {
+      if (S == SyncMode::Blocking && std::is_trivially_copyable<T>::value
+          && current_worker()->cached_reads) {
+        typename std::aligned_storage<sizeof(T),alignof(T)>::type val;
+        if (impl::global_cache_read(target.raw_bits(), &val, sizeof(T))) {
+          return *reinterpret_cast<T*>(&val);
+        }
+      }
       delegate_reads++;
       return call<S,C>(target.core(), [target]() -> T {
         delegate_read_targets++;
@@ -269,7 +286,19 @@ namespace Grappa {
               typename U = decltype(nullptr) >
     void write(GlobalAddress<T> target, U value) {
       static_assert(std::is_convertible<T,U>(), "type of value must match GlobalAddress type");
+      if (is_async(S) && impl::batchable<T>::value && FLAGS_delegate_coalesce_async
+          && target.core() != mycore()) {
+        T v = value;
+        impl::coalesce_async(target.core(), C, impl::BATCH_WRITE, impl::batch_type_code<T>(), target.raw_bits(), &v);
+        return;
+      }
       delegate_writes++;
+      if (is_async(S) && FLAGS_compact_messages && target.core() != mycore()
+          && impl::send_write<C>(target, value)) {
+        delegate_ops++;
+        delegate_async_ops++;
+        return;
+      }
       // TODO: don't return any val, requires changes to `delegate::call()`.
       return call<S,C>(target.core(), [target, value] {
         delegate_write_targets++;
@@ -442,6 +471,20 @@ namespace Grappa {
     void increment(GlobalAddress<T> target, U inc) {
       static_assert(std::is_convertible<T,U>(), "type of inc must match GlobalAddress type");
       delegate_async_increments++;
+      if (S == SyncMode::Combining) {
+        delegate::combine<T,collective_add,C>(target, inc);
+        return;
+      }
+      if (impl::batch_addable<T>::value && FLAGS_delegate_coalesce_async && target.core() != mycore()) {
+        T v = inc;
+        impl::coalesce_async(target.core(), C, impl::BATCH_INCREMENT, impl::batch_type_code<T>(), target.raw_bits(), &v);
+        return;
+      }
+      if (FLAGS_compact_messages && target.core() != mycore() && impl::send_increment<C>(target, inc)) {
+        delegate_ops++;
+        delegate_async_ops++;
+        return;
+      }
       delegate::call<SyncMode::Async,C>(target.core(), [target,inc]{
         (*target.pointer()) += inc;
       });
@@ -0,0 +1,259 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+#include "DelegateBatch.hpp"
+#include "Delegate.hpp"
+#include "Message.hpp"
+#include "LocaleSharedMemory.hpp"
+#include "tasks/TaskingScheduler.hpp"
+
+DEFINE_bool(delegate_coalesce_async, false, "Send async delegate writes and increments to each core in batches, flushed when full or when this core is idle (they may then be applied out of order with other delegates)");
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_batch_messages, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_batch_ops, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, delegate_coalesced_ops, 0);
+
+namespace Grappa {
+namespace impl {
+
+size_t BatchEncoder::append( uint8_t op, uint8_t code, intptr_t raw, const void * value ) {
+  if( full() ) {
+    uint32_t at = ops_.size();
+    chunks_.push_back( Chunk{ at, at, static_cast<uint32_t>( result_bytes() ), 0 } );
+    last_ = 0;
+  }
+  auto& c = chunks_.back();
+  size_t size = size_t(1) << (code & 3);
+
+  ops_.push_back( static_cast<char>( (op << 4) | code ) );
+  int64_t delta = raw - last_;
+  uint64_t z = (static_cast<uint64_t>( delta ) << 1) ^ static_cast<uint64_t>( delta >> 63 );
+  while( z >= 0x80 ) {
+    ops_.push_back( static_cast<char>( z | 0x80 ) );
+    z >>= 7;
+  }
+  ops_.push_back( static_cast<char>( z ) );
+  last_ = raw;
+  if( op != BATCH_READ ) {
+    auto v = static_cast<const char*>( value );
+    ops_.insert( ops_.end(), v, v + size );
+  }
+  c.end = ops_.size();
+
+  size_t offset = c.result_offset + c.result_bytes;
+  if( op == BATCH_READ || op == BATCH_FETCH_ADD ) c.result_bytes += size;
+  nops_++;
+  return offset;
+}
+
+template< typename V >
+static inline void apply_op( uint8_t op, void * p, const char * value, char *& out ) {
+  V * x = static_cast<V*>( p );
+  V v;
+  switch( op ) {
+  case BATCH_READ:
+    memcpy( out, x, sizeof(V) );
+    out += sizeof(V);
+    break;
+  case BATCH_WRITE:
+    memcpy( x, value, sizeof(V) );
+    break;
+  case BATCH_INCREMENT:
+    memcpy( &v, value, sizeof(V) );
+    *x += v;
+    break;
+  case BATCH_FETCH_ADD:
+    memcpy( out, x, sizeof(V) );
+    out += sizeof(V);
+    memcpy( &v, value, sizeof(V) );
+    *x += v;
+    break;
+  default:
+    LOG(FATAL) << "bad batched delegate op " << int(op);
+  }
+}
+
+void apply_batch( const char * ops, size_t n, char * results ) {
+  const char * end = ops + n;
+  intptr_t raw = 0;
+  size_t count = 0;
+  while( ops < end ) {
+    uint8_t header = *ops++;
+    uint8_t op = header >> 4, code = header & 7;
+    uint64_t z = 0;
+    for( int shift = 0; ; shift += 7 ) {
+      uint8_t b = *ops++;
+      z |= static_cast<uint64_t>( b & 0x7f ) << shift;
+      if( !(b & 0x80) ) break;
+    }
+    raw += static_cast<int64_t>( (z >> 1) ^ -(z & 1) );
+    void * p = GlobalAddress<char>::Raw( raw ).pointer();
+    switch( code ) {
+    case 0: apply_op< uint8_t >( op, p, ops, results ); break;
+    case 1: apply_op< uint16_t >( op, p, ops, results ); break;
+    case 2: apply_op< uint32_t >( op, p, ops, results ); break;
+    case 3: apply_op< uint64_t >( op, p, ops, results ); break;
+    case 6: apply_op< float >( op, p, ops, results ); break;
+    case 7: apply_op< double >( op, p, ops, results ); break;
+    default: LOG(FATAL) << "bad batched delegate type " << int(code);
+    }
+    if( op != BATCH_READ ) ops += size_t(1) << (code & 3);
+    count++;
+  }
+  delegate_batch_ops += count;
+  delegate_targets += count;
+}
+
+void send_batch_async( Core dest, const char * ops, size_t n, GlobalCompletionEvent * gce ) {
+  Core origin = mycore();
+  delegate_batch_messages++;
+  if( dest == origin ) {
+    delegate_short_circuits++;
+    apply_batch( ops, n, NULL );
+    return;
+  }
+  if( gce ) gce->enroll();
+  auto payload = locale_alloc<char>( n );
+  memcpy( payload, ops, n );
+  auto m = heap_message( dest, [origin, gce]( void * payload, size_t size ) {
+    apply_batch( static_cast<const char*>( payload ), size, NULL );
+    if( gce ) gce->send_completion( origin );
+  }, payload, n );
+  m->delete_payload_after_send();
+  m->enqueue();
+}
+
+/// This core's pending coalesced operations for each other core.
+struct Coalescer {
+  BatchEncoder enc;
+  GlobalCompletionEvent * gce;
+};
+static std::vector<Coalescer> coalescers;
+static size_t coalescers_pending = 0;
+
+static void flush( Core dest ) {
+  auto& c = coalescers[dest];
+  auto& chunk = c.enc.chunks().front();
+  send_batch_async( dest, c.enc.ops( chunk ), chunk.end - chunk.begin, c.gce );
+  // the message has its own enrollment; drop the one that held the GCE open while pending
+  if( c.gce ) c.gce->complete();
+  c.enc.clear();
+  coalescers_pending--;
+}
+
+void coalesce_async( Core dest, GlobalCompletionEvent * gce, uint8_t op, uint8_t code,
+                     intptr_t raw, const void * value ) {
+  if( coalescers.empty() ) coalescers.resize( cores() );
+  auto& c = coalescers[dest];
+  if( !c.enc.empty() && (c.gce != gce || c.enc.full()) ) flush( dest );
+  if( c.enc.empty() ) {
+    c.gce = gce;
+    if( gce ) gce->enroll();
+    coalescers_pending++;
+  }
+  c.enc.append( op, code, raw, value );
+  delegate_coalesced_ops++;
+}
+
+void idle_flush_delegate_batches() {
+  if( coalescers_pending == 0 ) return;
+  auto prev = global_scheduler.in_no_switch_region();
+  global_scheduler.set_no_switch_region( true );
+  for( Core dest = 0; dest < static_cast<Core>( coalescers.size() ); dest++ ) {
+    if( !coalescers[dest].enc.empty() ) flush( dest );
+  }
+  global_scheduler.set_no_switch_region( prev );
+}
+
+} // namespace impl
+
+namespace delegate {
+
+void Batch::run() {
+  results_.assign( enc_.result_bytes(), 0 );
+  delegate_ops += enc_.size();
+  if( dest_ == mycore() ) {
+    delegate_short_circuits++;
+    for( auto& c : enc_.chunks() ) {
+      impl::apply_batch( enc_.ops( c ), c.end - c.begin, results_.data() + c.result_offset );
+    }
+    enc_.clear();
+    return;
+  }
+  auto reply_address = make_global( this );
+  auto& chunks = enc_.chunks();
+  pending_ = chunks.size();
+  for( uint32_t b = 0; b < chunks.size(); b++ ) {
+    auto& c = chunks[b];
+    uint32_t result_bytes = c.result_bytes;
+    size_t n = c.end - c.begin;
+    auto payload = locale_alloc<char>( n );
+    memcpy( payload, enc_.ops( c ), n );
+    delegate_batch_messages++;
+    auto m = heap_message( dest_, [reply_address, b, result_bytes]( void * payload, size_t size ) {
+      if( result_bytes == 0 ) {
+        impl::apply_batch( static_cast<const char*>( payload ), size, NULL );
+        send_heap_message( reply_address.core(), [reply_address, b] {
+          reply_address.pointer()->reply( b, NULL, 0 );
+        });
+        return;
+      }
+      auto results = locale_alloc<char>( result_bytes );
+      impl::apply_batch( static_cast<const char*>( payload ), size, results );
+      auto r = heap_message( reply_address.core(), [reply_address, b]( void * payload, size_t size ) {
+        reply_address.pointer()->reply( b, static_cast<const char*>( payload ), size );
+      }, results, result_bytes );
+      r->delete_payload_after_send();
+      r->enqueue();
+    }, payload, n );
+    m->delete_payload_after_send();
+    m->enqueue();
+  }
+  while( pending_ > 0 ) {
+    thread_ = current_worker();
+    suspend();
+    thread_ = NULL;
+  }
+  enc_.clear();
+}
+
+void Batch::reply( uint32_t chunk, const char * results, size_t n ) {
+  auto& c = enc_.chunks()[chunk];
+  DCHECK_EQ( n, c.result_bytes );
+  if( n > 0 ) memcpy( &results_[ c.result_offset ], results, n );
+  if( --pending_ == 0 && thread_ ) wake( thread_ );
+}
+
+} // namespace delegate
+} // namespace Grappa
@@ -0,0 +1,244 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Addressing.hpp"
+#include "Communicator.hpp"
+#include "GlobalCompletionEvent.hpp"
+#include "Metrics.hpp"
+#include <type_traits>
+#include <vector>
+#include <cstring>
+
+/// Send async delegate writes and increments to other cores in batches (see delegate::Batch).
+DECLARE_bool(delegate_coalesce_async);
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_batch_messages);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_batch_ops);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, delegate_coalesced_ops);
+
+namespace Grappa {
+
+  class Worker;
+
+  namespace impl {
+
+    /// Batched delegate operations. Each is encoded as one opcode byte (operation in the
+    /// high nibble; in the low bits, whether the value is floating point and log2 of its
+    /// size), the zigzag varint distance from the previous operation's global address (the
+    /// first in a message is relative to 0), and the operand for everything but reads.
+    /// Reads and fetch-adds append their values to the reply in order.
+    enum BatchOp { BATCH_READ = 0, BATCH_WRITE = 1, BATCH_INCREMENT = 2, BATCH_FETCH_ADD = 3 };
+
+    /// Most bytes of operations, or of results, carried by one batch message.
+    const size_t batch_message_bytes = 2048;
+    /// Most bytes one encoded operation can take.
+    const size_t batch_max_op_bytes = 1 + 10 + 8;
+
+    /// Values that can be read or written by a batch.
+    template< typename T >
+    struct batchable : std::integral_constant< bool, std::is_trivially_copyable<T>::value
+      && (sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8) > {};
+
+    /// Values that can also be added to.
+    template< typename T >
+    struct batch_addable : std::integral_constant< bool, std::is_arithmetic<T>::value && batchable<T>::value > {};
+
+    template< typename T >
+    uint8_t batch_type_code() {
+      return (std::is_floating_point<T>::value ? 4 : 0)
+           | (sizeof(T) == 1 ? 0 : sizeof(T) == 2 ? 1 : sizeof(T) == 4 ? 2 : 3);
+    }
+
+    /// Operations for one core, split into runs that each fit in one message.
+    class BatchEncoder {
+    public:
+      struct Chunk {
+        uint32_t begin, end;            ///< bytes of `ops`
+        uint32_t result_offset, result_bytes;
+      };
+
+      BatchEncoder(): last_(0), nops_(0) {}
+
+      /// Append an operation; returns the offset of its result (if any) among all results.
+      size_t append( uint8_t op, uint8_t code, intptr_t raw, const void * value );
+
+      /// True if the next operation would start a new message.
+      bool full() const {
+        return chunks_.empty()
+          || chunks_.back().end - chunks_.back().begin + batch_max_op_bytes > batch_message_bytes
+          || chunks_.back().result_bytes + 8 > batch_message_bytes;
+      }
+
+      bool empty() const { return nops_ == 0; }
+      size_t size() const { return nops_; }
+      size_t result_bytes() const { return chunks_.empty() ? 0 : chunks_.back().result_offset + chunks_.back().result_bytes; }
+      const std::vector<Chunk>& chunks() const { return chunks_; }
+      const char * ops( const Chunk& c ) const { return &ops_[c.begin]; }
+
+      void clear() { ops_.clear(); chunks_.clear(); last_ = 0; nops_ = 0; }
+
+    private:
+      std::vector<char> ops_;
+      std::vector<Chunk> chunks_;
+      intptr_t last_;
+      size_t nops_;
+    };
+
+    /// Apply `n` bytes of encoded operations on this core, writing results to `results`.
+    void apply_batch( const char * ops, size_t n, char * results );
+
+    /// Send one chunk of operations to `dest`, to be applied there with no results; the
+    /// destination sends one completion to `gce` (if not NULL) when done.
+    void send_batch_async( Core dest, const char * ops, size_t n, GlobalCompletionEvent * gce );
+
+    /// Add an async operation to this core's pending batch for `dest`, sending the batch
+    /// when it is full (defined in DelegateBatch.cpp).
+    void coalesce_async( Core dest, GlobalCompletionEvent * gce, uint8_t op, uint8_t code,
+                         intptr_t raw, const void * value );
+
+    /// Send every pending coalesced batch; called by the scheduler when the core is idle.
+    void idle_flush_delegate_batches();
+
+  } // namespace impl
+
+  namespace delegate {
+    /// @addtogroup Delegates
+    /// @{
+
+    /// Where a value returned by a Batch operation will be, once the batch has run.
+    template< typename T >
+    struct BatchResult {
+      size_t offset;
+    };
+
+    /// Many small delegate operations on one core, sent as one message (or as few as fit
+    /// them) and applied there by a single handler, instead of one message per operation.
+    /// Operations are applied in the order they were added; read and fetch_and_add
+    /// return handles to look their values up with once the batch has run.
+    ///
+    /// @b Example:
+    /// @code
+    ///   auto b = delegate::batch(dest);
+    ///   auto old = b.fetch_and_add(counts+i, 1);
+    ///   b.write(flags+i, true);
+    ///   auto x = b.read(xs+j);
+    ///   b.run();                      // one round trip
+    ///   use(b[old], b[x]);
+    /// @endcode
+    ///
+    /// Values must be 1, 2, 4 or 8 bytes and trivially copyable (and arithmetic, for the
+    /// additions). All addresses must be on the batch's core.
+    class Batch {
+    public:
+      explicit Batch( Core dest ): dest_( dest ), pending_( 0 ), thread_( NULL ) {}
+      Batch( const Batch& ) = delete;
+      Batch( Batch&& b ): dest_( b.dest_ ), enc_( std::move( b.enc_ ) ), results_( std::move( b.results_ ) )
+                        , pending_( 0 ), thread_( NULL ) {}
+
+      template< typename T >
+      BatchResult<T> read( GlobalAddress<T> target ) {
+        static_assert( impl::batchable<T>::value, "batched values must be trivially copyable and 1, 2, 4 or 8 bytes" );
+        return BatchResult<T>{ add( impl::BATCH_READ, impl::batch_type_code<T>(), target.raw_bits(), NULL ) };
+      }
+
+      template< typename T, typename U >
+      void write( GlobalAddress<T> target, U value ) {
+        static_assert( impl::batchable<T>::value, "batched values must be trivially copyable and 1, 2, 4 or 8 bytes" );
+        T v = value;
+        add( impl::BATCH_WRITE, impl::batch_type_code<T>(), target.raw_bits(), &v );
+      }
+
+      template< typename T, typename U >
+      void increment( GlobalAddress<T> target, U inc ) {
+        static_assert( impl::batch_addable<T>::value, "batched additions must be on arithmetic values of 1, 2, 4 or 8 bytes" );
+        T v = inc;
+        add( impl::BATCH_INCREMENT, impl::batch_type_code<T>(), target.raw_bits(), &v );
+      }
+
+      template< typename T, typename U >
+      BatchResult<T> fetch_and_add( GlobalAddress<T> target, U inc ) {
+        static_assert( impl::batch_addable<T>::value, "batched additions must be on arithmetic values of 1, 2, 4 or 8 bytes" );
+        T v = inc;
+        return BatchResult<T>{ add( impl::BATCH_FETCH_ADD, impl::batch_type_code<T>(), target.raw_bits(), &v ) };
+      }
+
+      /// Apply the operations and block until their results are back; then clears the
+      /// operations (results stay readable until more are added).
+      void run();
+
+      /// Send the operations without waiting; the batch may have no reads or fetch-adds.
+      /// Each message enrolls with `C` and sends it one completion when applied.
+      template< GlobalCompletionEvent * C = &impl::local_gce >
+      void run_async() {
+        CHECK_EQ( enc_.result_bytes(), 0 ) << "async batches can't return values";
+        for( auto& c : enc_.chunks() ) {
+          impl::send_batch_async( dest_, enc_.ops( c ), c.end - c.begin, C );
+        }
+        enc_.clear();
+      }
+
+      /// Value of an operation after run().
+      template< typename T >
+      T operator[]( BatchResult<T> r ) const {
+        T v;
+        memcpy( &v, &results_[ r.offset ], sizeof(T) );
+        return v;
+      }
+
+      Core destination() const { return dest_; }
+      size_t size() const { return enc_.size(); }
+
+      /// Called by the reply to message `chunk`.
+      void reply( uint32_t chunk, const char * results, size_t n );
+
+    private:
+      size_t add( uint8_t op, uint8_t code, intptr_t raw, const void * value ) {
+        DCHECK_EQ( GlobalAddress<char>::Raw( raw ).core(), dest_ ) << "batched operation on another core";
+        return enc_.append( op, code, raw, value );
+      }
+
+      Core dest_;
+      impl::BatchEncoder enc_;
+      std::vector<char> results_;
+      size_t pending_;
+      Worker * thread_;
+    };
+
+    /// Start a Batch of operations on core `dest`.
+    inline Batch batch( Core dest ) { return Batch( dest ); }
+
+    /// @}
+  } // namespace delegate
+} // namespace Grappa
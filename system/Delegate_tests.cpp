@@ -39,6 +39,7 @@
 #include "Grappa.hpp"
 #include "Delegate.hpp"
 #include "GlobalAllocator.hpp"
+#include "RDMAAggregator.hpp"
 
 using namespace Grappa;
 
@@ -50,6 +51,8 @@ double some_double = 123.0;
 
 int64_t other_data __attribute__ ((aligned (2048))) = 0;
 
+GlobalCompletionEvent gce_a, gce_b;
+
 BOOST_AUTO_TEST_CASE( test1 ) {
   Grappa::init( GRAPPA_TEST_ARGS );
   Grappa::run([]{
@@ -98,6 +101,160 @@ BOOST_AUTO_TEST_CASE( test1 ) {
     // initialize
     auto i64_per_block = block_size / sizeof(int64_t);
     
+    // batch: many operations on core 1 in as few messages as fit them
+    {
+      static int64_t counts[64];
+      static double weights[64];
+      static int32_t twos[64];
+      auto messages = delegate_batch_messages.value();
+      auto b = delegate::batch(1);
+      std::vector< delegate::BatchResult<int64_t> > olds;
+      for (int i = 0; i < 64; i++) {
+        olds.push_back( b.fetch_and_add(make_global(&counts[i],1), i) );
+        b.write(make_global(&weights[i],1), 0.5*i);
+        b.increment(make_global(&twos[i],1), 2);
+      }
+      auto c5 = b.read(make_global(&counts[5],1));
+      size_t nops = b.size();
+      b.run();
+      messages = delegate_batch_messages.value() - messages;
+      BOOST_MESSAGE( nops << " batched ops in " << messages << " messages" );
+      BOOST_CHECK( messages < nops / 20 );
+      for (int i = 0; i < 64; i++) BOOST_CHECK_EQUAL( b[olds[i]], 0 );
+      BOOST_CHECK_EQUAL( b[c5], 5 );
+      delegate::call(1, []{
+        for (int i = 0; i < 64; i++) {
+          BOOST_CHECK_EQUAL( counts[i], i );
+          BOOST_CHECK_EQUAL( weights[i], 0.5*i );
+          BOOST_CHECK_EQUAL( twos[i], 2 );
+        }
+      });
+    }
+
+    // coalesced async increments
+    {
+      static int64_t hits[64];
+      call_on_all_cores([]{ FLAGS_delegate_coalesce_async = true; });
+      auto ops = delegate_coalesced_ops.value();
+      auto messages = delegate_batch_messages.value();
+      for (int i = 0; i < 1000; i++) {
+        delegate::increment<async>(make_global(&hits[i % 64],1), 1);
+      }
+      impl::local_gce.wait();
+      ops = delegate_coalesced_ops.value() - ops;
+      messages = delegate_batch_messages.value() - messages;
+      BOOST_MESSAGE( ops << " coalesced increments in " << messages << " messages" );
+      BOOST_CHECK_EQUAL( ops, 1000 );
+      BOOST_CHECK( messages < ops / 20 );
+      int64_t total = delegate::call(1, []{
+        int64_t t = 0;
+        for (int i = 0; i < 64; i++) t += hits[i];
+        return t;
+      });
+      BOOST_CHECK_EQUAL( total, 1000 );
+      call_on_all_cores([]{ FLAGS_delegate_coalesce_async = false; });
+    }
+
+    // combining updates to a few hot addresses
+    {
+      static int64_t sums[8];
+      static int64_t lows[8];
+      static uint64_t bits[8];
+      delegate::call(1, []{ for (int i = 0; i < 8; i++) lows[i] = 1<<30; });
+      auto messages = combining_messages.value();
+      forall_here(0, 1000, [](int64_t i){
+        delegate::increment<combining>(make_global(&sums[i % 8],1), 1);
+        delegate::combine<int64_t,collective_min>(make_global(&lows[i % 8],1), 1000-i);
+        delegate::combine<uint64_t,collective_bor>(make_global(&bits[i % 8],1), uint64_t(1) << (i % 64));
+      });
+      impl::local_gce.wait();
+      messages = combining_messages.value() - messages;
+      BOOST_MESSAGE( "3000 combining updates in " << messages << " messages" );
+      BOOST_CHECK( messages < 1500 );
+      BOOST_CHECK( combining_hits.value() > 0 );
+      delegate::call(1, []{
+        for (int i = 0; i < 8; i++) {
+          BOOST_CHECK_EQUAL( sums[i], 125 );
+          BOOST_CHECK_EQUAL( lows[i], 1000 - (992 + i) );
+        }
+        uint64_t all = 0;
+        for (int i = 0; i < 8; i++) all |= bits[i];
+        BOOST_CHECK_EQUAL( all, ~uint64_t(0) );
+      });
+    }
+
+    // `combining` acts as `async` outside delegate::increment and delegate::combine
+    {
+      static int64_t w;
+      delegate::write<combining>(make_global(&w,1), 7);
+      impl::local_gce.wait();
+      BOOST_CHECK_EQUAL( delegate::read(make_global(&w,1)), 7 );
+      
+      static int64_t iters;
+      int64_t pad[2] = { 1, 2 };   // bigger than 8 bytes: the heap-allocated async body
+      forall_here<combining>(0, 10, [pad](int64_t i){ iters += pad[0]; });
+      impl::local_gce.wait();
+      BOOST_CHECK_EQUAL( iters, 10 );
+    }
+
+    // updates to one hot address under two completion events are only folded into a
+    // message enrolled with their own
+    {
+      static int64_t hot;
+      // hold both open first, so enrolling the updates doesn't suspend
+      gce_a.enroll();
+      gce_b.enroll();
+      auto hits = combining_hits.value();
+      delegate::combine<int64_t,collective_add,&gce_a>(make_global(&hot,1), 1);
+      delegate::combine<int64_t,collective_add,&gce_b>(make_global(&hot,1), 10);
+      BOOST_CHECK_EQUAL( combining_hits.value(), hits );
+      BOOST_CHECK_EQUAL( gce_a.incomplete(), 2 );
+      BOOST_CHECK_EQUAL( gce_b.incomplete(), 2 );
+      delegate::combine<int64_t,collective_add,&gce_a>(make_global(&hot,1), 100);
+      delegate::combine<int64_t,collective_add,&gce_b>(make_global(&hot,1), 1000);
+      BOOST_CHECK_EQUAL( combining_hits.value(), hits + 2 );
+      gce_a.complete();
+      gce_b.complete();
+      gce_b.wait();
+      gce_a.wait();
+      BOOST_CHECK_EQUAL( delegate::read(make_global(&hot,1)), 1111 );
+    }
+
+    // update messages serialized here and deaggregated on core 1, to a 2D and a linear
+    // target, with full and compact headers (each flag value is set only around its own
+    // serialize or deaggregate, so nothing else in flight sees it)
+    {
+      static int64_t counter;
+      auto linear = global_alloc<int64_t>( cores() * block_size / sizeof(int64_t) );
+      auto remote = linear;
+      while( remote.core() != 1 ) ++remote;
+      delegate::write( remote, 0 );
+      delegate::call(1, []{ counter = 0; });
+      for( int compact = 0; compact < 2; compact++ ) {
+        for( auto target : { make_global( &counter, 1 ), remote } ) {
+          struct { char bytes[128]; } buf;
+          impl::MessageBase * first = impl::update_message< int64_t, collective_add >( target, 5, nullptr );
+          first->source_ = mycore();
+          first->is_enqueued_ = true;
+          bool flag = FLAGS_compact_messages;
+          FLAGS_compact_messages = compact;
+          size_t size = impl::global_rdma_aggregator.aggregate_to_buffer( buf.bytes, &first, sizeof(buf) ) - buf.bytes;
+          FLAGS_compact_messages = flag;
+          BOOST_CHECK( size > 0 );
+          delegate::call(1, [buf,size,compact]{
+            auto copy = buf;
+            bool flag = FLAGS_compact_messages;
+            FLAGS_compact_messages = compact;
+            impl::global_rdma_aggregator.deaggregate_buffer( copy.bytes, size );
+            FLAGS_compact_messages = flag;
+          });
+        }
+      }
+      BOOST_CHECK_EQUAL( delegate::call(1, []{ return counter; }), 10 );
+      BOOST_CHECK_EQUAL( delegate::read( remote ), 10 );
+      global_free( linear );
+    }
+
     call_on_all_cores([]{ other_data = mycore(); });
     
     int * foop = new int;
@@ -0,0 +1,232 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+#include "GlobalCache.hpp"
+#include "Cache.hpp"
+#include "Collective.hpp"
+#include "ConditionVariableLocal.hpp"
+#include <unordered_map>
+#include <list>
+#include <vector>
+#include <cstring>
+
+DEFINE_int64(global_cache_bytes, 1<<22, "Bytes of remote global memory each core may cache for cached_read (0 disables caching)");
+DEFINE_int64(global_cache_line_bytes, 256, "Bytes fetched into the global cache per miss (a power of two, 8 to 4096)");
+DEFINE_string(global_cache_eviction, "clock", "Replacement policy for the global cache: clock or lru");
+DEFINE_string(global_cache_writes, "through", "cached_write updates (through) or drops (invalidate) this core's cached copy");
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, global_cache_hits, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, global_cache_misses, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, global_cache_evictions, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, global_cache_bytes_saved, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<uint64_t>, global_cache_bytes_fetched, 0);
+
+namespace Grappa {
+namespace impl {
+
+/// One core's cache: fixed slots of line_bytes each, found by the global address
+/// of their first byte. Lines from a past epoch stay in the index until they are
+/// refetched or replaced.
+class GlobalCache {
+  static const uint64_t STALE = 0;
+
+  struct Line {
+    intptr_t tag;               // raw global address of the line, or -1 if empty
+    uint64_t epoch;             // epoch the data was fetched in (STALE if dropped)
+    bool pending;               // fetch in flight; never replaced while set
+    bool referenced;            // for CLOCK
+    std::list<size_t>::iterator lru;
+    ConditionVariable fetched;
+  };
+
+  size_t line_bytes;
+  std::vector<Line> lines;
+  std::vector<char> data;
+  std::unordered_map<intptr_t,size_t> index;
+  std::list<size_t> lru_order;  // most recently used first
+  bool use_lru;
+  size_t hand;
+  uint64_t epoch_;
+
+  void init() {
+    line_bytes = FLAGS_global_cache_line_bytes;
+    CHECK(line_bytes >= 8 && line_bytes <= 4096 && (line_bytes & (line_bytes-1)) == 0)
+      << "--global_cache_line_bytes must be a power of two between 8 and 4096";
+    CHECK(FLAGS_global_cache_eviction == "clock" || FLAGS_global_cache_eviction == "lru")
+      << "unknown --global_cache_eviction " << FLAGS_global_cache_eviction;
+    use_lru = (FLAGS_global_cache_eviction == "lru");
+    size_t n = FLAGS_global_cache_bytes / line_bytes;
+    lines.resize(n);
+    data.resize(n * line_bytes);
+    for (size_t i = 0; i < n; i++) {
+      lines[i].tag = -1;
+      lines[i].epoch = STALE;
+      lines[i].pending = false;
+      lines[i].referenced = false;
+      lines[i].lru = lru_order.insert(lru_order.end(), i);
+    }
+  }
+
+  void touch(size_t i) {
+    if (use_lru) lru_order.splice(lru_order.begin(), lru_order, lines[i].lru);
+    else lines[i].referenced = true;
+  }
+
+  /// Pick a slot to replace; false if every slot has a fetch in flight.
+  bool victim(size_t * v) {
+    if (use_lru) {
+      for (auto it = lru_order.rbegin(); it != lru_order.rend(); ++it) {
+        if (!lines[*it].pending) { *v = *it; return true; }
+      }
+      return false;
+    }
+    for (size_t k = 0; k < 2 * lines.size(); k++) {
+      size_t i = hand;
+      hand = (hand + 1) % lines.size();
+      Line& l = lines[i];
+      if (l.pending) continue;
+      if (l.referenced && l.epoch == epoch_) { l.referenced = false; continue; }
+      *v = i;
+      return true;
+    }
+    return false;
+  }
+
+  /// Fill slot `i` with the line at `tag`; suspends the calling task.
+  void fetch(size_t i, intptr_t tag) {
+    Line& l = lines[i];
+    l.tag = tag;
+    l.epoch = epoch_;
+    l.pending = true;
+    global_cache_misses++;
+    global_cache_bytes_fetched += line_bytes;
+    {
+      Incoherent<char>::RO c(GlobalAddress<char>::Raw(tag), line_bytes, &data[i * line_bytes]);
+      c.block_until_acquired();
+    }
+    l.pending = false;
+    touch(i);
+    broadcast(&l.fetched);
+  }
+
+public:
+  GlobalCache(): line_bytes(0), use_lru(false), hand(0), epoch_(1) {}
+
+  bool read(intptr_t raw, void * out, size_t n) {
+    if (line_bytes == 0) init();
+    if (lines.empty()) return false;
+    if (GlobalAddress<char>::Raw(raw).core() == mycore()) return false;
+    intptr_t tag = raw & ~static_cast<intptr_t>(line_bytes - 1);
+    size_t offset = raw - tag;
+    if (offset + n > line_bytes) return false;
+
+    while (true) {
+      auto it = index.find(tag);
+      size_t i;
+      if (it != index.end()) {
+        i = it->second;
+        Line& l = lines[i];
+        if (l.pending) {
+          wait(&l.fetched);
+          continue;         // may have been replaced meanwhile; look again
+        }
+        if (l.epoch == epoch_) {
+          touch(i);
+          memcpy(out, &data[i * line_bytes + offset], n);
+          global_cache_hits++;
+          global_cache_bytes_saved += n;
+          return true;
+        }
+      } else {
+        if (!victim(&i)) return false;
+        if (lines[i].tag != -1) {
+          index.erase(lines[i].tag);
+          global_cache_evictions++;
+        }
+        index[tag] = i;
+      }
+      fetch(i, tag);
+      memcpy(out, &data[i * line_bytes + offset], n);
+      return true;
+    }
+  }
+
+  void wrote(intptr_t raw, const void * in, size_t n) {
+    if (lines.empty()) return;
+    intptr_t tag = raw & ~static_cast<intptr_t>(line_bytes - 1);
+    size_t offset = raw - tag;
+    auto it = index.find(tag);
+    if (it == index.end()) return;
+    Line& l = lines[it->second];
+    if (!l.pending && l.epoch == epoch_ && FLAGS_global_cache_writes == "through"
+        && offset + n <= line_bytes) {
+      memcpy(&data[it->second * line_bytes + offset], in, n);
+    } else {
+      // a fetch in flight may have read the old value; refetch next time
+      l.epoch = STALE;
+    }
+  }
+
+  void new_epoch() { epoch_++; }
+};
+
+static GlobalCache global_cache;
+
+bool global_cache_read(intptr_t raw, void * out, size_t n) {
+  return global_cache.read(raw, out, n);
+}
+
+void global_cache_wrote(intptr_t raw, const void * in, size_t n) {
+  global_cache.wrote(raw, in, n);
+}
+
+} // namespace impl
+
+void cache_epoch() {
+  on_all_cores([]{ impl::global_cache.new_epoch(); });
+}
+
+static uint64_t hits_here, misses_here;
+
+double global_cache_hit_rate() {
+  on_all_cores([]{
+    hits_here = global_cache_hits.value();
+    misses_here = global_cache_misses.value();
+  });
+  uint64_t hits = reduce<uint64_t,collective_add>(&hits_here);
+  uint64_t misses = reduce<uint64_t,collective_add>(&misses_here);
+  return (hits + misses) ? double(hits) / (hits + misses) : 0.0;
+}
+
+} // namespace Grappa
@@ -0,0 +1,183 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Addressing.hpp"
+#include "Delegate.hpp"
+#include "ParallelLoop.hpp"
+#include "Metrics.hpp"
+#include <type_traits>
+
+/// Bytes of remote global memory each core may cache for cached_read (0 disables caching).
+DECLARE_int64(global_cache_bytes);
+/// Bytes fetched into the cache per miss: a power of two between 8 and 4096.
+DECLARE_int64(global_cache_line_bytes);
+/// Replacement policy for full caches: "clock" or "lru".
+DECLARE_string(global_cache_eviction);
+/// What cached_write does to this core's cached copy: "through" updates it, "invalidate" drops it.
+DECLARE_string(global_cache_writes);
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, global_cache_hits);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, global_cache_misses);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, global_cache_evictions);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, global_cache_bytes_saved);
+GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, global_cache_bytes_fetched);
+
+namespace Grappa {
+/// @addtogroup Delegates
+/// @{
+
+/// Per-core cache of remote global memory for read-mostly data.
+///
+/// Each core keeps up to `--global_cache_bytes` of remote memory in lines of
+/// `--global_cache_line_bytes`, fetched with Incoherent<T>::RO on a miss and
+/// replaced by CLOCK or LRU. Nothing keeps the copies coherent: a cached value
+/// stays valid until the next cache_epoch(), which every core should reach at
+/// the boundary between phases that write and phases that only read. Writes by
+/// this core through cached_write() update (or drop) its own copy; writes by
+/// anyone else become visible after the next epoch.
+///
+/// Reads go through the cache either explicitly with cached_read(), or for every
+/// blocking delegate::read made from the body of a `forall<ReadMode::Cached>` loop.
+/// Addresses local to the reading core are never cached.
+///
+/// @code
+///   // vertex metadata doesn't change while edges are traversed
+///   Grappa::cache_epoch();
+///   forall<ReadMode::Cached>(edges, nedges, [=](Edge& e){
+///     auto d = delegate::read(degrees+e.dst);   // served from this core's cache after the first miss
+///     ...
+///   });
+/// @endcode
+enum class ReadMode { Direct, Cached };
+
+/// Invalidate every core's cache. Call from one task between phases (blocks until all cores are done).
+void cache_epoch();
+
+/// Fraction of cached reads since the start (or the last reset of metrics) that hit, over all cores.
+/// Call from one task.
+double global_cache_hit_rate();
+
+namespace impl {
+  /// Update or drop this core's cached copy of `n` bytes at `raw` (per `--global_cache_writes`).
+  void global_cache_wrote(intptr_t raw, const void * in, size_t n);
+
+  /// While alive, blocking delegate reads made by the current task go through the global cache.
+  class CachedReads {
+    Worker * w;
+    bool was;
+  public:
+    CachedReads(): w(current_worker()), was(w->cached_reads) { w->cached_reads = true; }
+    ~CachedReads() { w->cached_reads = was; }
+  };
+}
+
+/// Read `target` through this core's cache (falls back to a delegate read if the
+/// value is local, straddles two cache lines, or caching is disabled).
+template< typename T >
+T cached_read(GlobalAddress<T> target) {
+  static_assert(std::is_trivially_copyable<T>::value, "cached values must be trivially copyable");
+  typename std::aligned_storage<sizeof(T),alignof(T)>::type val;
+  if (impl::global_cache_read(target.raw_bits(), &val, sizeof(T))) {
+    return *reinterpret_cast<T*>(&val);
+  }
+  return delegate::call(target.core(), [target]{ return *target.pointer(); });
+}
+
+/// Blocking write to `target`; afterwards this core's cached copy is updated or
+/// dropped, per `--global_cache_writes`. Other cores' copies are unaffected until cache_epoch().
+template< typename T, typename U >
+void cached_write(GlobalAddress<T> target, U value) {
+  static_assert(std::is_trivially_copyable<T>::value, "cached values must be trivially copyable");
+  T v = value;
+  delegate::write(target, v);
+  impl::global_cache_wrote(target.raw_bits(), &v, sizeof(T));
+}
+
+namespace impl {
+
+  template< TaskMode B, SyncMode S, GlobalCompletionEvent * GCE, int64_t Threshold,
+            typename T, typename F >
+  void forall_cached(GlobalAddress<T> base, int64_t nelems, F loop_body,
+                     void (F::*mf)(int64_t,int64_t,T*) const) {
+    auto f = [loop_body](int64_t start, int64_t niters, T * first) {
+      CachedReads c;
+      loop_body(start, niters, first);
+    };
+    impl::forall<B,S,GCE,Threshold>(base, nelems, f, &decltype(f)::operator());
+  }
+
+  template< TaskMode B, SyncMode S, GlobalCompletionEvent * GCE, int64_t Threshold,
+            typename T, typename F >
+  void forall_cached(GlobalAddress<T> base, int64_t nelems, F loop_body,
+                     void (F::*mf)(int64_t,T&) const) {
+    auto f = [loop_body](int64_t i, T& e) {
+      CachedReads c;
+      loop_body(i, e);
+    };
+    impl::forall<B,S,GCE,Threshold>(base, nelems, f, &decltype(f)::operator());
+  }
+
+  template< TaskMode B, SyncMode S, GlobalCompletionEvent * GCE, int64_t Threshold,
+            typename T, typename F >
+  void forall_cached(GlobalAddress<T> base, int64_t nelems, F loop_body,
+                     void (F::*mf)(T&) const) {
+    auto f = [loop_body](T& e) {
+      CachedReads c;
+      loop_body(e);
+    };
+    impl::forall<B,S,GCE,Threshold>(base, nelems, f, &decltype(f)::operator());
+  }
+
+} // namespace impl
+
+/// Parallel loop over a global array (see the other `forall`s) whose body's blocking
+/// delegate reads go through the global cache when `R` is ReadMode::Cached.
+template< ReadMode R,
+          SyncMode S = SyncMode::Blocking,
+          GlobalCompletionEvent * GCE = &impl::local_gce,
+          int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG,
+          TaskMode B = TaskMode::Bound,
+          typename T = decltype(nullptr),
+          typename F = decltype(nullptr) >
+void forall(GlobalAddress<T> base, int64_t nelems, F loop_body) {
+  if (R == ReadMode::Cached) {
+    impl::forall_cached<B,S,GCE,Threshold>(base, nelems, loop_body, &F::operator());
+  } else {
+    impl::forall<B,S,GCE,Threshold>(base, nelems, loop_body, &F::operator());
+  }
+}
+
+/// @}
+} // namespace Grappa
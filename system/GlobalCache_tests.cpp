@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+#include <boost/test/unit_test.hpp>
+#include "Grappa.hpp"
+#include "GlobalCache.hpp"
+
+using namespace Grappa;
+
+BOOST_AUTO_TEST_SUITE( GlobalCache_tests );
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  Grappa::init( GRAPPA_TEST_ARGS );
+  Grappa::run([]{
+    const int64_t N = 4096;
+    auto xs = global_alloc<int64_t>(N);
+    auto ys = global_alloc<int64_t>(N);
+    forall(xs, N, [](int64_t i, int64_t& x){ x = i; });
+
+    // small enough that reading all of xs has to replace lines
+    on_all_cores([]{ FLAGS_global_cache_bytes = 8192; });
+
+    for (int pass = 0; pass < 2; pass++) {
+      for (int64_t i = 0; i < N; i++) BOOST_CHECK_EQUAL(cached_read(xs+i), i);
+    }
+    BOOST_CHECK(global_cache_misses.value() > 0);
+    BOOST_CHECK(global_cache_hits.value() > 0);
+    BOOST_CHECK(global_cache_evictions.value() > 0);
+
+    // find an element on the other core and keep its line cached
+    int64_t k = 0;
+    while ((xs+k).core() == mycore()) k++;
+    BOOST_CHECK_EQUAL(cached_read(xs+k), k);
+
+    // someone else's write isn't seen until the next epoch
+    delegate::write(xs+k, -1);
+    BOOST_CHECK_EQUAL(cached_read(xs+k), k);
+    cache_epoch();
+    BOOST_CHECK_EQUAL(cached_read(xs+k), -1);
+
+    // our own writes are
+    cached_write(xs+k, 7);
+    BOOST_CHECK_EQUAL(cached_read(xs+k), 7);
+    cached_write(xs+k, k);
+
+    // delegate reads inside a cached loop go through the cache
+    cache_epoch();
+    forall<ReadMode::Cached>(ys, N, [xs](int64_t i, int64_t& y){
+      y = delegate::read(xs + (i*7) % N) + delegate::read(xs + (i*7+1) % N);
+    });
+    forall(ys, N, [](int64_t i, int64_t& y){
+      BOOST_CHECK_EQUAL(y, (i*7) % N + (i*7+1) % N);
+    });
+
+    double rate = global_cache_hit_rate();
+    LOG(INFO) << "hit rate: " << rate;
+    BOOST_CHECK(rate > 0.5);
+
+    global_free(xs);
+    global_free(ys);
+  });
+  Grappa::finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -86,6 +86,16 @@ DECLARE_double(locale_shared_fraction);
 DECLARE_bool(logtostderr);
 DECLARE_int32(v);
 
+/// seconds spent in each phase of startup (max over cores); set once, so
+/// read them before any Metrics::reset()
+GRAPPA_DEFINE_METRIC( MaxMetric<double>, startup_time, 0 );
+GRAPPA_DEFINE_METRIC( MaxMetric<double>, startup_communicator_time, 0 );
+GRAPPA_DEFINE_METRIC( MaxMetric<double>, startup_shared_memory_time, 0 );
+GRAPPA_DEFINE_METRIC( MaxMetric<double>, startup_heap_time, 0 );
+GRAPPA_DEFINE_METRIC( MaxMetric<double>, startup_tasking_time, 0 );
+GRAPPA_DEFINE_METRIC( MaxMetric<double>, startup_aggregator_time, 0 );
+GRAPPA_DEFINE_METRIC( MaxMetric<double>, startup_workers_time, 0 );
+
 
 using namespace Grappa::impl;
 using namespace Grappa::Metrics;
@@ -97,6 +107,15 @@ bool Grappa_done_flag;
 static int jobid = 0;
 static const char * nodelist_str = NULL;
 
+/// when Grappa_init() started, for startup_time
+static double startup_start = 0.0;
+
+/// add the time since `start` to a startup phase (some phases have a part
+/// in Grappa_init() and a part in Grappa_activate())
+static void startup_phase_done( MaxMetric<double>& phase, double start ) {
+  phase.add( phase.value() + Grappa::walltime() - start );
+}
+
 Core * node_neighbors;
 
 #ifdef HEAPCHECK_ENABLE
@@ -435,10 +454,12 @@ void Grappa_init( int * argc_p, char ** argv_p[], int64_t global_memory_size_byt
   Grappa::force_tick();
   Grappa::Timestamp start_ts = Grappa::timestamp();
   double start = Grappa::walltime();
+  startup_start = start;
   // now go do other stuff for a while
   
   // initializes system_wide global_communicator
   global_communicator.init( argc_p, argv_p );
+  startup_phase_done( startup_communicator_time, start );
   
   MPI_Errhandler mpi_error_handler;
   MPI_Comm_create_errhandler( &Grappa::impl::mpi_failure_function, &mpi_error_handler );
@@ -513,7 +534,9 @@ void Grappa_init( int * argc_p, char ** argv_p[], int64_t global_memory_size_byt
   CHECK( global_communicator.locale_cores <= MAX_CORES_PER_LOCALE );
   
   //  initializes system_wide global_aggregator
+  double phase_start = Grappa::walltime();
   global_aggregator.init();
+  startup_phase_done( startup_aggregator_time, phase_start );
 
   VLOG(2) << "Aggregator initialized.";
   
@@ -570,16 +593,20 @@ void Grappa_init( int * argc_p, char ** argv_p[], int64_t global_memory_size_byt
   }
   
   // start threading layer
+  phase_start = Grappa::walltime();
   master_thread = convert_to_master();
   VLOG(2) << "Initializing tasking layer."
            << " num_starting_workers=" << FLAGS_num_starting_workers;
   global_task_manager.init( Grappa::mycore(), node_neighbors, Grappa::cores() ); //TODO: options for local stealing
   global_scheduler.init( master_thread, &global_task_manager );
+  startup_phase_done( startup_tasking_time, phase_start );
   
   VLOG(2) << "Scheduler initialized.";
   
   // start RDMA Aggregator *after* threading layer
+  phase_start = Grappa::walltime();
   global_rdma_aggregator.init();
+  startup_phase_done( startup_aggregator_time, phase_start );
   
   VLOG(2) << "RDMA aggregator initialized.";
   
@@ -603,28 +630,38 @@ void Grappa_activate()
 {
   DVLOG(2) << "Activating Grappa library....";
   
+  double phase_start = Grappa::walltime();
   locale_shared_memory.activate(); // do this before communicator
   auto base_locale_shared_memory_allocated = locale_shared_memory.get_allocated();
+  startup_phase_done( startup_shared_memory_time, phase_start );
 
+  phase_start = Grappa::walltime();
   global_communicator.activate();
   auto communicator_locale_shared_memory_allocated = locale_shared_memory.get_allocated();
+  startup_phase_done( startup_communicator_time, phase_start );
 
+  phase_start = Grappa::walltime();
   global_task_manager.activate();
   auto tasks_locale_shared_memory_allocated = locale_shared_memory.get_allocated();
+  startup_phase_done( startup_tasking_time, phase_start );
 
   global_communicator.barrier();
 
   // initializes system_wide global_memory pointer
+  phase_start = Grappa::walltime();
   global_communicator.allreduce_inplace( &Grappa::impl::global_memory_size_bytes, MPI_INT64_T, MPI_MIN );
   global_memory = new GlobalMemory( Grappa::impl::global_memory_size_bytes );
   auto heap_locale_shared_memory_allocated = locale_shared_memory.get_allocated();
+  startup_phase_done( startup_heap_time, phase_start );
 
   // fire up polling thread
   global_scheduler.periodic( impl::worker_spawn( master_thread, &global_scheduler, &poller, NULL ) );
   auto polling_locale_shared_memory_allocated = locale_shared_memory.get_allocated();
 
+  phase_start = Grappa::walltime();
   global_rdma_aggregator.activate();
   auto aggregator_locale_shared_memory_allocated = locale_shared_memory.get_allocated();
+  startup_phase_done( startup_aggregator_time, phase_start );
   
   SharedMessagePool::activate();
   auto shared_pool_locale_shared_memory_allocated = locale_shared_memory.get_allocated();
@@ -663,6 +700,14 @@ void Grappa_activate()
   }
   
   global_communicator.barrier();
+
+  startup_time.add( Grappa::walltime() - startup_start );
+  MASTER_ONLY VLOG(2) << "Startup took " << startup_time.value() << " s:"
+                      << " communicator " << startup_communicator_time.value()
+                      << ", shared memory " << startup_shared_memory_time.value()
+                      << ", heap " << startup_heap_time.value()
+                      << ", tasking " << startup_tasking_time.value()
+                      << ", aggregators " << startup_aggregator_time.value();
 }
 
 
@@ -57,9 +57,11 @@
 #include "AsyncDelegate.hpp"
 #include "Collective.hpp"
 #include "ParallelLoop.hpp"
+#include "PrefetchLoop.hpp"
 #include "GlobalAllocator.hpp"
 // #include "Cache.hpp"
 #include "Array.hpp"
+#include "GlobalCache.hpp"
 
 #include "Metrics.hpp"
 
@@ -100,6 +102,14 @@ namespace Grappa {
   ///   delegate::write<async>(...)
   /// @endcode
   const auto async = Grappa::SyncMode::Async;
+  
+  /// Specify a non-blocking update that may be merged with others to the same address
+  /// before it is sent (see delegate::combine)
+  /// 
+  /// @code
+  ///   delegate::increment<combining>(...)
+  /// @endcode
+  const auto combining = Grappa::SyncMode::Combining;
 #endif
   
 }
@@ -0,0 +1,365 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+#ifndef __INCOHERENT_GATHER_HPP__
+#define __INCOHERENT_GATHER_HPP__
+
+#include "Addressing.hpp"
+#include "Message.hpp"
+#include "LocaleSharedMemory.hpp"
+#include "IncoherentAcquirer.hpp"
+#include "IncoherentReleaser.hpp"
+#include "tasks/TaskingScheduler.hpp"
+
+#include <vector>
+
+/// Elements of a global array picked out by a stride or a list of indices, for
+/// Incoherent<T>::Gather and Incoherent<T>::Scatter.
+///
+/// @b Example:
+/// @code
+///   // every 4th element, a column of a struct array, and an index list
+///   auto every4th = Selection<int64_t>::strided(xs, n/4, 4);
+///   auto weights  = Selection<double>::column(edges, n, &Edge::weight);
+///   auto picked   = Selection<int64_t>::indexed(xs, k, &indices[0]);
+/// @endcode
+template< typename T >
+struct Selection {
+  GlobalAddress< T > base;
+  size_t count;
+  ptrdiff_t stride_bytes;     ///< distance between consecutive elements (without indices)
+  const int64_t * indices;    ///< if not NULL, element k is base + indices[k]
+
+  /// Address of element `k` of the selection.
+  GlobalAddress< T > address( size_t k ) const {
+    if( indices ) return base + indices[k];
+    return GlobalAddress< T >::Raw( base.raw_bits() + k * stride_bytes );
+  }
+
+  /// Elements [k, k+n) of this selection.
+  Selection slice( size_t k, size_t n ) const {
+    if( indices ) return Selection{ base, n, 0, indices + k };
+    return Selection{ address( k ), n, stride_bytes, NULL };
+  }
+
+  /// `count` elements, `stride` elements apart, starting at `base`.
+  static Selection strided( GlobalAddress< T > base, size_t count, ptrdiff_t stride ) {
+    return Selection{ base, count, stride * static_cast< ptrdiff_t >( sizeof(T) ), NULL };
+  }
+
+  /// The elements at `base + indices[k]` for k in [0,count). `indices` is read when
+  /// the gather or scatter starts, so it only has to live until then.
+  static Selection indexed( GlobalAddress< T > base, size_t count, const int64_t * indices ) {
+    return Selection{ base, count, 0, indices };
+  }
+
+  /// Member `m` of each of the `count` structs starting at `base`.
+  template< typename S >
+  static Selection column( GlobalAddress< S > base, size_t count, T S::* m ) {
+    return Selection{ global_pointer_to_member( base, m ), count, sizeof(S), NULL };
+  }
+};
+
+namespace Grappa {
+namespace impl {
+
+  /// Most bytes of addresses or values carried by one gather/scatter message.
+  const size_t gather_message_bytes = 2048;
+
+  /// The elements of a Selection on other cores, grouped by owning core and split into
+  /// runs that each fit in one request message.
+  struct SelectionBatches {
+    struct Batch {
+      Core core;
+      uint32_t start;   ///< first entry of `positions`/`addresses` in this batch
+      uint32_t count;
+    };
+    std::vector< uint32_t > positions;   ///< position in the selection, grouped by owner
+    std::vector< intptr_t > addresses;   ///< raw global address of each
+    std::vector< Batch > batches;
+
+    void clear() {
+      positions.clear();
+      addresses.clear();
+      batches.clear();
+    }
+
+    /// Group the remote elements of `s`, calling `local(k, pointer)` for each element
+    /// on this core instead.
+    template< typename T, typename F >
+    void build( const Selection< T >& s, size_t per_message, F local ) {
+      clear();
+      std::vector< uint32_t > offsets( Grappa::cores() + 1, 0 );
+      for( size_t k = 0; k < s.count; k++ ) {
+        auto a = s.address( k );
+        if( a.core() == Grappa::mycore() ) {
+          local( k, a.pointer() );
+        } else {
+          offsets[ a.core() + 1 ]++;
+        }
+      }
+      for( Core c = 0; c < Grappa::cores(); c++ ) {
+        uint32_t n = offsets[c+1];
+        for( uint32_t i = 0; i < n; i += per_message ) {
+          batches.push_back( Batch{ c, offsets[c] + i, static_cast< uint32_t >( std::min< size_t >( per_message, n - i ) ) } );
+        }
+        offsets[c+1] += offsets[c];
+      }
+      positions.resize( offsets[ Grappa::cores() ] );
+      addresses.resize( positions.size() );
+      for( size_t k = 0; k < s.count; k++ ) {
+        auto a = s.address( k );
+        if( a.core() != Grappa::mycore() ) {
+          auto& i = offsets[ a.core() ];
+          positions[i] = k;
+          addresses[i] = a.raw_bits();
+          i++;
+        }
+      }
+    }
+  };
+
+} // namespace impl
+} // namespace Grappa
+
+/// Acquire behavior for Incoherent<T>::Gather: one request per owning core (split only
+/// to fit in messages) carrying the addresses it owns; the owner replies with the values
+/// packed in request order, which are unpacked into place.
+template< typename T >
+class GatherAcquirer {
+private:
+  const Selection< T > * selection_;
+  T ** pointer_;
+  bool acquire_started_;
+  bool acquired_;
+  Grappa::Worker * thread_;
+  Grappa::impl::SelectionBatches batches_;
+  size_t response_count_;
+
+public:
+  GatherAcquirer( const Selection< T > * selection, T ** pointer )
+    : selection_( selection )
+    , pointer_( pointer )
+    , acquire_started_( false )
+    , acquired_( false )
+    , thread_( NULL )
+    , batches_()
+    , response_count_( 0 )
+  {
+    reset();
+  }
+
+  void reset() {
+    CHECK( !acquire_started_ || acquired_ ) << "inconsistent state for reset";
+    acquire_started_ = false;
+    acquired_ = false;
+    thread_ = NULL;
+    response_count_ = 0;
+    batches_.clear();
+    if( selection_->count == 0 ) {
+      acquire_started_ = true;
+      acquired_ = true;
+    }
+  }
+
+  void start_acquire() {
+    if( acquire_started_ ) return;
+    acquire_started_ = true;
+
+    T * buf = *pointer_;
+    size_t per_message = std::max< size_t >( 1, Grappa::impl::gather_message_bytes
+                                                / std::max( sizeof(T), sizeof(intptr_t) ) );
+    batches_.build( *selection_, per_message, [buf]( size_t k, T * p ) { buf[k] = *p; } );
+    if( batches_.batches.empty() ) {
+      acquired_ = true;
+      return;
+    }
+
+    auto reply_address = make_global( this );
+    for( uint32_t b = 0; b < batches_.batches.size(); b++ ) {
+      auto& batch = batches_.batches[b];
+      auto request = Grappa::locale_alloc< intptr_t >( batch.count );
+      std::copy( &batches_.addresses[ batch.start ], &batches_.addresses[ batch.start ] + batch.count, request );
+
+      auto m = Grappa::heap_message( batch.core, [reply_address, b]( void * payload, size_t payload_size ) {
+        auto addresses = static_cast< intptr_t * >( payload );
+        size_t n = payload_size / sizeof(intptr_t);
+        IAMetrics::count_acquire_ams( n * sizeof(T) );
+
+        auto values = Grappa::locale_alloc< T >( n );
+        for( size_t i = 0; i < n; i++ ) {
+          values[i] = *GlobalAddress< T >::Raw( addresses[i] ).pointer();
+        }
+        auto reply = Grappa::heap_message( reply_address.core(), [reply_address, b]( void * payload, size_t payload_size ) {
+          reply_address.pointer()->gather_reply( b, static_cast< T * >( payload ), payload_size / sizeof(T) );
+        }, values, n * sizeof(T) );
+        reply->delete_payload_after_send();
+        reply->enqueue();
+      }, request, batch.count * sizeof(intptr_t) );
+      m->delete_payload_after_send();
+      m->enqueue();
+    }
+  }
+
+  void block_until_acquired() {
+    if( !acquired_ ) {
+      start_acquire();
+      while( !acquired_ ) {
+        thread_ = Grappa::current_worker();
+        Grappa::suspend();
+        thread_ = NULL;
+      }
+    }
+  }
+
+  void gather_reply( uint32_t b, const T * values, size_t n ) {
+    auto& batch = batches_.batches[b];
+    DCHECK_EQ( n, batch.count );
+    T * buf = *pointer_;
+    for( size_t i = 0; i < n; i++ ) {
+      buf[ batches_.positions[ batch.start + i ] ] = values[i];
+    }
+    if( ++response_count_ == batches_.batches.size() ) {
+      acquired_ = true;
+      if( thread_ != NULL ) Grappa::wake( thread_ );
+    }
+  }
+
+  bool acquired() const { return acquired_; }
+};
+
+/// Release behavior for Incoherent<T>::Scatter: one message per owning core (split only
+/// to fit in messages) carrying the addresses it owns followed by their new values.
+template< typename T >
+class ScatterReleaser {
+private:
+  const Selection< T > * selection_;
+  T ** pointer_;
+  bool release_started_;
+  bool released_;
+  Grappa::Worker * thread_;
+  size_t num_messages_;
+  size_t response_count_;
+
+public:
+  ScatterReleaser( const Selection< T > * selection, T ** pointer )
+    : selection_( selection )
+    , pointer_( pointer )
+    , release_started_( false )
+    , released_( false )
+    , thread_( NULL )
+    , num_messages_( 0 )
+    , response_count_( 0 )
+  {
+    reset();
+  }
+
+  void reset() {
+    CHECK( !release_started_ || released_ ) << "inconsistent state for reset";
+    release_started_ = false;
+    released_ = false;
+    thread_ = NULL;
+    num_messages_ = 0;
+    response_count_ = 0;
+    if( selection_->count == 0 ) {
+      release_started_ = true;
+      released_ = true;
+    }
+  }
+
+  void start_release() {
+    if( release_started_ ) return;
+    release_started_ = true;
+
+    const T * buf = *pointer_;
+    size_t per_message = std::max< size_t >( 1, Grappa::impl::gather_message_bytes
+                                                / ( sizeof(intptr_t) + sizeof(T) ) );
+    Grappa::impl::SelectionBatches batches;
+    batches.build( *selection_, per_message, [buf]( size_t k, T * p ) { *p = buf[k]; } );
+    num_messages_ = batches.batches.size();
+    if( num_messages_ == 0 ) {
+      released_ = true;
+      return;
+    }
+
+    auto reply_address = make_global( this );
+    for( auto& batch : batches.batches ) {
+      size_t bytes = batch.count * ( sizeof(intptr_t) + sizeof(T) );
+      auto request = Grappa::locale_alloc< char >( bytes );
+      auto addresses = reinterpret_cast< intptr_t * >( request );
+      auto values = request + batch.count * sizeof(intptr_t);
+      for( uint32_t i = 0; i < batch.count; i++ ) {
+        addresses[i] = batches.addresses[ batch.start + i ];
+        memcpy( values + i * sizeof(T), &buf[ batches.positions[ batch.start + i ] ], sizeof(T) );
+      }
+
+      auto m = Grappa::heap_message( batch.core, [reply_address]( void * payload, size_t payload_size ) {
+        size_t n = payload_size / ( sizeof(intptr_t) + sizeof(T) );
+        auto addresses = static_cast< intptr_t * >( payload );
+        auto values = static_cast< char * >( payload ) + n * sizeof(intptr_t);
+        IRMetrics::count_release_ams( n * sizeof(T) );
+        for( size_t i = 0; i < n; i++ ) {
+          memcpy( GlobalAddress< T >::Raw( addresses[i] ).pointer(), values + i * sizeof(T), sizeof(T) );
+        }
+        Grappa::send_heap_message( reply_address.core(), [reply_address] {
+          reply_address.pointer()->release_reply();
+        });
+      }, request, bytes );
+      m->delete_payload_after_send();
+      m->enqueue();
+    }
+  }
+
+  void block_until_released() {
+    if( !released_ ) {
+      start_release();
+      while( !released_ ) {
+        thread_ = Grappa::current_worker();
+        Grappa::suspend();
+        thread_ = NULL;
+      }
+    }
+  }
+
+  void release_reply() {
+    if( ++response_count_ == num_messages_ ) {
+      released_ = true;
+      if( thread_ != NULL ) Grappa::wake( thread_ );
+    }
+  }
+
+  bool released() const { return released_; }
+};
+
+#endif
@@ -33,6 +33,9 @@
 ////////////////////////////////////////////////////////////////////////
 
 #include "LocaleSharedMemory.hpp"
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstring>
 
 DEFINE_int64( locale_shared_size, 0, "Total shared memory between cores on node (when 0, defaults to locale_shared_fraction * total node memory)" );
 
@@ -42,6 +45,8 @@ DEFINE_double( locale_user_heap_fraction, 0.1, "Fraction of locale shared memory
 
 DEFINE_double( global_heap_fraction, 0.25, "Fraction of locale shared memory to set aside for global shared heap" );
 
+DEFINE_bool( locale_shared_hugepages, false, "Ask the kernel to back the locale shared memory with transparent huge pages (needs shmem_enabled=advise)" );
+
 DECLARE_int64( node_memsize );
 DECLARE_bool( global_memory_use_hugepages );
 
@@ -148,6 +153,20 @@ void LocaleSharedMemory::unlink() {
 }
 
 
+/// Pages are still only allocated (and zeroed by the kernel) on first
+/// touch, but as 2MB pages, so there are far fewer faults and TLB misses.
+void LocaleSharedMemory::advise_hugepages() {
+#ifdef MADV_HUGEPAGE
+  if( 0 != madvise( base_address, segment.get_size(), MADV_HUGEPAGE ) ) {
+    LOG(WARNING) << "Couldn't get huge pages for LocaleSharedMemory region " << region_name
+                 << ": " << strerror( errno );
+  }
+#else
+  LOG(WARNING) << "Huge pages for LocaleSharedMemory are not supported on this platform";
+#endif
+}
+
+
 LocaleSharedMemory::LocaleSharedMemory()
   : region_size()
   , region_name( "GrappaLocaleSharedMemory" )
@@ -175,11 +194,13 @@ void LocaleSharedMemory::init() {
 }
 
 void LocaleSharedMemory::activate() {
+  // only cores sharing the region need to wait for each other here
   if( Grappa::locale_mycore() == 0 ) { create(); }
-  global_communicator.barrier();
+  global_communicator.locale_barrier();
   if( Grappa::locale_mycore() != 0 ) { attach(); }
-  global_communicator.barrier();
+  global_communicator.locale_barrier();
   if( Grappa::locale_mycore() == 0 ) { unlink(); } // delete once everyone has released it
+  if( FLAGS_locale_shared_hugepages ) advise_hugepages();
   //available = global_bytes_per_core;
 }
 
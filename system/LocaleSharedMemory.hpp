@@ -59,6 +59,7 @@ private:
   void create();
   void attach();
   void unlink();
+  void advise_hugepages();
 
   friend class RDMAAggregator;
 
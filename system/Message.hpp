@@ -97,7 +97,7 @@ namespace Grappa {
     
     /// How much storage do we need to send this message?
     virtual const size_t serialized_size( ) const {
-      return sizeof( &deserialize_and_call ) + sizeof( T );
+      return impl::message_header_size( impl::DeserializerID< &deserialize_and_call >::id ) + sizeof( T );
     }
     
     virtual const size_t size() const { return sizeof(*this); }
@@ -113,8 +113,7 @@ namespace Grappa {
     /// @return address of byte following message functor/contents in buffer
     static char * deserialize_and_call( char * t ) {
       DVLOG(5) << "In " << __PRETTY_FUNCTION__;
-      T * obj = reinterpret_cast< T * >( t );
-      (*obj)();
+      Grappa::impl::call_serialized< T >( t );
       return t + sizeof( T );
     }
 
@@ -132,31 +131,17 @@ namespace Grappa {
     /// Copy this message into a buffer.
     virtual char * serialize_to( char * p, size_t max_size ) {
       Grappa::impl::MessageBase::serialize_to( p, max_size );
-      // copy deserialization function pointer
+      // write deserializer ID (or pointer)
       auto fp = &deserialize_and_call;
       if( serialized_size() > max_size ) {
         return p;
       } else {
-        // // turn into 2D pointer
-        //auto gfp = make_global( fp, destination_ );
-        // // write to buffer
-        //*(reinterpret_cast< intptr_t* >(p)) = reinterpret_cast< intptr_t >( gfp );
-        //*(reinterpret_cast< intptr_t* >(p)) = reinterpret_cast< intptr_t >( fp );
-        //intptr_t gfp = reinterpret_cast< intptr_t >( fp ) << 16;
-        //gfp |= destination_; // TODO: watch out for sign extension
-        //*(reinterpret_cast< intptr_t* >(p)) = gfp;
-        // p += sizeof( fp );
-
-        MessageFPAddr gfp = { destination_, reinterpret_cast< intptr_t >( fp ) };
-        *(reinterpret_cast< MessageFPAddr* >(p)) = gfp;
-        static_assert( sizeof(gfp) == 8, "gfp wrong size?" );
-        p += sizeof( gfp );
-
+        p = impl::write_message_header( p, destination_, impl::DeserializerID< &deserialize_and_call >::id, fp );
         
         // copy contents
         std::memcpy( p, &storage_, sizeof(storage_) );
         
-        DVLOG(5) << __PRETTY_FUNCTION__ << " serialized message of size " << sizeof(fp) + sizeof(storage_) << " to " << gfp.dest << " with deserializer " << fp;
+        DVLOG(5) << __PRETTY_FUNCTION__ << " serialized message of size " << serialized_size() << " to " << destination_ << " with deserializer " << fp;
         
         // return pointer following message
         return p + sizeof( T );
@@ -211,7 +196,9 @@ namespace Grappa {
     
     virtual ~PayloadMessage() {
       block_until_sent();
-      //if( delete_payload_after_send_ ) delete payload_;
+      if( delete_payload_after_send_ && payload_ ) {
+        Grappa::impl::locale_shared_memory.deallocate( payload_ );
+      }
     }
 
     inline void set_payload( void * payload, size_t size ) {
@@ -220,6 +207,7 @@ namespace Grappa {
       Grappa::impl::locale_shared_memory.validate_address( payload );
     }
 
+    /// Free the payload (which must come from locale_alloc) once the message is sent.
     inline void delete_payload_after_send() { delete_payload_after_send_ = true; }
 
     virtual void reset() {
@@ -251,7 +239,11 @@ namespace Grappa {
 
     /// How much storage do we need to send this message?
     virtual const size_t serialized_size( ) const {
-      return sizeof( &deserialize_and_call ) + sizeof( T ) + sizeof( int16_t ) + payload_size_;
+      if( FLAGS_compact_messages ) {
+        return impl::message_header_size( impl::DeserializerID< &deserialize_compact >::id )
+          + sizeof( T ) + impl::varint_size( payload_size_ ) + payload_size_;
+      }
+      return impl::message_header_size( 0 ) + sizeof( T ) + sizeof( int16_t ) + payload_size_;
     }
 
     virtual const size_t size() const { return sizeof(*this); }
@@ -267,13 +259,27 @@ namespace Grappa {
     /// @return address of byte following message functor/contents in buffer
     static char * deserialize_and_call( char * t ) {
       DVLOG(5) << "In " << __PRETTY_FUNCTION__;
-      T * obj = reinterpret_cast< T * >( t );
+      char * obj = t;
       t += sizeof( T );
 
-      int16_t payload_size = *(reinterpret_cast< int16_t* >(t));
+      int16_t payload_size;
+      std::memcpy( &payload_size, t, sizeof( int16_t ) );
       t += sizeof( int16_t );
 
-      (*obj)( t, payload_size );
+      impl::call_serialized< T >( obj, (void*) t, (size_t) payload_size );
+
+      return t + payload_size;
+    }
+
+    /// Same, for messages written with --compact_messages (payload size is a varint).
+    static char * deserialize_compact( char * t ) {
+      DVLOG(5) << "In " << __PRETTY_FUNCTION__;
+      char * obj = t;
+      t += sizeof( T );
+
+      size_t payload_size = impl::get_varint( t );
+
+      impl::call_serialized< T >( obj, (void*) t, payload_size );
 
       return t + payload_size;
     }
@@ -294,33 +300,27 @@ namespace Grappa {
       if( serialized_size() > max_size ) {
         return p;
       } else {
-        // // turn into 2D pointer
-        // auto gfp = make_global( fp, destination_ );
-        // // write to buffer
-        // *(reinterpret_cast< intptr_t* >(p)) = reinterpret_cast< intptr_t >( gfp );
-        //*(reinterpret_cast< intptr_t* >(p)) = reinterpret_cast< intptr_t >( fp );
-
-        // intptr_t gfp = reinterpret_cast< intptr_t >( fp ) << 16;
-        // gfp |= destination_;
-        // *(reinterpret_cast< intptr_t* >(p)) = gfp;
-        // p += sizeof( fp );
-
-        MessageFPAddr gfp = { destination_, reinterpret_cast< intptr_t >( fp ) };
-        *(reinterpret_cast< MessageFPAddr* >(p)) = gfp;
-        static_assert( sizeof(gfp) == 8, "gfp wrong size?" );
-        p += sizeof( gfp );
-
+        if( FLAGS_compact_messages ) {
+          p = impl::write_message_header( p, destination_, impl::DeserializerID< &deserialize_compact >::id, &deserialize_compact );
+        } else {
+          p = impl::write_message_header( p, destination_, 0, fp );
+        }
         
         // copy contents
         std::memcpy( p, &storage_, sizeof(storage_) );
         p += sizeof( storage_ );
 
-        *(reinterpret_cast< int16_t* >(p)) = static_cast< int16_t >( payload_size_ );
-        p += sizeof( int16_t );
+        if( FLAGS_compact_messages ) {
+          p = impl::put_varint( p, payload_size_ );
+        } else {
+          int16_t payload_size = static_cast< int16_t >( payload_size_ );
+          std::memcpy( p, &payload_size, sizeof( int16_t ) );
+          p += sizeof( int16_t );
+        }
 
         std::memcpy( p, payload_, payload_size_);
 
-        DVLOG(5) << __PRETTY_FUNCTION__ << " serialized message of size " << sizeof(fp) + sizeof(storage_) + sizeof(int16_t) + payload_size_ << " to " << gfp.dest << " with deserializer " << fp;
+        DVLOG(5) << __PRETTY_FUNCTION__ << " serialized message of size " << serialized_size() << " to " << destination_ << " with deserializer " << fp;
 
         // return pointer following message
         return p + payload_size_;
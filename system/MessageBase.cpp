@@ -39,11 +39,24 @@
 
 #include "ConditionVariable.hpp"
 
+DEFINE_bool( compact_messages, false, "Start each serialized message with a 1-2 byte deserializer ID rather than an 8-byte function pointer, encode message sizes and addresses as varints, and send async increments and writes as update messages (must be the same on every core)" );
+
 namespace Grappa {
 
   /// Internal messaging functions
   namespace impl {
 
+    // ID 0 means "no ID". Both are statically initialized, so registering works from
+    // any file's dynamic initialization.
+    MessageDeserializer deserializer_table[ max_deserializer_ids ];
+    static size_t deserializer_ids = 1;
+
+    uint16_t register_deserializer( MessageDeserializer fp ) {
+      if( deserializer_ids == max_deserializer_ids ) return 0;
+      deserializer_table[ deserializer_ids ] = fp;
+      return deserializer_ids++;
+    }
+
     /// @addtogroup Communication
     /// @{
 
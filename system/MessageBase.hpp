@@ -36,6 +36,7 @@
 #define __MESSAGEBASE_HPP__
 
 #include <cstring>
+#include <type_traits>
 
 #include <gflags/gflags.h>
 #include <glog/logging.h>
@@ -44,9 +45,13 @@
 #include "ConditionVariableLocal.hpp"
 #include "Mutex.hpp"
 #include "LocaleSharedMemory.hpp"
+#include "Addressing.hpp"
 
 typedef int16_t Core;
 
+/// Write messages with compact headers (see Grappa::impl::register_deserializer).
+DECLARE_bool(compact_messages);
+
 namespace Grappa {
   
   // forward declarations
@@ -64,6 +69,123 @@ namespace Grappa {
     intptr_t raw;
   };
 
+  /// Function that runs a serialized message and returns the address following it.
+  typedef char * (*MessageDeserializer)(char *);
+
+  /// Compact message headers.
+  ///
+  /// Every deserializer gets a small ID when the program starts (dynamic initialization
+  /// runs in the same order in every process of the job, so IDs agree everywhere, just
+  /// as function addresses already had to). With --compact_messages, a message starts
+  /// with its ID as a varint: one byte below 128, two bytes up to 2^14, followed in
+  /// debug builds by the destination core so misdelivery is still caught. A zero byte
+  /// instead is followed by the full 8-byte MessageFPAddr, for deserializers without an
+  /// ID (the table is full, or the message is sent before its ID is assigned).
+  ///
+  /// With --compact_messages off (the default), every message starts with just the
+  /// MessageFPAddr, as it always did. The two layouts can't be told apart, so the flag
+  /// must have the same value on every core whenever messages are in flight.
+  const size_t max_deserializer_ids = 1 << 14;
+  extern MessageDeserializer deserializer_table[ max_deserializer_ids ];
+
+  /// Assign the next ID to `fp`, or 0 if none are left (defined in MessageBase.cpp).
+  uint16_t register_deserializer( MessageDeserializer fp );
+
+  template< MessageDeserializer F >
+  struct DeserializerID { static const uint16_t id; };
+
+  template< MessageDeserializer F >
+  const uint16_t DeserializerID<F>::id = register_deserializer( F );
+
+#ifdef NDEBUG
+  const size_t message_header_dest_size = 0;
+#else
+  const size_t message_header_dest_size = sizeof(Core);
+#endif
+
+  inline size_t message_header_size( uint16_t id ) {
+    if( !FLAGS_compact_messages ) return sizeof(MessageFPAddr);
+    if( id == 0 ) return 1 + sizeof(MessageFPAddr);
+    return (id < 0x80 ? 1 : 2) + message_header_dest_size;
+  }
+
+  /// Write the header of a message for `dest`; returns the address following it.
+  inline char * write_message_header( char * p, Core dest, uint16_t id, MessageDeserializer fp ) {
+    if( !FLAGS_compact_messages || id == 0 ) {
+      if( FLAGS_compact_messages ) *p++ = 0;
+      MessageFPAddr gfp = { dest, reinterpret_cast< intptr_t >( fp ) };
+      memcpy( p, &gfp, sizeof(gfp) );
+      return p + sizeof(gfp);
+    } else if( id < 0x80 ) {
+      *p++ = static_cast<char>( id );
+    } else {
+      *p++ = static_cast<char>( 0x80 | (id & 0x7f) );
+      *p++ = static_cast<char>( id >> 7 );
+    }
+#ifndef NDEBUG
+    memcpy( p, &dest, sizeof(dest) );
+    p += sizeof(dest);
+#endif
+    return p;
+  }
+
+  /// Variable-length unsigned integers, 7 bits per byte, low bits first.
+  inline size_t varint_size( uint64_t x ) {
+    size_t n = 1;
+    while( x >= 0x80 ) { x >>= 7; n++; }
+    return n;
+  }
+
+  inline char * put_varint( char * p, uint64_t x ) {
+    while( x >= 0x80 ) {
+      *p++ = static_cast<char>( x | 0x80 );
+      x >>= 7;
+    }
+    *p++ = static_cast<char>( x );
+    return p;
+  }
+
+  inline uint64_t get_varint( char *& p ) {
+    uint64_t x = 0;
+    for( int shift = 0; ; shift += 7 ) {
+      uint8_t b = *p++;
+      x |= static_cast<uint64_t>( b & 0x7f ) << shift;
+      if( !(b & 0x80) ) return x;
+    }
+  }
+
+  /// The object at global address `raw`, for core_offset_pointer() on its home core.
+  /// A linear (global heap) address is its offset into the home core's heap chunk,
+  /// which is the same on every core: a few bytes as a varint, instead of the 8 of the
+  /// raw address. A 2D address already holds the home core's own pointer, so it is
+  /// sent as is. The low bit tells the two apart.
+  inline uint64_t core_offset( intptr_t raw ) {
+    auto ga = GlobalAddress<char>::Raw( raw );
+    if( ga.is_2D() ) {
+      return (static_cast<uint64_t>( reinterpret_cast< uintptr_t >( ga.pointer() ) ) << 1) | 1;
+    }
+    return static_cast<uint64_t>( ga.pointer() - static_cast< char * >( global_memory_chunk_base ) ) << 1;
+  }
+
+  /// Call the functor of type T serialized at `t`. Compact headers leave it wherever the
+  /// previous message ended, so it's copied to aligned storage first if need be.
+  template< typename T, typename... Args >
+  inline void call_serialized( char * t, Args... args ) {
+    if( reinterpret_cast< uintptr_t >( t ) % alignof(T) == 0 ) {
+      (*reinterpret_cast< T * >( t ))( args... );
+    } else {
+      typename std::aligned_storage< sizeof(T), alignof(T) >::type tmp;
+      memcpy( &tmp, t, sizeof(T) );
+      (*reinterpret_cast< T * >( &tmp ))( args... );
+    }
+  }
+
+  /// Local pointer on this core for an offset from core_offset().
+  inline char * core_offset_pointer( uint64_t z ) {
+    if( z & 1 ) return reinterpret_cast< char * >( z >> 1 );
+    return static_cast< char * >( global_memory_chunk_base ) + (z >> 1);
+  }
+
     /// @addtogroup Communication
     /// @{
 
@@ -156,27 +278,35 @@ namespace Grappa {
       /// Walk a buffer of received deserializers/functors and call them.
       static inline char * deserialize_and_call( char * buffer ) {
         DVLOG(5) << "Deserializing message from " << (void*) buffer;
-        typedef char * (*Deserializer)(char *);       // generic deserializer type
-
-        // intptr_t gfp = *(reinterpret_cast< intptr_t* >( buffer ));
-        // Core dest = gfp & ((1 << 16) - 1);
-        // Deserializer fp = *(reinterpret_cast< Deserializer* >( gfp >> 16 ));
-
-        // CHECK_EQ( dest, Grappa::mycore() ) << "Delivered to wrong node";
-
-        // buffer = fp( buffer + sizeof( Deserializer ) );
-
-        MessageFPAddr gfp = *(reinterpret_cast< MessageFPAddr* >(buffer));
-        Deserializer fp = reinterpret_cast< Deserializer >( gfp.fp );
+        MessageDeserializer fp;
+        uint8_t b = *buffer;
+        if( !FLAGS_compact_messages || b == 0 ) {
+          if( FLAGS_compact_messages ) buffer++;
+          MessageFPAddr gfp;
+          memcpy( &gfp, buffer, sizeof(gfp) );
+          fp = reinterpret_cast< MessageDeserializer >( gfp.fp );
+          CHECK_EQ( gfp.dest, Grappa::mycore() ) << "Delivered to wrong core! buffer=" << (void*) buffer;
+          buffer += sizeof(gfp);
+        } else {
+          if( b & 0x80 ) {
+            fp = deserializer_table[ (b & 0x7f) | (static_cast<uint8_t>( buffer[1] ) << 7) ];
+            buffer += 2;
+          } else {
+            fp = deserializer_table[ b ];
+            buffer += 1;
+          }
+#ifndef NDEBUG
+          Core dest;
+          memcpy( &dest, buffer, sizeof(dest) );
+          CHECK_EQ( dest, Grappa::mycore() ) << "Delivered to wrong core! buffer=" << (void*) buffer;
+          buffer += sizeof(dest);
+#endif
+        }
 
-        DVLOG(5) << "Receiving message from " << gfp.dest << " with deserializer " << (void*) fp;
-        
+        DVLOG(5) << "Receiving message with deserializer " << (void*) fp;
         CHECK_NOTNULL( fp );
-        CHECK_EQ( gfp.dest, Grappa::mycore() ) << "Delivered to wrong core! buffer=" << (void*) buffer;
-
-        buffer = fp( buffer + sizeof( MessageFPAddr ) );
 
-        return buffer;
+        return fp( buffer );
       }
 
     public:
@@ -290,6 +290,39 @@ void test_forall_localized() {
     
 }
 
+void test_forall_prefetch() {
+  BOOST_MESSAGE("Testing forall_prefetch..."); VLOG(1) << "testing forall_prefetch";
+  const int64_t N = 1000;
+  auto src = Grappa::global_alloc<int64_t>(N);
+  auto labels = Grappa::global_alloc<int64_t>(N);
+  auto weights = Grappa::global_alloc<double>(N);
+  forall(src, N, [](int64_t i, int64_t& s){ s = (i * 7919) % N; });
+  forall(labels, N, [](int64_t i, int64_t& l){ l = 10 * i; });
+  forall(weights, N, [](int64_t i, double& w){ w = 0.5 * i; });
+
+  forall_prefetch(src, N,
+    prefetch(labels, [](int64_t i, const int64_t& s){ return s; }),
+    [](int64_t i, int64_t& s, const int64_t& label){
+      BOOST_CHECK_EQUAL(label, 10 * ((i * 7919) % N));
+    });
+
+  // two arrays, and a threshold past the default prefetch distance
+  forall_prefetch<&impl::local_gce,64>(src, N,
+    prefetch(labels, [](int64_t i, const int64_t& s){ return s; }),
+    prefetch(weights, [](int64_t i, const int64_t& s){ return N-1-i; }),
+    [](int64_t i, int64_t& s, const int64_t& label, const double& w){
+      BOOST_CHECK_EQUAL(w, 0.5 * (N-1-i));
+      s = label;
+    });
+  for (int64_t i=0; i<N; i++) {
+    BOOST_CHECK_EQUAL(delegate::read(src+i), 10 * ((i * 7919) % N));
+  }
+
+  Grappa::global_free(src);
+  Grappa::global_free(labels);
+  Grappa::global_free(weights);
+}
+
 void test_forall_here_async() {
   const int N = 1117376;
   const int64_t x = 4;
@@ -325,6 +358,7 @@ BOOST_AUTO_TEST_CASE( test1 ) {
     test_forall_global_public();
   
     test_forall_localized();
+    test_forall_prefetch();
 
     test_forall_here_async();
     
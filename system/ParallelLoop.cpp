@@ -37,6 +37,7 @@
 #include "GlobalCompletionEvent.hpp"
 
 DEFINE_int64(loop_threshold, 16, "threshold for how small a group of iterations should be to perform them serially");
+DEFINE_int64(loop_prefetch_distance, 16, "iterations ahead of the one running that forall_prefetch starts fetching secondary values for");
 
 namespace Grappa {
   namespace impl {
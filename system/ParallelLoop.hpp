@@ -155,7 +155,7 @@ namespace Grappa {
         } else {
           CHECK(false) << "unimplemented, sorry!";
         }
-      } else if (C && S == SyncMode::Async && B == TaskMode::Bound
+      } else if (C && is_async(S) && B == TaskMode::Bound
           && sizeof(F) > 8
           && C->get_shared_ptr<F>() == nullptr) {
         auto hf = new HeapF(loop_body, iters);
@@ -248,7 +248,7 @@ namespace Grappa {
         
         if (sizeof(loop_body) > 8) {
           
-          CHECK(S != SyncMode::Async) << "Cannot do 'async' with a lambda > 8 bytes.";
+          CHECK(!is_async(S)) << "Cannot do 'async' with a lambda > 8 bytes.";
           
           // initialize this on all cores before starting any tasks
           C->set_shared_ptr(&loop_body);
@@ -0,0 +1,191 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Addressing.hpp"
+#include "Cache.hpp"
+#include "ParallelLoop.hpp"
+#include <tuple>
+#include <vector>
+#include <type_traits>
+
+/// Flag: loop_prefetch_distance
+///
+/// How many iterations ahead of the one running a `forall_prefetch` task starts the acquires
+/// for. A task never looks past its own iterations, so the effective distance is at most the
+/// loop threshold; pass a larger `Threshold` for deeper pipelines.
+DECLARE_int64(loop_prefetch_distance);
+
+namespace Grappa {
+  /// @addtogroup Loops
+  /// @{
+
+  /// A secondary array read by each iteration of a `forall_prefetch` loop: iteration `i`,
+  /// on element `e` of the loop's array, reads `array[index(i, e)]`.
+  template< typename U, typename I >
+  struct Prefetch {
+    GlobalAddress<U> array;
+    I index;
+  };
+
+  /// Describe a secondary array for `forall_prefetch`; `index` is `int64_t(int64_t i, const T& e)`.
+  template< typename U, typename I >
+  Prefetch<U,I> prefetch(GlobalAddress<U> array, I index) {
+    return Prefetch<U,I>{ array, index };
+  }
+
+  namespace impl {
+
+    template< int... > struct seq {};
+    template< int N, int... S > struct gen_seq : gen_seq<N-1, N-1, S...> {};
+    template< int... S > struct gen_seq<0, S...> { typedef seq<S...> type; };
+
+    /// Ring of `w` single-element acquires for one secondary array; iteration `j` uses slot `j % w`.
+    template< typename T, typename P > class PrefetchWindow;
+
+    template< typename T, typename U, typename I >
+    class PrefetchWindow< T, Prefetch<U,I> > {
+      typedef typename Incoherent<U>::RO RO;
+      Prefetch<U,I> p;
+      size_t w;
+      std::vector<U> values;
+      std::vector<typename std::aligned_storage<sizeof(RO),alignof(RO)>::type> slots;
+
+      RO * slot(size_t j) { return reinterpret_cast<RO*>(&slots[j % w]); }
+
+    public:
+      PrefetchWindow(const Prefetch<U,I>& p, size_t w): p(p), w(w), values(w), slots(w) {}
+
+      /// Start fetching the value for iteration `j` (global index `i`, element `e`).
+      void start(size_t j, int64_t i, const T& e) {
+        RO * c = new (slot(j)) RO(p.array + p.index(i, e), 1, &values[j % w]);
+        c->start_acquire();
+      }
+
+      /// Wait for iteration `j`'s value; valid until finish(j).
+      const U& get(size_t j) { return *static_cast<const U*>(*slot(j)); }
+
+      void finish(size_t j) { slot(j)->~RO(); }
+    };
+
+    /// Run the `niters` local elements from `first` (global index `start`), keeping up to
+    /// --loop_prefetch_distance iterations' acquires in flight ahead of the one running.
+    template< typename T, typename F, typename... P, int... S >
+    void prefetch_range(const F& loop_body, const std::tuple<P...>& ps, seq<S...>,
+                        int64_t start, int64_t niters, T * first) {
+      // global index of each iteration (a task's range may cross block boundaries)
+      std::vector<int64_t> index(niters);
+      int64_t block_elems = block_size / sizeof(T);
+      int64_t n_to_boundary = make_linear(first).block_max() - make_linear(first);
+      for (int64_t j=0, i=start; j<niters; j++, i++, n_to_boundary--) {
+        if (n_to_boundary == 0) {
+          i += block_elems * (cores()-1);
+          n_to_boundary = block_elems;
+        }
+        index[j] = i;
+      }
+
+      size_t w = std::max<int64_t>(1, std::min<int64_t>(FLAGS_loop_prefetch_distance, niters));
+      std::tuple< PrefetchWindow<T,P>... > ws( PrefetchWindow<T,P>(std::get<S>(ps), w)... );
+      auto issue = [&](int64_t j) {
+        int expand[] = { 0, (std::get<S>(ws).start(j, index[j], first[j]), 0)... };
+        (void)expand;
+      };
+
+      for (int64_t j=0; j<(int64_t)w; j++) issue(j);
+      for (int64_t j=0; j<niters; j++) {
+        loop_body(index[j], first[j], std::get<S>(ws).get(j)...);
+        int expand[] = { 0, (std::get<S>(ws).finish(j), 0)... };
+        (void)expand;
+        if (j + w < niters) issue(j + w);
+      }
+    }
+
+    template< GlobalCompletionEvent * GCE, int64_t Threshold, typename T, typename F, typename... P >
+    void forall_prefetch(GlobalAddress<T> base, int64_t nelems, const std::tuple<P...>& ps, F loop_body) {
+      auto f = [loop_body,ps](int64_t start, int64_t niters, T * first) {
+        prefetch_range(loop_body, ps, typename gen_seq<sizeof...(P)>::type(), start, niters, first);
+      };
+      impl::forall<TaskMode::Bound,SyncMode::Blocking,GCE,Threshold>(base, nelems, f, &decltype(f)::operator());
+    }
+
+  } // namespace impl
+
+  /// Parallel loop over a global array whose body also reads other global arrays at
+  /// indices known ahead of time. Each task starts `Incoherent<U>::RO` acquires for the
+  /// values of the next --loop_prefetch_distance iterations before running the current one,
+  /// so a few workers keep many reads in flight instead of each blocking on a delegate.
+  ///
+  /// The body gets the iteration's global index, its element, and one value per
+  /// secondary array, in order: `void(int64_t i, T& e, const U1& v1, ...)`.
+  ///
+  /// @code
+  ///   // relabel each edge's source with its component
+  ///   forall_prefetch(src, nedges,
+  ///     prefetch(labels, [](int64_t i, const int64_t& s){ return s; }),
+  ///     [](int64_t i, int64_t& s, const int64_t& label){ s = label; });
+  /// @endcode
+  template< GlobalCompletionEvent * GCE = &impl::local_gce,
+            int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG,
+            typename T = decltype(nullptr), typename U1 = decltype(nullptr), typename I1 = decltype(nullptr),
+            typename F = decltype(nullptr) >
+  void forall_prefetch(GlobalAddress<T> base, int64_t nelems, Prefetch<U1,I1> p1, F loop_body) {
+    impl::forall_prefetch<GCE,Threshold>(base, nelems, std::make_tuple(p1), loop_body);
+  }
+
+  /// Overload for two secondary arrays.
+  template< GlobalCompletionEvent * GCE = &impl::local_gce,
+            int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG,
+            typename T = decltype(nullptr), typename U1 = decltype(nullptr), typename I1 = decltype(nullptr),
+            typename U2 = decltype(nullptr), typename I2 = decltype(nullptr),
+            typename F = decltype(nullptr) >
+  void forall_prefetch(GlobalAddress<T> base, int64_t nelems, Prefetch<U1,I1> p1, Prefetch<U2,I2> p2,
+                       F loop_body) {
+    impl::forall_prefetch<GCE,Threshold>(base, nelems, std::make_tuple(p1, p2), loop_body);
+  }
+
+  /// Overload for three secondary arrays.
+  template< GlobalCompletionEvent * GCE = &impl::local_gce,
+            int64_t Threshold = impl::USE_LOOP_THRESHOLD_FLAG,
+            typename T = decltype(nullptr), typename U1 = decltype(nullptr), typename I1 = decltype(nullptr),
+            typename U2 = decltype(nullptr), typename I2 = decltype(nullptr),
+            typename U3 = decltype(nullptr), typename I3 = decltype(nullptr),
+            typename F = decltype(nullptr) >
+  void forall_prefetch(GlobalAddress<T> base, int64_t nelems, Prefetch<U1,I1> p1, Prefetch<U2,I2> p2,
+                       Prefetch<U3,I3> p3, F loop_body) {
+    impl::forall_prefetch<GCE,Threshold>(base, nelems, std::make_tuple(p1, p2, p3), loop_body);
+  }
+
+  /// @}
+} // namespace Grappa
@@ -0,0 +1,435 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Addressing.hpp"
+#include "Collective.hpp"
+#include "GlobalAllocator.hpp"
+#include "LocaleSharedMemory.hpp"
+#include <type_traits>
+#include <algorithm>
+#include <vector>
+
+namespace Grappa {
+/// @addtogroup Containers
+/// @{
+
+/// Take the second argument (for scans that carry the previous element forward).
+template< typename T >
+T collective_last(const T& a, const T& b) {
+  return b;
+}
+
+namespace impl {
+
+  /// An element headed for position `i` of a global array.
+  template< typename T >
+  struct Indexed {
+    int64_t i;
+    T v;
+  };
+
+  /// The (partial) combination of one block of a global array, for scans.
+  /// `row` is the block's row in its core's chunk of the global heap (-1 for none);
+  /// `any` is false if nothing has been combined yet (an operator need not have an identity).
+  template< typename T >
+  struct Partial {
+    int64_t row;
+    T val;
+    bool any;
+    
+    template< T (*Op)(const T&, const T&) >
+    void combine(const T& x) {
+      val = any ? Op(val, x) : x;
+      any = true;
+    }
+  };
+
+  /// Row of the block holding local pointer `p` in this core's chunk of the global heap.
+  /// Linear global addresses are block-cyclic: block `b` is row `b / cores()` on core
+  /// `b % cores()`, so ordering blocks by (row, core) is array order.
+  inline int64_t block_row(const void * p) {
+    return (reinterpret_cast<intptr_t>(p) -
+            reinterpret_cast<intptr_t>(global_memory_chunk_base)) / block_size;
+  }
+
+  /// Called from SPMD context. Calls `f(row, first, count, index)` for each run of this
+  /// core's elements of `base[0,n)` that share a block, in array order; `index` is the
+  /// position of `first` in the array.
+  template< typename T, typename F >
+  void for_each_local_block(GlobalAddress<T> base, size_t n, F f) {
+    T * p = base.localize();
+    T * end = (base+n).localize();
+    char * chunk = static_cast<char*>(global_memory_chunk_base);
+    while (p < end) {
+      int64_t row = block_row(p);
+      T * stop = std::min(end, reinterpret_cast<T*>(chunk + (row+1)*block_size));
+      f(row, p, static_cast<size_t>(stop - p), GlobalAddress<T>::Linear(p) - base);
+      p = stop;
+    }
+  }
+
+  /// Called from SPMD context. Sends each item to core `owner(item)` and calls
+  /// `handle(item)` there for everything received, in order of source core.
+  template< typename I, typename OwnerF, typename HandleF >
+  void exchange(const std::vector<I>& items, OwnerF owner, HandleF handle) {
+    I * recv;
+    size_t nrecv = alltoallv<I>([&](size_t * counts){
+      for (auto& it : items) counts[owner(it)]++;
+    }, [&](I ** next){
+      for (auto& it : items) *next[owner(it)]++ = it;
+    }, &recv);
+    for (size_t k=0; k<nrecv; k++) handle(recv[k]);
+    locale_free(recv);
+  }
+
+  /// Called from SPMD context. Writes each `dst[it.i] = it.v`.
+  template< typename T >
+  void scatter_items(GlobalAddress<T> dst, const std::vector<Indexed<T>>& items) {
+    exchange(items, [dst](const Indexed<T>& it){ return (dst+it.i).core(); },
+                    [dst](const Indexed<T>& it){ *(dst+it.i).pointer() = it.v; });
+  }
+
+  /// Called from SPMD context. Exclusive scan across the blocks of `base[0,n)`.
+  ///
+  /// `blocks` holds a value for each of this core's blocks, in array order; each is
+  /// replaced by the combination of the values of every block before it in the array
+  /// (`any` is false only for the first block).
+  ///
+  /// The blocks form a (row, core) matrix in row-major order, so the rows are split into
+  /// one contiguous range per core. Each core combines the blocks of its range, the range
+  /// totals are exchanged and scanned, and the prefixes are sent back to the blocks' cores.
+  template< typename T, T (*Op)(const T&, const T&), typename U >
+  void scan_blocks(GlobalAddress<U> base, size_t n, std::vector<Partial<T>>& blocks) {
+    typedef Partial<T> P;
+    const Core ncores = cores();
+    const int64_t r0 = block_row(base.pointer());
+    const int64_t nrows = block_row((base+n-1).pointer()) - r0 + 1;
+    const int64_t per = (nrows + ncores - 1) / ncores;
+    auto owner = [=](const P& b){ return Core((b.row - r0) / per); };
+    
+    // gather my range of rows as a matrix of blocks (row -1 where there are none)
+    const int64_t first = r0 + mycore() * per;
+    const int64_t mine = std::max<int64_t>(0, std::min(per, r0 + nrows - first));
+    std::vector<P> matrix(mine * ncores, P{-1, T(), false});
+    {
+      P * recv;
+      std::vector<size_t> from(ncores);
+      alltoallv<P>([&](size_t * counts){
+        for (auto& b : blocks) counts[owner(b)]++;
+      }, [&](P ** next){
+        for (auto& b : blocks) *next[owner(b)]++ = b;
+      }, &recv, &from[0]);
+      size_t k = 0;
+      for (Core c = 0; c < ncores; c++) {
+        for (size_t j=0; j<from[c]; j++, k++) matrix[(recv[k].row - first)*ncores + c] = recv[k];
+      }
+      locale_free(recv);
+    }
+    
+    // exclusive scan of my range, leaving its total in `acc`
+    P acc{0, T(), false};
+    for (auto& b : matrix) {
+      if (b.row < 0) continue;
+      T x = b.val;
+      b.val = acc.val;
+      b.any = acc.any;
+      acc.template combine<Op>(x);
+    }
+    
+    // the ranges before mine
+    P carry{0, T(), false};
+    {
+      std::vector<Indexed<P>> totals;
+      for (Core c = mycore()+1; c < ncores; c++) totals.push_back(Indexed<P>{c, acc});
+      exchange(totals, [](const Indexed<P>& t){ return Core(t.i); }, [&](const Indexed<P>& t){
+        if (t.v.any) carry.template combine<Op>(t.v.val);
+      });
+    }
+    
+    // send each block's prefix back to its core, which gets them in array order
+    std::vector<Indexed<P>> prefixes;
+    for (size_t k=0; k<matrix.size(); k++) {
+      auto& b = matrix[k];
+      if (b.row < 0) continue;
+      P pre = carry;
+      if (b.any) pre.template combine<Op>(b.val);
+      prefixes.push_back(Indexed<P>{ int64_t(k % ncores), pre });
+    }
+    size_t k = 0;
+    exchange(prefixes, [](const Indexed<P>& p){ return Core(p.i); }, [&](const Indexed<P>& p){
+      blocks[k].val = p.v.val;
+      blocks[k].any = p.v.any;
+      k++;
+    });
+    CHECK_EQ(k, blocks.size());
+  }
+
+  /// Called from SPMD context. Scan `in[0,n)` into `out` (which may be `in`).
+  template< typename T, T (*Op)(const T&, const T&) >
+  void scan_local(GlobalAddress<T> in, size_t n, GlobalAddress<T> out, bool exclusive, const T& init) {
+    std::vector<Partial<T>> blocks;
+    for_each_local_block(in, n, [&](int64_t row, T * x, size_t m, int64_t i){
+      T acc = x[0];
+      for (size_t k=1; k<m; k++) acc = Op(acc, x[k]);
+      blocks.push_back(Partial<T>{row, acc, true});
+    });
+    scan_blocks<T,Op>(in, n, blocks);
+    
+    std::vector<Indexed<T>> moved;
+    size_t b = 0;
+    for_each_local_block(in, n, [&](int64_t row, T * x, size_t m, int64_t i){
+      Partial<T> acc = blocks[b++];
+      if (exclusive) {
+        T pre = acc.any ? Op(init, acc.val) : init;
+        acc.val = pre;
+        for (size_t k=0; k<m; k++) {
+          T y = x[k];
+          if (in == out) x[k] = acc.val; else moved.push_back(Indexed<T>{i+int64_t(k), acc.val});
+          acc.val = Op(acc.val, y);
+        }
+      } else {
+        for (size_t k=0; k<m; k++) {
+          acc.template combine<Op>(x[k]);
+          if (in == out) x[k] = acc.val; else moved.push_back(Indexed<T>{i+int64_t(k), acc.val});
+        }
+      }
+    });
+    if (in != out) scatter_items(out, moved);
+  }
+
+  /// Called from SPMD context. Given a flag for each of this core's elements of `in[0,n)`
+  /// (in order), calls `f(x, index, rank, flag, total)` for each of them, where `rank` is the
+  /// number of flagged elements before it in the array and `total` the number flagged in
+  /// all. Returns `total`.
+  template< typename T, typename F >
+  int64_t rank_flagged(GlobalAddress<T> in, size_t n, const std::vector<char>& flags, F f) {
+    std::vector<Partial<int64_t>> blocks;
+    size_t j = 0;
+    int64_t nflagged = 0;
+    for_each_local_block(in, n, [&](int64_t row, T * x, size_t m, int64_t i){
+      int64_t c = 0;
+      for (size_t k=0; k<m; k++) c += flags[j++];
+      blocks.push_back(Partial<int64_t>{row, c, true});
+      nflagged += c;
+    });
+    scan_blocks<int64_t,collective_add>(in, n, blocks);
+    nflagged = allreduce<int64_t,collective_add>(nflagged);
+    
+    j = 0;
+    size_t b = 0;
+    for_each_local_block(in, n, [&](int64_t row, T * x, size_t m, int64_t i){
+      int64_t rank = blocks[b].any ? blocks[b].val : 0;
+      b++;
+      for (size_t k=0; k<m; k++) {
+        f(x[k], i+int64_t(k), rank, bool(flags[j]), nflagged);
+        rank += flags[j++];
+      }
+    });
+    return nflagged;
+  }
+
+} // namespace impl
+
+/// Parallel primitives on global arrays. Called from a task (e.g. in `run()`); each runs
+/// on all cores and returns when the whole result is written.
+///
+/// Each makes one pass over every core's local elements, a block at a time (tight loops
+/// the compiler can vectorize), and combines per-block totals across cores with a single
+/// exclusive scan (impl::scan_blocks()), so only O(blocks) values cross the network,
+/// plus the elements that have to move. Data is moved with Grappa::alltoallv(), so these
+/// may not overlap with other alltoallv's of the same element type.
+///
+/// Operators are function templates like the collectives' (`collective_add`, ...); they
+/// must be associative, but need not have an identity. Outputs may be the same array as
+/// the input (everything is read before anything is written), but must not otherwise
+/// overlap it.
+
+/// Inclusive scan: `out[i] = in[0] op in[1] op ... op in[i]`.
+///
+/// @code
+///   auto xs = global_alloc<int64_t>(n);
+///   Grappa::memset(xs, 1, n);
+///   inclusive_scan(xs, n, xs);     // xs[i] == i+1
+/// @endcode
+template< typename T, T (*Op)(const T&, const T&) = collective_add<T> >
+void inclusive_scan(GlobalAddress<T> in, size_t n, GlobalAddress<T> out) {
+  if (n == 0) return;
+  on_all_cores([=]{ impl::scan_local<T,Op>(in, n, out, false, T()); });
+}
+
+/// Exclusive scan: `out[0] = init`, `out[i] = init op in[0] op ... op in[i-1]`.
+template< typename T, T (*Op)(const T&, const T&) = collective_add<T> >
+void exclusive_scan(GlobalAddress<T> in, size_t n, GlobalAddress<T> out, T init = T()) {
+  if (n == 0) return;
+  on_all_cores([=]{ impl::scan_local<T,Op>(in, n, out, true, init); });
+}
+
+/// Stream compaction: copy the elements of `in[0,n)` for which `pred(x)` holds to the
+/// front of `out`, in order. Returns how many were copied.
+template< typename T, typename Pred >
+size_t copy_if(GlobalAddress<T> in, size_t n, GlobalAddress<T> out, Pred pred) {
+  if (n == 0) return 0;
+  int64_t total;
+  auto total_p = &total;
+  auto origin = mycore();
+  on_all_cores([=]{
+    std::vector<char> flags;
+    for (auto& x : iterate_local(in, n)) flags.push_back(pred(x));
+    std::vector<impl::Indexed<T>> moved;
+    auto t = impl::rank_flagged(in, n, flags, [&](const T& x, int64_t i, int64_t rank, bool keep, int64_t total){
+      if (keep) moved.push_back(impl::Indexed<T>{rank, x});
+    });
+    impl::scatter_items(out, moved);
+    if (mycore() == origin) *total_p = t;
+  });
+  return total;
+}
+
+/// Stable partition: copy the elements of `in[0,n)` for which `pred(x)` holds to the
+/// front of `out` and the rest after them, each in their original order. Returns how
+/// many satisfied `pred`.
+template< typename T, typename Pred >
+size_t stable_partition(GlobalAddress<T> in, size_t n, GlobalAddress<T> out, Pred pred) {
+  if (n == 0) return 0;
+  int64_t total;
+  auto total_p = &total;
+  auto origin = mycore();
+  on_all_cores([=]{
+    std::vector<char> flags;
+    for (auto& x : iterate_local(in, n)) flags.push_back(pred(x));
+    std::vector<impl::Indexed<T>> moved;
+    auto t = impl::rank_flagged(in, n, flags, [&](const T& x, int64_t i, int64_t rank, bool first, int64_t total){
+      moved.push_back(impl::Indexed<T>{ first ? rank : total + (i - rank), x });
+    });
+    impl::scatter_items(out, moved);
+    if (mycore() == origin) *total_p = t;
+  });
+  return total;
+}
+
+/// Copy `in[0,n)` to `out` dropping each element equal (by `==`) to the one before it,
+/// like `std::unique_copy`. Returns how many were copied.
+template< typename T >
+size_t unique(GlobalAddress<T> in, size_t n, GlobalAddress<T> out) {
+  if (n == 0) return 0;
+  int64_t total;
+  auto total_p = &total;
+  auto origin = mycore();
+  on_all_cores([=]{
+    // each block needs the last element of the block before it
+    std::vector<impl::Partial<T>> last;
+    impl::for_each_local_block(in, n, [&](int64_t row, T * x, size_t m, int64_t i){
+      last.push_back(impl::Partial<T>{row, x[m-1], true});
+    });
+    impl::scan_blocks<T,collective_last<T>>(in, n, last);
+    
+    std::vector<char> flags;
+    size_t b = 0;
+    impl::for_each_local_block(in, n, [&](int64_t row, T * x, size_t m, int64_t i){
+      auto& prev = last[b++];
+      flags.push_back(!prev.any || !(x[0] == prev.val));
+      for (size_t k=1; k<m; k++) flags.push_back(!(x[k] == x[k-1]));
+    });
+    std::vector<impl::Indexed<T>> moved;
+    auto t = impl::rank_flagged(in, n, flags, [&](const T& x, int64_t i, int64_t rank, bool keep, int64_t total){
+      if (keep) moved.push_back(impl::Indexed<T>{rank, x});
+    });
+    impl::scatter_items(out, moved);
+    if (mycore() == origin) *total_p = t;
+  });
+  return total;
+}
+
+/// Count the elements of `in[0,n)` falling in each of `nbins` bins, where `bin(x)` gives
+/// the bin of `x` (in `[0,nbins)`).
+template< typename T, typename BinF >
+std::vector<int64_t> histogram(GlobalAddress<T> in, size_t n, size_t nbins, BinF bin) {
+  std::vector<int64_t> result(nbins);
+  auto result_p = &result;
+  auto origin = mycore();
+  on_all_cores([=]{
+    int64_t * counts = locale_alloc<int64_t>(nbins);
+    std::fill(counts, counts+nbins, 0);
+    for (auto& x : iterate_local(in, n)) {
+      auto b = bin(x);
+      DCHECK(b >= 0 && size_t(b) < nbins) << "bin " << b << " out of range";
+      counts[b]++;
+    }
+    allreduce_inplace<int64_t,collective_add>(counts, nbins);
+    if (mycore() == origin) std::copy(counts, counts+nbins, result_p->begin());
+    locale_free(counts);
+  });
+  return result;
+}
+
+/// Gather: `out[i] = src[index[i]]` for `i` in `[0,n)`.
+template< typename T >
+void gather(GlobalAddress<T> src, GlobalAddress<int64_t> index, size_t n, GlobalAddress<T> out) {
+  on_all_cores([=]{
+    // ask the owner of each src[index[i]] to send it to out[i]
+    std::vector<impl::Indexed<int64_t>> requests;
+    impl::for_each_local_block(index, n, [&](int64_t row, int64_t * x, size_t m, int64_t i){
+      for (size_t k=0; k<m; k++) requests.push_back(impl::Indexed<int64_t>{i+int64_t(k), x[k]});
+    });
+    std::vector<impl::Indexed<T>> replies;
+    impl::exchange(requests, [src](const impl::Indexed<int64_t>& r){ return (src+r.v).core(); },
+                             [&](const impl::Indexed<int64_t>& r){
+      replies.push_back(impl::Indexed<T>{r.i, *(src+r.v).pointer()});
+    });
+    impl::scatter_items(out, replies);
+  });
+}
+
+/// Scatter: `dst[index[i]] = values[i]` for `i` in `[0,n)`. If an index repeats, which of
+/// its values ends up in `dst` is unspecified.
+template< typename T >
+void scatter(GlobalAddress<T> values, GlobalAddress<int64_t> index, size_t n, GlobalAddress<T> dst) {
+  on_all_cores([=]{
+    // ask the owner of each values[i] to send it to dst[index[i]]
+    std::vector<impl::Indexed<int64_t>> requests;
+    impl::for_each_local_block(index, n, [&](int64_t row, int64_t * x, size_t m, int64_t i){
+      for (size_t k=0; k<m; k++) requests.push_back(impl::Indexed<int64_t>{i+int64_t(k), x[k]});
+    });
+    std::vector<impl::Indexed<T>> moved;
+    impl::exchange(requests, [values](const impl::Indexed<int64_t>& r){ return (values+r.i).core(); },
+                             [&](const impl::Indexed<int64_t>& r){
+      moved.push_back(impl::Indexed<T>{r.v, *(values+r.i).pointer()});
+    });
+    impl::scatter_items(dst, moved);
+  });
+}
+
+/// @}
+} // namespace Grappa
@@ -0,0 +1,111 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+/// Time the parallel primitives in Primitives.hpp on a global array of 8-byte elements,
+/// and compare stream compaction against the usual hand-rolled version (one delegate
+/// fetch-and-add on a shared counter per kept element).
+
+#include "Grappa.hpp"
+#include "Primitives.hpp"
+#include "Array.hpp"
+#include "Delegate.hpp"
+#include "ParallelLoop.hpp"
+#include "GlobalAllocator.hpp"
+#include "Metrics.hpp"
+
+DEFINE_int64( primitives_per_core, 1<<20, "Number of 8-byte elements per core" );
+
+using namespace Grappa;
+
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, scan_time, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, copy_if_time, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, fetch_add_compact_time, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, unique_time, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, histogram_time, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, gather_time, 0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, scan_gb_per_s, 0 );
+
+int main(int argc, char * argv[]) {
+  init(&argc, &argv);
+  run([]{
+    int64_t n = FLAGS_primitives_per_core * cores();
+    auto data = global_alloc<int64_t>(n);
+    auto out = global_alloc<int64_t>(n);
+    auto random = [](int64_t i) -> int64_t { return (i * 0x9E3779B97F4A7C15ULL) >> 20; };
+    
+    Grappa::memset(data, 1, n);
+    double t = walltime();
+    inclusive_scan(data, n, data);
+    scan_time = walltime() - t;
+    scan_gb_per_s = n * sizeof(int64_t) / scan_time / 1e9;
+    CHECK_EQ(delegate::read(data+n-1), n);
+    
+    forall(data, n, [=](int64_t i, int64_t& x){ x = random(i); });
+    auto keep = [](const int64_t& x){ return x % 4 == 0; };
+    t = walltime();
+    auto nkept = copy_if(data, n, out, keep);
+    copy_if_time = walltime() - t;
+    
+    int64_t next = 0;
+    auto next_addr = make_global(&next);
+    t = walltime();
+    forall(data, n, [=](int64_t& x){
+      if (keep(x)) {
+        auto j = delegate::fetch_and_add(next_addr, 1);
+        delegate::write<async>(out+j, x);
+      }
+    });
+    fetch_add_compact_time = walltime() - t;
+    CHECK_EQ(next, nkept);
+    
+    forall(data, n, [=](int64_t i, int64_t& x){ x = random(i/8) % 16; });
+    t = walltime();
+    unique(data, n, out);
+    unique_time = walltime() - t;
+    
+    t = walltime();
+    histogram(data, n, 16, [](const int64_t& x){ return x; });
+    histogram_time = walltime() - t;
+    
+    forall(data, n, [=](int64_t i, int64_t& x){ x = random(i) % n; });
+    t = walltime();
+    gather(data, data, n, out);
+    gather_time = walltime() - t;
+    
+    global_free(data);
+    global_free(out);
+    Metrics::merge_and_print();
+  });
+  finalize();
+}
@@ -0,0 +1,155 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+#include <boost/test/unit_test.hpp>
+#include "Grappa.hpp"
+#include "Primitives.hpp"
+#include "Array.hpp"
+#include "Cache.hpp"
+#include "ParallelLoop.hpp"
+#include "GlobalAllocator.hpp"
+#include <numeric>
+
+using namespace Grappa;
+
+BOOST_AUTO_TEST_SUITE( Primitives_tests );
+
+DEFINE_int64(nelems, (1L<<14) - 7, "number of elements in test arrays");
+
+/// Copy the whole global array to a local vector.
+template< typename T >
+std::vector<T> fetch(GlobalAddress<T> xs, size_t n) {
+  std::vector<T> v(n);
+  typename Incoherent<T>::RO c(xs, n, &v[0]);
+  c.block_until_acquired();
+  return v;
+}
+
+int64_t hash(int64_t i) { return (i * 0x9E3779B97F4A7C15ULL) >> 20; }
+
+/// Run the primitives on `xs[0,n)` (usually a slice of a bigger array, so it starts
+/// partway into a block) and check them against the standard library.
+void check_all(GlobalAddress<int64_t> xs, size_t n, GlobalAddress<int64_t> out) {
+  forall(xs, n, [](int64_t i, int64_t& x){ x = hash(i) % 100; });
+  auto v = fetch(xs, n);
+  std::vector<int64_t> expected(n);
+  
+  std::partial_sum(v.begin(), v.end(), expected.begin());
+  inclusive_scan(xs, n, out);
+  BOOST_CHECK(fetch(out, n) == expected);
+  
+  int64_t acc = -1000;
+  for (size_t i=0; i<n; i++) { expected[i] = acc; acc = std::max(acc, v[i]); }
+  exclusive_scan<int64_t,collective_max>(xs, n, out, -1000);
+  BOOST_CHECK(fetch(out, n) == expected);
+  
+  auto odd = [](const int64_t& x){ return x % 2 == 1; };
+  expected.assign(n, 0);
+  size_t nexpected = std::copy_if(v.begin(), v.end(), expected.begin(), odd) - expected.begin();
+  size_t nodd = copy_if(xs, n, out, odd);
+  BOOST_CHECK_EQUAL(nodd, nexpected);
+  auto actual = fetch(out, nodd);
+  BOOST_CHECK(std::equal(actual.begin(), actual.end(), expected.begin()));
+  
+  expected = v;
+  std::stable_partition(expected.begin(), expected.end(), odd);
+  BOOST_CHECK_EQUAL(stable_partition(xs, n, out, odd), nexpected);
+  BOOST_CHECK(fetch(out, n) == expected);
+  
+  std::vector<int64_t> h(10, 0);
+  for (auto x : v) h[x/10]++;
+  BOOST_CHECK(histogram(xs, n, 10, [](const int64_t& x){ return x/10; }) == h);
+  
+  // runs of repeated elements
+  forall(xs, n, [](int64_t i, int64_t& x){ x = hash(i/3) % 4; });
+  v = fetch(xs, n);
+  expected.assign(n, 0);
+  nexpected = std::unique_copy(v.begin(), v.end(), expected.begin()) - expected.begin();
+  size_t nunique = Grappa::unique(xs, n, out);
+  BOOST_CHECK_EQUAL(nunique, nexpected);
+  actual = fetch(out, nunique);
+  BOOST_CHECK(std::equal(actual.begin(), actual.end(), expected.begin()));
+  
+  // in place
+  inclusive_scan(xs, n, xs);
+  std::partial_sum(v.begin(), v.end(), expected.begin());
+  BOOST_CHECK(fetch(xs, n) == expected);
+}
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  Grappa::init( GRAPPA_TEST_ARGS );
+  Grappa::run([]{
+    size_t N = FLAGS_nelems;
+    auto xs = global_alloc<int64_t>(N);
+    auto out = global_alloc<int64_t>(N);
+    
+    BOOST_MESSAGE("primitives on a whole array");
+    check_all(xs, N, out);
+    
+    BOOST_MESSAGE("primitives on unaligned slices");
+    check_all(xs+3, N-10, out+5);
+    check_all(xs+9, 5, out);
+    check_all(xs+1, 1, out+2);
+    
+    BOOST_MESSAGE("prefix_sum of doubles");
+    {
+      auto ds = global_alloc<double>(N);
+      Grappa::memset(ds, 0.5, N);
+      prefix_sum(ds, N);
+      forall(ds, N, [](int64_t i, double& d){ BOOST_CHECK_EQUAL(d, 0.5*i); });
+      global_free(ds);
+    }
+    
+    BOOST_MESSAGE("gather and scatter");
+    {
+      auto index = global_alloc<int64_t>(N);
+      forall(index, N, [N](int64_t i, int64_t& j){ j = (i * 7919) % N; });  // a permutation
+      forall(xs, N, [](int64_t i, int64_t& x){ x = 3*i; });
+      
+      gather(xs, index, N, out);
+      forall(out, N, [N](int64_t i, int64_t& x){ BOOST_CHECK_EQUAL(x, 3*((i * 7919) % N)); });
+      
+      Grappa::memset(xs, 0, N);
+      scatter(out, index, N, xs);
+      forall(xs, N, [](int64_t i, int64_t& x){ BOOST_CHECK_EQUAL(x, 3*i); });
+      global_free(index);
+    }
+    
+    global_free(xs);
+    global_free(out);
+  });
+  Grappa::finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
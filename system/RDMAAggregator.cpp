@@ -342,8 +342,8 @@ namespace Grappa {
         compute_route_map();
       }
 
-      // make sure everything is allocated before other cores try to attach
-      global_communicator.barrier();
+      // make sure everything is allocated before other cores on this locale try to attach
+      global_communicator.locale_barrier();
 
       // other cores attach to shared data
       if( global_communicator.locale_mycore != 0 ) {
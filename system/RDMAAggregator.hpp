@@ -78,6 +78,8 @@ GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, app_messages_enqueue_cas );
 GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, app_messages_immediate );
 
 GRAPPA_DECLARE_METRIC( SummarizingMetric<int64_t>, app_nt_message_bytes );
+GRAPPA_DECLARE_METRIC( SummarizingMetric<int64_t>, app_bytes_serialized );
+GRAPPA_DECLARE_METRIC( SummarizingMetric<int64_t>, rdma_message_bytes );
 
 /// stats for RDMA Aggregator events
 GRAPPA_DECLARE_METRIC( SimpleMetric<int64_t>, rdma_capacity_flushes );
@@ -66,6 +66,7 @@ DEFINE_int64( seed, -1, "RNG seed for serialization test" );
 DEFINE_bool( permute, true, "Permute messages in serialization test" );
 DEFINE_int64( prefetch_distance, 4, "Prefetch distance for serialization test" );
 DEFINE_bool( prefetch_enable, false, "Prefetch for serialization test" );
+DEFINE_int64( encoding_messages, 1 << 16, "Messages per run of the message encoding benchmark" );
 
 DECLARE_int64( rdma_buffers_per_core );
 
@@ -103,6 +104,11 @@ GRAPPA_DEFINE_METRIC( SimpleMetric<int64_t>, aggregated_messages_per_locale, 0 )
 GRAPPA_DEFINE_METRIC( SimpleMetric<double>, aggregated_messages_time, 0.0 );
 GRAPPA_DEFINE_METRIC( SimpleMetric<double>, aggregated_messages_rate_per_locale, 0.0 );
 
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, full_encoding_bytes_per_message, 0.0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, full_encoding_messages_rate, 0.0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, compact_encoding_bytes_per_message, 0.0 );
+GRAPPA_DEFINE_METRIC( SimpleMetric<double>, compact_encoding_messages_rate, 0.0 );
+
 
 
 BOOST_AUTO_TEST_CASE( test1 ) {
@@ -442,6 +448,7 @@ BOOST_AUTO_TEST_CASE( test1 ) {
         const size_t sizeof_messages = first->serialized_size() * num_messages;
       
         std::unique_ptr< char[] > buf( new char[ sizeof_messages ] );
+        char * serialized_end = &buf[0];
       
 
         {
@@ -451,7 +458,7 @@ BOOST_AUTO_TEST_CASE( test1 ) {
           {
             // serialize
             uint64_t count = 0;
-            Grappa::impl::global_rdma_aggregator.aggregate_to_buffer( &buf[0], &first, sizeof_messages, &count);
+            serialized_end = Grappa::impl::global_rdma_aggregator.aggregate_to_buffer( &buf[0], &first, sizeof_messages, &count);
           }
       
           double time = Grappa::walltime() - start;
@@ -467,7 +474,7 @@ BOOST_AUTO_TEST_CASE( test1 ) {
 
           {
             // deserialize
-            Grappa::impl::global_rdma_aggregator.deaggregate_buffer( &buf[0], sizeof_messages );
+            Grappa::impl::global_rdma_aggregator.deaggregate_buffer( &buf[0], serialized_end - &buf[0] );
           }
       
           double time = Grappa::walltime() - start;
@@ -798,6 +805,99 @@ BOOST_AUTO_TEST_CASE( test1 ) {
   
   
 
+
+    // Message encoding: serialize and run 8-byte increments, as delegate::call<async>
+    // lambdas and as update messages, with full and compact headers. The two encodings
+    // can't be told apart on the wire, so each is only set here, around serializing and
+    // deaggregating its own buffer.
+    {
+      static int64_t counter = 0;
+      const int64_t n = FLAGS_encoding_messages;
+      auto target = make_global( &counter );
+      double bytes_per_message[2][2];
+      const bool configured = FLAGS_compact_messages;
+
+      for( int compact = 0; compact < 2; compact++ ) {
+        for( int update = 0; update < 2; update++ ) {
+          std::vector< Grappa::impl::MessageBase * > msgs( n );
+          for( int64_t i = 0; i < n; i++ ) {
+            Core origin = Grappa::mycore();
+            if( update ) {
+              msgs[i] = Grappa::impl::update_message< int64_t, collective_add >( target, 1, nullptr );
+            } else {
+              // what delegate::call<async> sends for an increment
+              int64_t inc = 1;
+              msgs[i] = Grappa::heap_message( Grappa::mycore(), [origin,target,inc]{ (*target.pointer()) += inc; } );
+            }
+            msgs[i]->source_ = Grappa::mycore();
+            msgs[i]->is_enqueued_ = true;
+            if( i > 0 ) msgs[i-1]->next_ = msgs[i];
+          }
+          std::unique_ptr< char[] > buf( new char[ n * 64 ] );
+          counter = 0;
+
+          int64_t bytes = app_bytes_serialized.value();
+          double start = Grappa::walltime();
+          Grappa::impl::MessageBase * first = msgs[0];
+          FLAGS_compact_messages = compact;
+          char * end = Grappa::impl::global_rdma_aggregator.aggregate_to_buffer( &buf[0], &first, n * 64 );
+          Grappa::impl::global_rdma_aggregator.deaggregate_buffer( &buf[0], end - &buf[0] );
+          FLAGS_compact_messages = configured;
+          double time = Grappa::walltime() - start;
+          bytes = app_bytes_serialized.value() - bytes;
+
+          BOOST_CHECK_EQUAL( counter, n );
+          BOOST_CHECK_EQUAL( bytes, end - &buf[0] );
+          bytes_per_message[compact][update] = double(bytes) / n;
+          LOG(INFO) << (compact ? "compact" : "full") << " encoding, "
+                    << (update ? "update messages" : "lambdas") << ": "
+                    << bytes_per_message[compact][update] << " bytes/message, "
+                    << n / time << " messages/s";
+          if( update ) {
+            if( compact ) {
+              compact_encoding_bytes_per_message = bytes_per_message[compact][update];
+              compact_encoding_messages_rate = n / time;
+            } else {
+              full_encoding_bytes_per_message = bytes_per_message[compact][update];
+              full_encoding_messages_rate = n / time;
+            }
+          }
+        }
+      }
+      BOOST_CHECK( bytes_per_message[1][0] < bytes_per_message[0][0] );
+      BOOST_CHECK( bytes_per_message[1][1] < bytes_per_message[0][0] );
+
+      // end to end with the configured encoding, to the next locale if there is one
+      // (otherwise messages are delivered through shared memory and neither metric counts them)
+      Core dest = (Grappa::mycore() + (Grappa::locales() > 1 ? Grappa::locale_cores() : 1)) % Grappa::cores();
+      {
+        static int64_t app_here, wire_here;
+        auto sample = [](int64_t& app, int64_t& wire) {
+          Grappa::on_all_cores([]{
+            app_here = app_bytes_serialized.value();
+            wire_here = rdma_message_bytes.value();
+          });
+          app = Grappa::reduce<int64_t,collective_add>( &app_here );
+          wire = Grappa::reduce<int64_t,collective_add>( &wire_here );
+        };
+        int64_t app0, wire0, app, wire;
+        sample( app0, wire0 );
+        double start = Grappa::walltime();
+        for( int64_t i = 0; i < FLAGS_encoding_messages; i++ ) {
+          Grappa::delegate::increment<Grappa::async>( make_global( &counter, dest ), 1 );
+        }
+        Grappa::impl::local_gce.wait();
+        double time = Grappa::walltime() - start;
+        sample( app, wire );
+        app -= app0;
+        wire -= wire0;
+        LOG(INFO) << (configured ? "compact" : "full") << " encoding, increments to core " << dest << ": "
+                  << double(app) / FLAGS_encoding_messages << " app_bytes_serialized/message, "
+                  << double(wire) / FLAGS_encoding_messages << " rdma_message_bytes/message, "
+                  << FLAGS_encoding_messages / time << " messages/s";
+      }
+    }
+
     Grappa::Metrics::merge_and_print( std::cout );
 
   });
@@ -0,0 +1,269 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+#pragma once
+
+#include "Addressing.hpp"
+#include "Barrier.hpp"
+#include "Cache.hpp"
+#include "Collective.hpp"
+#include "GlobalAllocator.hpp"
+#include "LocaleSharedMemory.hpp"
+#include <type_traits>
+#include <algorithm>
+#include <vector>
+
+namespace Grappa {
+/// @addtogroup Containers
+/// @{
+
+namespace impl {
+
+  /// Map an integral key onto an unsigned integer with the same ordering
+  /// (signed keys get their sign bit flipped so negatives sort first).
+  template< typename K >
+  inline typename std::make_unsigned<K>::type radix_key(K k) {
+    typedef typename std::make_unsigned<K>::type U;
+    const U sign = std::is_signed<K>::value ? (U(1) << (sizeof(K)*8-1)) : 0;
+    return static_cast<U>(k) ^ sign;
+  }
+
+  /// LSD radix sort on an integral key, one byte per pass. Histograms for all digits
+  /// are built in a single read of the data, and digits on which every key agrees are
+  /// skipped entirely. `tmp` must have room for `n` elements; result ends up in `xs`.
+  template< typename T, typename F >
+  void local_radix_sort(T * xs, T * tmp, size_t n, F key) {
+    typedef typename std::decay<decltype(key(*xs))>::type K;
+    const int ndigits = sizeof(K);
+    std::vector<size_t> counts(ndigits*256, 0);
+
+    for (size_t i=0; i<n; i++) {
+      auto k = radix_key(key(xs[i]));
+      for (int d=0; d<ndigits; d++) counts[d*256 + ((k >> (8*d)) & 0xff)]++;
+    }
+
+    T * src = xs, * dst = tmp;
+    for (int d=0; d<ndigits; d++) {
+      size_t * c = &counts[d*256];
+      if (std::any_of(c, c+256, [n](size_t x){ return x == n; })) continue;
+
+      size_t total = 0;
+      for (int b=0; b<256; b++) { size_t t = c[b]; c[b] = total; total += t; }
+
+      for (size_t i=0; i<n; i++) {
+        auto digit = (radix_key(key(src[i])) >> (8*d)) & 0xff;
+        dst[c[digit]++] = src[i];
+      }
+      std::swap(src, dst);
+    }
+    if (src != xs) std::copy(src, src+n, xs);
+  }
+
+  /// integer keys: radix sort
+  template< typename T, typename F >
+  void local_sort(T * xs, size_t n, F key, std::true_type) {
+    T * tmp = locale_alloc<T>(std::max<size_t>(n,1));
+    local_radix_sort(xs, tmp, n, key);
+    locale_free(tmp);
+  }
+
+  /// anything else with operator<: merge sort
+  template< typename T, typename F >
+  void local_sort(T * xs, size_t n, F key, std::false_type) {
+    std::stable_sort(xs, xs+n, [key](const T& a, const T& b){ return key(a) < key(b); });
+  }
+
+  template< typename K >
+  struct is_radix_sortable
+    : std::integral_constant<bool, std::is_integral<K>::value && !std::is_same<K,bool>::value> {};
+
+  /// Send `n` elements starting at `buf` to `dest` in message-sized pieces.
+  /// `f(offset, elements, count)` is called on `dest` for each piece.
+  ///
+  /// @warning `buf` must be in locale-shared memory and stay valid until delivered.
+  template< typename T, typename F >
+  void send_chunked(Core dest, T * buf, size_t n, F f) {
+    const size_t per_msg = std::max<size_t>(1, MAX_MESSAGE_SIZE / sizeof(T));
+    for (size_t k=0; k<n; k+=per_msg) {
+      size_t m = std::min(per_msg, n-k);
+      send_heap_message(dest, [f,k](void * payload, size_t payload_size){
+        f(k, static_cast<T*>(payload), payload_size / sizeof(T));
+      }, buf+k, m*sizeof(T));
+    }
+  }
+
+  inline size_t num_chunks(size_t n, size_t elem_size) {
+    const size_t per_msg = std::max<size_t>(1, MAX_MESSAGE_SIZE / elem_size);
+    return (n + per_msg - 1) / per_msg;
+  }
+
+  /// Per-core state for Grappa::sort (one instance per element/key type).
+  template< typename T, typename K >
+  struct SortState {
+    static CompletionEvent samples_ce, splitters_ce;
+    static std::vector<K> samples;     // (HOME_CORE only)
+    static std::vector<K> splitters;
+  };
+  template< typename T, typename K > CompletionEvent SortState<T,K>::samples_ce;
+  template< typename T, typename K > CompletionEvent SortState<T,K>::splitters_ce;
+  template< typename T, typename K > std::vector<K> SortState<T,K>::samples;
+  template< typename T, typename K > std::vector<K> SortState<T,K>::splitters;
+
+} // namespace impl
+
+/// Sort a linear global array in place by the key returned by `key_fn(const T&)`.
+///
+/// Implemented as a sample sort: each core contributes a strided sample of its keys,
+/// HOME_CORE picks `cores()-1` splitters from them, and every core bins its elements
+/// into contiguous per-destination buffers which are then exchanged in bulk with
+/// Grappa::alltoallv() (rather than one message per element). Each core sorts the
+/// partition it received -- with an LSD radix sort for integral keys and a merge sort
+/// otherwise -- and the partitions are written back in core order.
+///
+/// Must be called from a single task (not SPMD). The sort is not stable.
+///
+/// @b Example:
+/// @code
+///   struct Edge { int64_t src, dst; };
+///   GlobalAddress<Edge> edges = ...;
+///   Grappa::sort(edges, nedges, [](const Edge& e){ return e.src; });
+/// @endcode
+///
+/// @warning Only one sort over a given element/key type may be in flight at a time
+///          (uses static per-core state).
+template< typename T, typename F >
+void sort(GlobalAddress<T> base, int64_t nelems, F key_fn) {
+  typedef typename std::decay<decltype(key_fn(std::declval<const T&>()))>::type K;
+  typedef impl::SortState<T,K> S;
+  
+  if (nelems <= 0) return;
+  
+  on_all_cores([base,nelems,key_fn]{
+    T * local = base.localize();
+    size_t nlocal = (base+nelems).localize() - local;
+    
+    // set up for all the messages we'll receive before anyone can send them
+    S::splitters.resize(cores()-1);
+    if (mycore() == impl::HOME_CORE) {
+      S::samples.clear();
+      S::samples_ce.enroll(cores());
+    }
+    S::splitters_ce.enroll(impl::num_chunks(cores()-1, sizeof(K)));
+    barrier();
+    
+    // send a strided sample of local keys to HOME_CORE
+    size_t nsamples = std::min(nlocal, std::max<size_t>(1, MAX_MESSAGE_SIZE / sizeof(K)));
+    K * samples = locale_alloc<K>(std::max<size_t>(nsamples,1));
+    for (size_t i=0; i<nsamples; i++) {
+      samples[i] = key_fn(local[(2*i+1)*nlocal / (2*nsamples)]);
+    }
+    send_heap_message(impl::HOME_CORE, [](void * payload, size_t payload_size){
+      auto ks = static_cast<K*>(payload);
+      S::samples.insert(S::samples.end(), ks, ks + payload_size/sizeof(K));
+      S::samples_ce.complete();
+    }, samples, nsamples*sizeof(K));
+    
+    // HOME_CORE picks evenly-spaced splitters and broadcasts them
+    K * splitters = nullptr;
+    if (mycore() == impl::HOME_CORE) {
+      S::samples_ce.wait();
+      std::sort(S::samples.begin(), S::samples.end());
+      
+      size_t m = S::samples.size();
+      splitters = locale_alloc<K>(std::max<size_t>(cores()-1,1));
+      for (Core i=1; i<cores(); i++) {
+        splitters[i-1] = S::samples[(i*m) / cores()];
+      }
+      for (Core c=0; c<cores(); c++) {
+        impl::send_chunked(c, splitters, cores()-1, [](size_t k, K * ks, size_t n){
+          std::copy(ks, ks+n, S::splitters.begin()+k);
+          S::splitters_ce.complete();
+        });
+      }
+    }
+    S::splitters_ce.wait();
+    locale_free(samples);
+    
+    // bin local elements by destination core into one contiguous send buffer
+    std::vector<Core> dest(nlocal);
+    std::vector<size_t> send_counts(cores(), 0), send_offsets(cores(), 0);
+    for (size_t i=0; i<nlocal; i++) {
+      auto k = key_fn(local[i]);
+      dest[i] = std::upper_bound(S::splitters.begin(), S::splitters.end(), k) - S::splitters.begin();
+      send_counts[dest[i]]++;
+    }
+    for (Core c=1; c<cores(); c++) send_offsets[c] = send_offsets[c-1] + send_counts[c-1];
+    
+    T * sendbuf = locale_alloc<T>(std::max<size_t>(nlocal,1));
+    {
+      auto fill = send_offsets;
+      for (size_t i=0; i<nlocal; i++) sendbuf[fill[dest[i]]++] = local[i];
+    }
+    std::vector<Core>().swap(dest);
+    
+    // bulk exchange
+    T * recv;
+    size_t nrecv = alltoallv(sendbuf, &send_counts[0], &recv);
+    locale_free(sendbuf);
+    if (mycore() == impl::HOME_CORE) locale_free(splitters);
+    
+    impl::local_sort(recv, nrecv, key_fn, impl::is_radix_sortable<K>());
+    
+    // find where this core's partition starts
+    size_t * totals = locale_alloc<size_t>(cores());
+    std::fill(totals, totals+cores(), 0);
+    totals[mycore()] = nrecv;
+    allreduce_inplace<size_t,collective_add>(totals, cores());
+    
+    size_t offset = 0;
+    for (Core c=0; c<mycore(); c++) offset += totals[c];
+    locale_free(totals);
+    
+    const size_t nbuf = std::max<size_t>(1, (1L<<22) / sizeof(T));
+    for (size_t i=0; i<nrecv; i+=nbuf) {
+      size_t n = std::min(nbuf, nrecv-i);
+      typename Incoherent<T>::WO c(base+offset+i, n, recv+i);
+      c.block_until_released();
+    }
+    locale_free(recv);
+  });
+}
+
+/// Sort a linear global array in place by `operator<` on its elements.
+template< typename T >
+void sort(GlobalAddress<T> base, int64_t nelems) {
+  sort(base, nelems, [](const T& e){ return e; });
+}
+
+/// @}
+} // namespace Grappa
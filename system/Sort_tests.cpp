@@ -0,0 +1,129 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+#include <boost/test/unit_test.hpp>
+#include "Grappa.hpp"
+#include "Sort.hpp"
+#include "Array.hpp"
+#include "Cache.hpp"
+#include "ParallelLoop.hpp"
+#include "GlobalAllocator.hpp"
+
+using namespace Grappa;
+
+BOOST_AUTO_TEST_SUITE( Sort_tests );
+
+DEFINE_int64(nelems, (1L<<14) - 7, "number of elements in test arrays");
+
+struct Pair {
+  double key;
+  int64_t val;
+};
+
+/// Copy the whole global array to a local vector.
+template< typename T >
+std::vector<T> fetch(GlobalAddress<T> xs, size_t n) {
+  std::vector<T> v(n);
+  typename Incoherent<T>::RO c(xs, n, &v[0]);
+  c.block_until_acquired();
+  return v;
+}
+
+/// Sort `xs` both with Grappa::sort and locally, and check they agree on the keys.
+template< typename T, typename F >
+void check_sort(GlobalAddress<T> xs, size_t n, F key) {
+  auto expected = fetch(xs, n);
+  std::stable_sort(expected.begin(), expected.end(), [key](const T& a, const T& b){
+    return key(a) < key(b);
+  });
+  
+  Grappa::sort(xs, n, key);
+  
+  auto actual = fetch(xs, n);
+  for (size_t i=0; i<n; i++) {
+    BOOST_CHECK_EQUAL(key(actual[i]), key(expected[i]));
+  }
+}
+
+BOOST_AUTO_TEST_CASE( test1 ) {
+  Grappa::init( GRAPPA_TEST_ARGS );
+  Grappa::run([]{
+    size_t N = FLAGS_nelems;
+    
+    BOOST_MESSAGE("sort uint64 (radix)");
+    {
+      auto xs = global_alloc<uint64_t>(N);
+      forall(xs, N, [](int64_t i, uint64_t& x){ x = (i * 0x9E3779B97F4A7C15L) ^ (i >> 3); });
+      check_sort(xs, N, [](const uint64_t& x){ return x; });
+      
+      // already sorted, and lots of duplicates
+      check_sort(xs, N, [](const uint64_t& x){ return x; });
+      forall(xs, N, [](int64_t i, uint64_t& x){ x = i % 5; });
+      Grappa::sort(xs, N);
+      auto v = fetch(xs, N);
+      BOOST_CHECK(std::is_sorted(v.begin(), v.end()));
+      global_free(xs);
+    }
+    
+    BOOST_MESSAGE("sort int32 with negative keys (radix)");
+    {
+      auto xs = global_alloc<int32_t>(N);
+      forall(xs, N, [N](int64_t i, int32_t& x){ x = (int32_t)((i * 7919) % N) - (int32_t)(N/2); });
+      check_sort(xs, N, [](const int32_t& x){ return x; });
+      global_free(xs);
+    }
+    
+    BOOST_MESSAGE("sort structs by double key (merge sort)");
+    {
+      auto ps = global_alloc<Pair>(N);
+      forall(ps, N, [](int64_t i, Pair& p){
+        p.key = ((i * 104729) % 1000) / 7.0 - 50;
+        p.val = i;
+      });
+      check_sort(ps, N, [](const Pair& p){ return p.key; });
+      global_free(ps);
+    }
+    
+    BOOST_MESSAGE("sort tiny array");
+    {
+      auto xs = global_alloc<int64_t>(3);
+      forall(xs, 3, [](int64_t i, int64_t& x){ x = 3-i; });
+      check_sort(xs, 3, [](const int64_t& x){ return x; });
+      global_free(xs);
+    }
+  });
+  Grappa::finalize();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -61,6 +61,7 @@ DECLARE_uint64( num_starting_workers );
 
 GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tasks_heap_allocated);
 GRAPPA_DECLARE_METRIC(SimpleMetric<uint64_t>, tasks_created);
+GRAPPA_DECLARE_METRIC(MaxMetric<double>, startup_workers_time);
 
 ///
 /// Task routines
@@ -225,7 +226,10 @@ void run(FP fp) {
   }
 
   // spawn starting number of worker coroutines
+  // (with --lazy_workers, the scheduler spawns them as tasks need them)
+  double workers_start = Grappa::walltime();
   Grappa::impl::global_scheduler.createWorkers( FLAGS_num_starting_workers );
+  startup_workers_time.add( Grappa::walltime() - workers_start );
   Grappa::impl::global_scheduler.allow_active_workers(-1); // allow all workers to be active
   
   StateTimer::init();
@@ -42,6 +42,7 @@
 #include "LocaleSharedMemory.hpp"
 
 DEFINE_int64( stack_size, MIN_STACK_SIZE, "Default stack size" );
+DEFINE_bool( clear_stacks, false, "Zero each worker stack when it is spawned, rather than leaving its pages untouched until used" );
 
 namespace Grappa {
 namespace impl {
@@ -117,6 +118,7 @@ Worker * convert_to_master( Worker * me ) {
   me->next = NULL;
   me->id = 0; // master is id 0 
   me->done = false;
+  me->cached_reads = false;
 
 #ifdef GRAPPA_TRACE 
   master->tau_taskid=0;
@@ -137,6 +139,8 @@ void coro_spawn(Worker * me, Worker * c, coro_func f, size_t ssize) {
   c->running = 0;
   c->suspended = 0;
   c->idle = 0;
+  c->cached_reads = false;
+  c->next = NULL;
 
   // allocate stack and guard page
   c->base = Grappa::impl::locale_shared_memory.allocate_aligned( ssize+4096*2, 4096 );
@@ -159,8 +163,9 @@ void coro_spawn(Worker * me, Worker * c, coro_func f, size_t ssize) {
   c->valgrind_stack_id = VALGRIND_STACK_REGISTER( (char *) c->base + 4096, c->stack );
 #endif
 
-  // clear stack
-  memset(c->base, 0, ssize+4096*2);
+  // clear stack (only for debugging: nothing reads a stack before
+  // writing it, and zeroing faults in every page of every stack up front)
+  if( FLAGS_clear_stacks ) memset(c->base, 0, ssize+4096*2);
 
 #ifdef GUARD_PAGES_ON_STACK
   // arm guard page
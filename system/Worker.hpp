@@ -101,6 +101,9 @@ class Worker {
   Scheduler * sched; 
   bool done;
 
+  // blocking delegate reads go through the global cache (see GlobalCache.hpp)
+  bool cached_reads;
+
   /* used less often */
   // start of the stack
   void * base;
@@ -93,7 +93,12 @@ namespace Grappa {
   enum class TaskMode { Bound /*default*/, Unbound };
     
   /// Specify whether an operation blocks until complete, or returns "immediately".
-  enum class SyncMode { Blocking /*default*/, Async };
+  /// `Combining` is async, merging with pending updates to the same address where
+  /// supported (see delegate::combine); elsewhere it behaves like `Async`.
+  enum class SyncMode { Blocking /*default*/, Async, Combining };
+
+  /// Whether operations in mode `s` return before they complete (`Async` or `Combining`).
+  constexpr bool is_async( SyncMode s ) { return s != SyncMode::Blocking; }
     
   
 /// "Universal" wallclock time (works at least for Mac, and most Linux)
@@ -181,6 +186,15 @@ namespace bittwiddle {
 
     return r;
   }
+
+  /// 64-bit finalizer from MurmurHash3: every input bit affects every
+  /// output bit, so nearby or strided keys spread over buckets.
+  inline uint64_t mix64( uint64_t x ) {
+    x ^= x >> 33; x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33; x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+  }
 }
 
 /// Read 64-bit timestamp counter.
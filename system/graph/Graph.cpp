@@ -34,3 +34,7 @@
 
 #include "Graph.hpp"
 
+
+DEFINE_double(graph_adj_slack, 0.25, "Spare room left for each vertex's adjacencies when a Graph is compacted after updates (fraction of its degree)");
+DEFINE_double(graph_compact_threshold, 0.5, "Compact a core's Graph adjacencies once vertices that outgrew their slots hold this fraction of its buffer");
+DEFINE_bool(graph_partition_metrics, false, "Report the replication factor and edge balance of each Graph's partition (costs a pass over its edges and a few allreduces)");
@@ -43,11 +43,18 @@
 #include <AsyncDelegate.hpp>
 #include <Array.hpp>
 #include "TupleGraph.hpp"
+#include "Partition.hpp"
 
+#include <cmath>
 #include <algorithm>
+#include <unordered_set>
 #include <iomanip>
 
 // #define USE_MPI3_COLLECTIVES
+DECLARE_double(graph_adj_slack);
+DECLARE_double(graph_compact_threshold);
+DECLARE_bool(graph_partition_metrics);
+
 #undef USE_MPI3_COLLECTIVES
 #ifdef USE_MPI3_COLLECTIVES
 #include <mpi.h>
@@ -63,6 +70,9 @@ namespace Grappa {
   /// Empty struct, for specifying lack of either Vertex or Edge data in @ref Graph.
   struct Empty {};
   
+  /// What apply_edge_batch() does with its edges.
+  enum class EdgeOp { Insert, Delete };
+  
   namespace impl {
     
     struct VertexBase {
@@ -248,6 +258,17 @@ namespace Grappa {
   /// 
   /// });
   /// ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+  /// 
+  /// Updates
+  /// --------
+  /// 
+  /// Edges can be inserted or deleted in batches with apply_edge_batch(),
+  /// between (not during) parallel iterations; vertex data is untouched.
+  /// Adjacencies stay sorted and de-duplicated. A vertex that outgrows its
+  /// slot in the core's compact adjacency buffer moves to a block of its own
+  /// with room to grow; once those blocks hold more than
+  /// `--graph_compact_threshold` of the buffer, the core compacts everything
+  /// back into one buffer, leaving `--graph_adj_slack` spare room per vertex.
   template< typename V = Empty, typename E = Empty >
   struct Graph {
     
@@ -275,10 +296,13 @@ namespace Grappa {
     // Fields
     GlobalAddress<Vertex> vs;
     int64_t nv, nadj, nadj_local;
+    bool directed;
   
     // Internal fields
     VertexID * adj_buf;
     EdgeState * edge_storage;
+    int64_t adj_buf_sz;     // slots in adj_buf/edge_storage
+    int64_t overflow_sz;    // slots in vertices' own blocks (outside adj_buf)
     
     // Temporary internal state
     void* scratch;
@@ -291,19 +315,20 @@ namespace Grappa {
       , nv(nv)
       , nadj(0)
       , nadj_local(0)
+      , directed(false)
       , adj_buf(nullptr)
+      , edge_storage(nullptr)
+      , adj_buf_sz(0)
+      , overflow_sz(0)
       , scratch(nullptr)
     { }
   
     ~Graph() {
-      for (Vertex& v : iterate_local(vs, nv)) { v.~Vertex(); }
-      if (edge_storage) {
-        for (int64_t i=0; i<nadj_local; i++) {
-          edge_storage[i].~E();
-        }
-        locale_free(edge_storage);
+      for (Vertex& v : iterate_local(vs, nv)) {
+        free_overflow(v);
+        v.~Vertex();
       }
-      if (adj_buf) locale_free(adj_buf);
+      free_buf();
     }
   
     void destroy() {
@@ -367,7 +392,7 @@ namespace Grappa {
     }
     
     // Constructor
-    static GlobalAddress<Graph> create(const TupleGraph& tg, bool directed = false, bool solo_invalid = true);
+    static GlobalAddress<Graph> create(const TupleGraph& tg, bool directed = false, bool solo_invalid = true, int64_t min_nv = 0);
     
     static GlobalAddress<Graph> Undirected(const TupleGraph& tg) { return create(tg, false); }
     static GlobalAddress<Graph> Directed(const TupleGraph& tg) { return create(tg, true); }
@@ -381,6 +406,132 @@ namespace Grappa {
       return Edge{ j, vs+j, v.local_edge_state[i] };
     }
     
+    /// Merge the sorted, distinct adjacencies `js[0,n)` into (or, for
+    /// EdgeOp::Delete, out of) local vertex `v`, calling `changed(v, j)` for
+    /// each one actually added or removed (while they are being moved, so it
+    /// must not look at `v`'s adjacencies); returns how many were.
+    template< typename F >
+    int64_t merge_adj(Vertex& v, const VertexID * js, int64_t n, EdgeOp op, F changed) {
+      auto adj = v.local_adj;
+      auto es = v.local_edge_state;
+      int64_t count = 0;
+      
+      if (op == EdgeOp::Delete) {
+        int64_t w = 0, k = 0;
+        for (int64_t r = 0; r < v.nadj; r++) {
+          while (k < n && js[k] < adj[r]) k++;
+          if (k < n && js[k] == adj[r]) {
+            changed(v, adj[r]);
+            count++;
+          } else {
+            if (w != r) {
+              adj[w] = adj[r];
+              es[w] = std::move(es[r]);
+            }
+            w++;
+          }
+        }
+        v.nadj = w;
+        nadj_local -= count;
+        return count;
+      }
+      
+      for (int64_t k = 0, r = 0; k < n; k++) {
+        while (r < v.nadj && adj[r] < js[k]) r++;
+        if (r == v.nadj || adj[r] != js[k]) {
+          changed(v, js[k]);
+          count++;
+        }
+      }
+      if (count == 0) return 0;
+      if (v.nadj + count > v.local_sz) {
+        grow(v, std::max(v.nadj + count, 2*v.local_sz));
+        adj = v.local_adj;
+        es = v.local_edge_state;
+      }
+      // merge from the back, so nothing is overwritten before it moves
+      int64_t r = v.nadj-1, w = v.nadj+count-1;
+      for (int64_t k = n-1; k >= 0; k--) {
+        while (r >= 0 && adj[r] > js[k]) {
+          adj[w] = adj[r];
+          es[w--] = std::move(es[r--]);
+        }
+        if (r >= 0 && adj[r] == js[k]) continue;
+        adj[w] = js[k];
+        es[w--] = EdgeState();
+      }
+      v.nadj += count;
+      nadj_local += count;
+      return count;
+    }
+    
+    /// Move this core's adjacencies back into one buffer (with slack). Call
+    /// on all cores, outside of any iteration over the graph.
+    void compact() {
+      auto local_vs = iterate_local(vs, nv);
+      auto room = [](int64_t nadj){ return nadj + static_cast<int64_t>(std::ceil(nadj*FLAGS_graph_adj_slack)); };
+      int64_t sz = 0;
+      for (Vertex& v : local_vs) sz += room(v.nadj);
+      
+      auto buf = locale_alloc<VertexID>(sz);
+      auto storage = locale_alloc<EdgeState>(sz);
+      int64_t offset = 0;
+      for (Vertex& v : local_vs) {
+        for (int64_t i=0; i<v.nadj; i++) {
+          buf[offset+i] = v.local_adj[i];
+          new (storage+offset+i) EdgeState(std::move(v.local_edge_state[i]));
+        }
+        for (int64_t i=v.nadj; i<room(v.nadj); i++) new (storage+offset+i) EdgeState();
+        free_overflow(v);
+        v.local_adj = buf + offset;
+        v.local_edge_state = storage + offset;
+        v.local_sz = room(v.nadj);
+        offset += v.local_sz;
+      }
+      free_buf();
+      adj_buf = buf;
+      edge_storage = storage;
+      adj_buf_sz = sz;
+      overflow_sz = 0;
+    }
+    
+  private:
+    bool in_buf(Vertex& v) {
+      return v.local_sz == 0 || (v.local_adj >= adj_buf && v.local_adj < adj_buf+adj_buf_sz);
+    }
+    
+    /// move `v`'s adjacencies to a block of its own, with room for `sz`
+    void grow(Vertex& v, int64_t sz) {
+      auto adj = new VertexID[sz];
+      auto es = new EdgeState[sz];
+      for (int64_t i=0; i<v.nadj; i++) {
+        adj[i] = v.local_adj[i];
+        es[i] = std::move(v.local_edge_state[i]);
+      }
+      free_overflow(v);
+      v.local_adj = adj;
+      v.local_edge_state = es;
+      v.local_sz = sz;
+      overflow_sz += sz;
+    }
+    
+    void free_overflow(Vertex& v) {
+      if (in_buf(v)) return;
+      delete[] v.local_adj;
+      delete[] v.local_edge_state;
+      overflow_sz -= v.local_sz;
+    }
+    
+    void free_buf() {
+      if (edge_storage) {
+        for (int64_t i=0; i<adj_buf_sz; i++) {
+          edge_storage[i].~E();
+        }
+        locale_free(edge_storage);
+      }
+      if (adj_buf) locale_free(adj_buf);
+    }
+    
   } GRAPPA_BLOCK_ALIGNED;  
   
   ////////////////////////////////////////////////////
@@ -431,7 +582,7 @@ namespace Grappa {
       if (v.core() == mycore()) {
         loop();
       } else {
-        if (S == SyncMode::Async) {
+        if (is_async(S)) {
           spawnRemote<nullptr>(v.core(), [loop]{ loop(); });
         } else {
           CompletionEvent ce(1);
@@ -616,9 +767,15 @@ namespace Grappa {
   /// @param solo_invalid  mark vertices with no in- or out-edges as 
   ///                      invalid (not to be visited when iterating 
   ///                      over vertices)
+  /// @param min_nv        make at least this many vertices (e.g. to leave
+  ///                      room for ones only later edge batches mention)
+  ///
+  /// Edges always follow their source vertex (a 1D edge cut); --vertex_cut
+  /// only applies to GraphlabGraph, since Graph's vertices are addressed at
+  /// vs+id and can't be split across cores.
   template< typename V, typename E >
   GlobalAddress<Graph<V,E>> Graph<V,E>::create(const TupleGraph& tg,
-      bool directed, bool solo_invalid) {
+      bool directed, bool solo_invalid, int64_t min_nv) {
     VLOG(1) << "Graph: " << (directed ? "directed" : "undirected");
     double t;
     auto g = symmetric_global_alloc<Graph>();
@@ -629,15 +786,16 @@ namespace Grappa {
       if (e.v0 > g->nv) { g->nv = e.v0; }
       if (e.v1 > g->nv) { g->nv = e.v1; }
     });
-    on_all_cores([g]{
-      g->nv = Grappa::allreduce<int64_t,collective_max>(g->nv) + 1;
+    on_all_cores([g,min_nv]{
+      g->nv = std::max(Grappa::allreduce<int64_t,collective_max>(g->nv) + 1, min_nv);
     });
         VLOG(2) << "find_nv_time: " << walltime() - t;
 
     auto vs = global_alloc<Vertex>(g->nv);
     auto self = g;
-    on_all_cores([g,vs]{
+    on_all_cores([g,vs,directed]{
       new (g.localize()) Graph(g, vs, g->nv);
+      g->directed = directed;
       for (Vertex& v : iterate_local(g->vs, g->nv)) {
         new (&v) Vertex();
       }
@@ -744,6 +902,7 @@ namespace Grappa {
       // allocate storage for local vertices' adjacencies
       g->adj_buf = locale_alloc<VertexID>(g->nadj_local);
       g->edge_storage = locale_alloc<EdgeState>(g->nadj_local);
+      g->adj_buf_sz = g->nadj_local;
       
       // default-initialize edges
       // TODO: import edge info from TupleGraph
@@ -774,6 +933,21 @@ namespace Grappa {
       // then those with only incoming edges (reachable from at least one active vertex)
       forall(g, [](Edge& e, Vertex& ve){ ve.valid = true; });
     }    
+    
+    // 1D edge cut: each vertex's out-edges live with it, so a vertex is present
+    // on its own core and (as a ghost) on every core with an edge to it
+    if (FLAGS_graph_partition_metrics) on_all_cores([g]{
+      std::unordered_set<VertexID> present;
+      int64_t nvalid = 0;
+      for (Vertex& v : iterate_local(g->vs, g->nv)) {
+        if (!v.valid) continue;
+        nvalid++;
+        present.insert(g->id(v));
+        for (int64_t i=0; i<v.nadj; i++) present.insert(v.local_adj[i]);
+      }
+      nvalid = allreduce<int64_t,collective_add>(nvalid);
+      report_partition("1d", g->nadj_local, present.size(), nvalid);
+    });
     VLOG(1) << "-- vertices: " << g->nv;
     
     auto gsz = Vertex::global_heap_size()*g->nv
@@ -788,5 +962,89 @@ namespace Grappa {
     return g;
   }
   
+  namespace impl {
+    /// adjacencies routed to this core by apply_edge_batch(): (vertex, neighbor)
+    inline std::vector<std::pair<VertexID,VertexID>>& staged_adj() {
+      static std::vector<std::pair<VertexID,VertexID>> staged;
+      return staged;
+    }
+    inline int64_t& staged_changes() {
+      static int64_t n;
+      return n;
+    }
+  }
+  
+  /// @brief Insert or delete a batch of edges in a Graph.
+  /// 
+  /// Each edge goes to the core of its source (and, for undirected graphs,
+  /// of its destination), where the core's whole batch is sorted and merged
+  /// into each vertex's adjacencies at once; then a core whose adjacencies
+  /// have spread out too far compacts them (see Graph "Updates").
+  /// Inserting an edge that exists, or deleting one that doesn't, does
+  /// nothing; inserted edges have default-constructed edge state.
+  /// 
+  /// `changed(Vertex& v, VertexID j)` is called on `v`'s core for each
+  /// adjacency `j` actually added to or removed from `v`, so incremental
+  /// analyses can see what changed (e.g. to hook newly connected
+  /// components, or relax the levels across new edges). It runs in a task
+  /// with the batch half-applied: it must not block or touch the graph.
+  /// 
+  /// Vertices stay valid once they have been; inserting an edge to an
+  /// invalid vertex makes it valid. Must not run during an iteration over
+  /// the graph. Returns the number of adjacencies added or removed.
+  template< typename V, typename E, typename F >
+  int64_t apply_edge_batch(GlobalAddress<Graph<V,E>> g, GlobalAddress<TupleGraph::Edge> edges,
+                           int64_t n, EdgeOp op, F changed) {
+    using Vertex = typename Graph<V,E>::Vertex;
+    
+    forall(edges, n, [g,op](TupleGraph::Edge& e){
+      CHECK_LT(e.v0, g->nv); CHECK_LT(e.v1, g->nv);
+      auto stage = [g](VertexID i, VertexID j){
+        delegate::call<SyncMode::Async>((g->vs+i).core(), [i,j]{
+          impl::staged_adj().emplace_back(i, j);
+        });
+      };
+      stage(e.v0, e.v1);
+      if (!g->directed) {
+        stage(e.v1, e.v0);
+      } else if (op == EdgeOp::Insert) {
+        delegate::call<SyncMode::Async>(g->vs+e.v1, [](Vertex& v){ v.valid = true; });
+      }
+    });
+    
+    on_all_cores([g,op,changed]{
+      auto& staged = impl::staged_adj();
+      std::sort(staged.begin(), staged.end());
+      staged.erase(std::unique(staged.begin(), staged.end()), staged.end());
+      
+      int64_t count = 0;
+      std::vector<VertexID> js;
+      for (size_t a = 0, b; a < staged.size(); a = b) {
+        js.clear();
+        for (b = a; b < staged.size() && staged[b].first == staged[a].first; b++) {
+          js.push_back(staged[b].second);
+        }
+        auto& v = *(g->vs+staged[a].first).pointer();
+        count += g->merge_adj(v, js.data(), js.size(), op, changed);
+        if (op == EdgeOp::Insert) v.valid = true;
+      }
+      std::vector<std::pair<VertexID,VertexID>>().swap(staged);
+      
+      if (g->overflow_sz > FLAGS_graph_compact_threshold * g->adj_buf_sz) {
+        VLOG(2) << "compacting: " << g->overflow_sz << " slots outside of a " << g->adj_buf_sz << " slot buffer";
+        g->compact();
+      }
+      g->nadj = allreduce<int64_t,collective_add>(g->nadj_local);
+      impl::staged_changes() = allreduce<int64_t,collective_add>(count);
+    });
+    return impl::staged_changes();
+  }
+  
+  template< typename V, typename E >
+  int64_t apply_edge_batch(GlobalAddress<Graph<V,E>> g, GlobalAddress<TupleGraph::Edge> edges,
+                           int64_t n, EdgeOp op) {
+    return apply_edge_batch(g, edges, n, op, [](typename Graph<V,E>::Vertex& v, VertexID j){});
+  }
+  
   /// @}
 } // namespace Grappa
@@ -62,6 +62,8 @@ GRAPPA_DEFINE_METRIC(SummarizingMetric<int64_t>, degree, 0);
 GRAPPA_DEFINE_METRIC(SummarizingMetric<double>, edge_weight, 0);
 
 BOOST_AUTO_TEST_CASE( test1 ) {
+  // have Graph::create report its partition, too
+  FLAGS_graph_partition_metrics = true;
   init( GRAPPA_TEST_ARGS );
   run([]{
     int64_t total;
@@ -176,6 +178,80 @@ BOOST_AUTO_TEST_CASE( test1 ) {
       count += (total > 0);
     });
     
+    ////////////////////////////////////////////////////
+    // vertex cuts: every edge assigned, roughly balanced
+    BOOST_CHECK( partition_replication_factor.value() >= 1.0 );
+    
+    for (auto cut : {VertexCut::Hash, VertexCut::Grid, VertexCut::Greedy, VertexCut::HDRF}) {
+      on_all_cores([tg,cut]{
+        std::vector<size_t> loads(cores(), 0);
+        VertexCutPartitioner part(cut, loads.data());
+        for (auto& e : iterate_local(tg.edges, tg.nedge)) {
+          auto c = part.assign(e.v0, e.v1);
+          BOOST_CHECK( c >= 0 && c < cores() );
+        }
+        int64_t n = 0;
+        for (auto l : loads) n += l;
+        BOOST_CHECK_EQUAL( n, iterate_local(tg.edges, tg.nedge).size() );
+        BOOST_CHECK( *std::max_element(loads.begin(), loads.end()) * cores() <= n * 3 / 2 );
+      });
+    }
+    
+    ////////////////////////////////////////////////////////////////////
+    // updates: inserting the second half of the edges in batches gives the
+    // same adjacencies as building from all of them; deleting them removes
+    // every one (small slack, so vertices outgrow slots and get compacted)
+    auto slack = FLAGS_graph_adj_slack;
+    call_on_all_cores([]{ FLAGS_graph_adj_slack = 0.1; });
+    auto half = tg.nedge / 2;
+    TupleGraph first = tg;
+    first.nedge = half;
+    auto gf = MyGraph::create(tg);
+    // (room for vertices only the later batches mention)
+    auto gi = MyGraph::create(first, false, true, gf->nv);
+    BOOST_CHECK_EQUAL( gi->nv, gf->nv );
+    
+    call_on_all_cores([]{ count = 0; });
+    int64_t added = 0;
+    for (int64_t b = half; b < tg.nedge; b += half/4) {
+      auto n = std::min(half/4, tg.nedge - b);
+      added += apply_edge_batch(gi, tg.edges+b, n, EdgeOp::Insert,
+                                [](MyGraph::Vertex& v, VertexID j){ count++; });
+    }
+    total = reduce<int64_t,collective_add>(&count);
+    BOOST_CHECK_EQUAL( total, added );
+    BOOST_CHECK_EQUAL( gi->nadj, gf->nadj );
+    
+    auto digest = [](MyGraph::Vertex& v){
+      int64_t h = v.nadj;
+      for (int64_t k=0; k<v.nadj; k++) {
+        if (k > 0) CHECK_LT(v.local_adj[k-1], v.local_adj[k]);
+        h = h * 1000003 + v.local_adj[k];
+      }
+      return h;
+    };
+    forall(gf, [gi,digest](VertexID i, MyGraph::Vertex& v){
+      auto h = digest(v);
+      auto hi = delegate::call(gi->vs+i, [digest](MyGraph::Vertex& u){ return digest(u); });
+      CHECK_EQ(hi, h) << "adjacencies of " << i << " differ";
+    });
+    
+    apply_edge_batch(gi, tg.edges+half, tg.nedge-half, EdgeOp::Delete);
+    forall(tg.edges+half, tg.nedge-half, [gi](TupleGraph::Edge& e){
+      auto j = e.v1;
+      auto found = delegate::call(gi->vs+e.v0, [j](MyGraph::Vertex& v){
+        return std::binary_search(v.local_adj, v.local_adj+v.nadj, j);
+      });
+      CHECK( !found ) << "deleted edge " << e.v0 << " -> " << e.v1;
+    });
+    call_on_all_cores([]{ count = 0; });
+    forall(gi, [](MyGraph::Vertex& v){ count += v.nadj; });
+    total = reduce<int64_t,collective_add>(&count);
+    BOOST_CHECK_EQUAL( total, gi->nadj );
+    gf->destroy();
+    gi->destroy();
+    call_on_all_cores([slack]{ FLAGS_graph_adj_slack = slack; });
+    
     LOG(INFO) << degree;
     Metrics::merge_and_dump_to_file();
     
@@ -0,0 +1,164 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+#include "Partition.hpp"
+
+DEFINE_string(vertex_cut, "greedy", "Vertex-cut strategy for split-vertex graphs: hash, grid, greedy or hdrf");
+DEFINE_double(hdrf_lambda, 1.0, "Weight of load balance against replication in the hdrf vertex cut");
+
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, partition_replication_factor, 0);
+GRAPPA_DEFINE_METRIC(SimpleMetric<double>, partition_edge_balance, 0);
+
+namespace Grappa {
+
+VertexCut vertex_cut(const std::string& name) {
+  if (name == "hash")   return VertexCut::Hash;
+  if (name == "grid")   return VertexCut::Grid;
+  if (name == "greedy") return VertexCut::Greedy;
+  if (name == "hdrf")   return VertexCut::HDRF;
+  LOG(FATAL) << "unknown vertex cut '" << name << "' (expected hash, grid, greedy or hdrf)";
+  return VertexCut::Greedy;
+}
+
+const char * vertex_cut_name(VertexCut s) {
+  switch (s) {
+    case VertexCut::Hash:   return "hash";
+    case VertexCut::Grid:   return "grid";
+    case VertexCut::Greedy: return "greedy";
+    case VertexCut::HDRF:   return "hdrf";
+  }
+  return "?";
+}
+
+VertexCutPartitioner::VertexCutPartitioner(VertexCut strategy, size_t * loads,
+                                           uint64_t (*tie_hash)(int64_t u, int64_t v))
+  : strategy(strategy)
+  , ncores(cores())
+  , loads(loads)
+  , rows(1)
+  , cols(cores())
+  , score(cores())
+  , tie_hash(tie_hash)
+{
+  // most nearly square grid with exactly one cell per core
+  for (int64_t r = 1; r * r <= ncores; r++) {
+    if (ncores % r == 0) { rows = r; cols = ncores / r; }
+  }
+}
+
+Core VertexCutPartitioner::best(int64_t u, int64_t v) const {
+  double top = *std::max_element(score.begin(), score.end());
+  std::vector<Core> tied;
+  for (Core c = 0; c < ncores; c++) {
+    if (std::fabs(score[c] - top) < 1e-5) tied.push_back(c);
+  }
+  return tied[(tie_hash ? tie_hash(u,v) : edge_hash(u,v)) % tied.size()];
+}
+
+Core VertexCutPartitioner::assign_grid(int64_t u, int64_t v) const {
+  auto cell = [this](int64_t x){ return int64_t(bittwiddle::mix64(x) % ncores); };
+  auto cu = cell(u), cv = cell(v);
+  // the cores in u's row and v's column, and in v's row and u's column
+  Core c0 = (cu / cols) * cols + (cv % cols);
+  Core c1 = (cv / cols) * cols + (cu % cols);
+  if (loads[c0] != loads[c1]) return loads[c0] < loads[c1] ? c0 : c1;
+  return (edge_hash(u,v) & 1) ? c0 : c1;
+}
+
+Core VertexCutPartitioner::assign(int64_t u, int64_t v) {
+  auto& pu = placed[u];
+  auto& pv = placed[v];
+  pu.degree++; pv.degree++;
+  
+  Core c;
+  switch (strategy) {
+    case VertexCut::Hash:
+      c = edge_hash(u,v) % ncores;
+      break;
+    case VertexCut::Grid:
+      c = assign_grid(u,v);
+      break;
+    case VertexCut::Greedy: {
+      // (after GraphLab's edge_to_core_greedy: counts a vertex's hash core as
+      // a placement, and balance only breaks ties among equal placements)
+      size_t lo = *std::min_element(loads, loads+ncores);
+      size_t hi = *std::max_element(loads, loads+ncores);
+      for (Core i = 0; i < ncores; i++) {
+        bool su = pu.on(i) || (Core(u % ncores) == i);
+        bool sv = pv.on(i) || (Core(v % ncores) == i);
+        double bal = (hi - loads[i]) / (1.0 + hi - lo);
+        score[i] = bal + su + sv;
+      }
+      c = best(u,v);
+      break;
+    }
+    case VertexCut::HDRF: {
+      size_t lo = *std::min_element(loads, loads+ncores);
+      size_t hi = *std::max_element(loads, loads+ncores);
+      double tu = double(pu.degree) / (pu.degree + pv.degree);
+      double tv = 1.0 - tu;
+      for (Core i = 0; i < ncores; i++) {
+        // keeping the lower-degree endpoint together is worth more
+        double rep = (pu.on(i) ? 1 + (1 - tu) : 0) + (pv.on(i) ? 1 + (1 - tv) : 0);
+        double bal = FLAGS_hdrf_lambda * (hi - loads[i]) / (1.0 + hi - lo);
+        score[i] = rep + bal;
+      }
+      c = best(u,v);
+      break;
+    }
+  }
+  
+  CHECK_LT(c, ncores);
+  pu.add(c);
+  pv.add(c);
+  loads[c]++;
+  return c;
+}
+
+void report_partition(const char * name, int64_t local_edges, int64_t local_verts, int64_t nv) {
+  auto total_edges = allreduce<int64_t,collective_add>(local_edges);
+  auto max_edges = allreduce<int64_t,collective_max>(local_edges);
+  auto copies = allreduce<int64_t,collective_add>(local_verts);
+  
+  partition_replication_factor = nv ? double(copies) / nv : 0;
+  partition_edge_balance = total_edges ? double(max_edges) * cores() / total_edges : 0;
+  
+  if (mycore() == 0) {
+    VLOG(0) << "partition: " << name
+            << ", replication_factor: " << partition_replication_factor.value()
+            << ", edge_balance: " << partition_edge_balance.value();
+  }
+}
+
+} // namespace Grappa
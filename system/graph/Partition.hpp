@@ -0,0 +1,133 @@
+////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2010-2015, University of Washington and Battelle
+// Memorial Institute.  All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions
+// are met:
+//     * Redistributions of source code must retain the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer.
+//     * Redistributions in binary form must reproduce the above
+//       copyright notice, this list of conditions and the following
+//       disclaimer in the documentation and/or other materials
+//       provided with the distribution.
+//     * Neither the name of the University of Washington, Battelle
+//       Memorial Institute, or the names of their contributors may be
+//       used to endorse or promote products derived from this
+//       software without specific prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+// "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+// LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+// FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE
+// UNIVERSITY OF WASHINGTON OR BATTELLE MEMORIAL INSTITUTE BE LIABLE
+// FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+// OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+// BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+// LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+// USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+// DAMAGE.
+////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <Collective.hpp>
+#include <Metrics.hpp>
+
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+
+DECLARE_string(vertex_cut);
+DECLARE_double(hdrf_lambda);
+
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, partition_replication_factor);
+GRAPPA_DECLARE_METRIC(SimpleMetric<double>, partition_edge_balance);
+
+namespace Grappa {
+  /// @addtogroup Graph
+  /// @{
+  
+  /// Strategies for assigning edges to cores at graph ingress (vertex cuts:
+  /// each edge lives on one core, and a vertex is replicated on every core
+  /// holding one of its edges).
+  ///
+  /// - Hash:   edge goes to a hash of its endpoints (random vertex cut)
+  /// - Grid:   cores form an r x c grid; a vertex hashes to a cell and may only
+  ///           be placed in that cell's row and column, so an edge goes to the
+  ///           least loaded core where its endpoints' row and column cross
+  ///           (at most r+c-1 replicas per vertex)
+  /// - Greedy: PowerGraph's oblivious greedy heuristic: prefer cores that
+  ///           already hold both endpoints, then either, then the least loaded
+  /// - HDRF:   High-Degree (are) Replicated First: like Greedy, but when only
+  ///           one endpoint can be kept together, keep the lower-degree one,
+  ///           with `--hdrf_lambda` weighting balance against replication
+  ///
+  /// Placement is streaming and "oblivious": each core assigns its share of
+  /// the input edges using only what it has seen itself.
+  enum class VertexCut { Hash, Grid, Greedy, HDRF };
+  
+  /// Parse a strategy name (hash, grid, greedy, hdrf); fails on anything else.
+  VertexCut vertex_cut(const std::string& name);
+  const char * vertex_cut_name(VertexCut s);
+  
+  /// Streaming vertex-cut partitioner; one per core.
+  class VertexCutPartitioner {
+    struct Placement {
+      int64_t degree;           ///< edges seen so far (partial degree, for HDRF)
+      std::vector<Core> cores;  ///< cores this vertex has been placed on
+      bool on(Core c) const { return std::find(cores.begin(), cores.end(), c) != cores.end(); }
+      void add(Core c) { if (!on(c)) cores.push_back(c); }
+    };
+    
+    VertexCut strategy;
+    Core ncores;
+    size_t * loads;  // edges assigned to each core (may be shared by a locale's cores)
+    std::unordered_map<int64_t,Placement> placed;
+    int64_t rows, cols;
+    std::vector<double> score;
+    uint64_t (*tie_hash)(int64_t u, int64_t v);
+    
+    uint64_t edge_hash(int64_t u, int64_t v) const {
+      return bittwiddle::mix64(std::min(u,v) * 0x9e3779b97f4a7c15ULL ^ std::max(u,v));
+    }
+    
+    /// pick the highest-scoring core, breaking ties by hashing the edge
+    Core best(int64_t u, int64_t v) const;
+    
+    Core assign_grid(int64_t u, int64_t v) const;
+    
+  public:
+    /// @param loads     counts of edges assigned to each core (`cores()` of them),
+    ///                  updated as edges are assigned
+    /// @param tie_hash  edge hash that picks among equally good cores for
+    ///                  Greedy and HDRF (by default, the one Hash places with)
+    VertexCutPartitioner(VertexCut strategy, size_t * loads,
+                         uint64_t (*tie_hash)(int64_t u, int64_t v) = nullptr);
+    
+    /// Choose the core for edge (u,v) and record the placement.
+    Core assign(int64_t u, int64_t v);
+    
+    /// distinct vertices placed so far
+    size_t nvertices() const { return placed.size(); }
+  };
+  
+  /// Compute the partition-quality metrics for a graph whose edges and vertex
+  /// copies are spread over cores, and log them on core 0. Call on all cores.
+  ///
+  /// @param local_edges  edges stored on this core
+  /// @param local_verts  vertices with a copy (master, mirror or ghost) on this core
+  /// @param nv           distinct vertices in the graph
+  ///
+  /// Sets `partition_replication_factor` (copies per vertex) and
+  /// `partition_edge_balance` (most edges on a core over the mean).
+  void report_partition(const char * name, int64_t local_edges, int64_t local_verts, int64_t nv);
+  
+  /// @}
+} // namespace Grappa
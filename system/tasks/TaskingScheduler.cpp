@@ -46,9 +46,12 @@ DEFINE_bool(poll_on_idle, true, "have tasking layer poll aggregator if it has no
 
 DEFINE_uint64( readyq_prefetch_distance, 4, "How far ahead in the ready queue to prefetch contexts" );
 
+DEFINE_bool( lazy_workers, false, "Spawn task workers (and their stacks) the first time a task needs one, up to num_starting_workers, instead of all at startup" );
+
 GRAPPA_DEFINE_METRIC( SimpleMetric<uint64_t>, scheduler_context_switches, 0 );
 GRAPPA_DEFINE_METRIC( SimpleMetric<uint64_t>, scheduler_count, 0);
 GRAPPA_DEFINE_METRIC( SimpleMetric<uint64_t>, scheduler_samples, 0);
+GRAPPA_DEFINE_METRIC( SimpleMetric<uint64_t>, scheduler_lazy_worker_spawns, 0);
 
 // set in sample()
 GRAPPA_DEFINE_METRIC( SummarizingMetric<uint64_t>, active_tasks_sampled, 0);
@@ -82,6 +85,7 @@ TaskingScheduler global_scheduler;
   , num_active_tasks( 0 )
   , task_manager ( NULL )
   , num_workers ( 0 )
+  , max_workers ( 0 )
   , work_args( NULL )
   , previous_periodic_ts( 0 ) 
   , periodic_poll_ticks( 0 ) 
@@ -203,8 +207,14 @@ void workerLoop ( Worker * me, void* args ) {
 
 /// create worker Threads for executing Tasks
 ///
+/// With --lazy_workers, this only raises the limit on workers, and
+/// maybeSpawnCoroutines() creates them as tasks need them.
+///
 /// @param num how many workers to create
 void TaskingScheduler::createWorkers( uint64_t num ) {
+  max_workers += num;
+  if( FLAGS_lazy_workers ) return;
+
   num_workers += num;
   VLOG(5) << "spawning " << num << " workers; now there are " << num_workers;
   for (uint64_t i=0; i<num; i++) {
@@ -221,6 +231,14 @@ void TaskingScheduler::createWorkers( uint64_t num ) {
 /// Give the scheduler a chance to spawn more worker Threads,
 /// based on some heuristics.
 Worker * TaskingScheduler::maybeSpawnCoroutines( ) {
+  if ( FLAGS_lazy_workers && num_workers < max_workers ) {
+    // spawn one of the workers createWorkers() allowed for
+    num_workers += 1;
+    num_idle += 1; // counts as idle until it starts, like createWorkers()
+    scheduler_lazy_worker_spawns++;
+    VLOG(5) << "spawning a deferred worker; now there are " << num_workers;
+    return impl::worker_spawn( current_thread, this, workerLoop, work_args );
+  }
   // currently only spawn a worker if there are less than some threshold
   if ( num_workers < BASIC_MAX_WORKERS ) {
     num_workers += 1;
@@ -41,6 +41,7 @@
 #include <Timestamp.hpp>
 #include <glog/logging.h>
 #include <sstream>
+#include <algorithm>
 #include "Metrics.hpp"
 #include "HistogramMetric.hpp"
 
@@ -63,7 +64,7 @@ GRAPPA_DECLARE_METRIC( SimpleMetric<uint64_t>, scheduler_count);
 
 // forward declarations
 namespace Grappa {
-namespace impl { void idle_flush_rdma_aggregator(); }
+namespace impl { void idle_flush_rdma_aggregator(); void idle_flush_delegate_batches(); }
 namespace Metrics { void sample_all(); }
 }
 
@@ -72,6 +73,7 @@ bool idle_flush_aggregator();
 
 DECLARE_int64( periodic_poll_ticks );
 DECLARE_bool(poll_on_idle);
+DECLARE_bool( lazy_workers );
 DECLARE_bool(flush_on_idle);
 DECLARE_bool(rdma_flush_on_idle);
 
@@ -122,6 +124,9 @@ class TaskingScheduler : public Scheduler {
     /// total number of worker Threads
     uint64_t num_workers;
 
+    /// number of worker Threads createWorkers() has allowed for (see --lazy_workers)
+    uint64_t max_workers;
+
     /// Return an idle worker Worker
     Worker * getWorker ();
 
@@ -228,6 +233,8 @@ class TaskingScheduler : public Scheduler {
         }
 
         
+        Grappa::impl::idle_flush_delegate_batches();
+
         if (FLAGS_poll_on_idle) {
           *(stats.state_timers[ stats.prev_state ]) += (current_ts - prev_ts) / tick_scale;
 
@@ -344,7 +351,7 @@ class TaskingScheduler : public Scheduler {
     /// (this is mostly to make Core 0 with user_main not get forced to have fewer active)
     void allow_active_workers(int64_t n) {
       if (n == -1) {
-        max_allowed_active_workers = num_workers;
+        max_allowed_active_workers = std::max( num_workers, max_workers );
       } else {
         //VLOG(1) << "mynode = " << global_communicator.mycore;
         max_allowed_active_workers = n + ((global_communicator.mycore == 0) ? 1 : 0);